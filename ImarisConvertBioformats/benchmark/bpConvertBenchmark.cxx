@@ -0,0 +1,297 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+// Measures the conversion core on generated images, without a virtual machine
+// and without input files:
+//
+//   bpConvertBenchmark [options] [image.synthetic ...]
+//
+// Each image (see bpfFileReaderSynthetic for the names) runs the scenarios
+// "convert" (bpImageConvertNew to .ims), "thumbnail" (thumbnail only) and
+// "hash" (bpFileInfo voxel hash). The fastest of the repetitions is printed
+// with the read and write rates of the stage metrics and the peak resident
+// memory of the process so far. Without images a default set is measured.
+
+#include "../meta/bpFileInfo.h"
+#include "../meta/bpFileReaderFactoryFileIO.h"
+#include "../meta/bpFileTools.h"
+#include "../meta/bpNumberType.h"
+#include "../meta/bpUtils.h"
+#include "../src/bpImageConvertNew.h"
+#include "../src/bpStageMetrics.h"
+
+#include "fileiobase/application/bpfFileReaderSyntheticImplFactory.h"
+#include "fileiobase/utils/bpfSysInfo.h"
+
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+
+
+static const std::vector<bpString> mDefaultImages = {
+  "planes8&sizeX=1024&sizeY=1024&sizeZ=64&sizeC=2&pixelType=uint8.synthetic",
+  "planes16&sizeX=1024&sizeY=1024&sizeZ=64&sizeC=2&pixelType=uint16.synthetic",
+  "tiles16&sizeX=4096&sizeY=4096&sizeZ=4&pixelType=uint16&blockX=512&blockY=512.synthetic",
+  "float&sizeX=512&sizeY=512&sizeZ=64&sizeC=2&pixelType=float.synthetic",
+  "rgb&sizeX=1024&sizeY=1024&sizeZ=32&sizeC=3&pixelType=uint8&interleaved=true.synthetic",
+  "xyczt&sizeX=512&sizeY=512&sizeZ=32&sizeC=3&sizeT=4&pixelType=uint16&dimOrder=XYCZT.synthetic",
+  "smallplanes&sizeX=64&sizeY=64&sizeZ=4096&pixelType=uint16.synthetic",
+  "bricks32&sizeX=256&sizeY=256&sizeZ=256&pixelType=uint32&blockZ=32.synthetic"
+};
+
+
+class cBenchmarkOptions
+{
+public:
+  std::vector<bpString> mScenarios = { "convert", "thumbnail", "hash" };
+  bpSize mRepetitions = 3;
+  bpSize mNumberOfThreads = 8;
+  bpSize mCompression = 2;
+  bpSize mReadAheadBlocks = 2;
+  bpString mOutputDirectory;
+};
+
+
+class cBenchmarkResult
+{
+public:
+  bpDouble mSeconds = 0;
+  bpDouble mReadMegaBytesPerSecond = 0;
+  bpDouble mWriteMegaBytesPerSecond = 0;
+  bpString mVoxelHash;
+};
+
+
+static void PrintUsage(const bpString& aProgramName)
+{
+  std::cout << "Usage: " << aProgramName << " [options] [image.synthetic ...]" << std::endl;
+  std::cout << std::endl;
+  std::cout << "  -s   |--scenario                 Scenarios to run                  (default: convert,thumbnail,hash)" << std::endl;
+  std::cout << "  -r   |--repeat                   Repetitions, the fastest counts   (default: 3)" << std::endl;
+  std::cout << "  -nt  |--nthreads                 Set number of compression threads (default: 8)" << std::endl;
+  std::cout << "  -c   |--compression              Compression level                 (default: 2)" << std::endl;
+  std::cout << "  -ra  |--readahead                Blocks read ahead of the writer   (default: 2 - 0 reads synchronously)" << std::endl;
+  std::cout << "  -o   |--output                   Directory of the output files     (default: temporary directory, files are removed)" << std::endl;
+  std::cout << std::endl;
+  std::cout << "Image names, e.g. name&sizeX=1024&sizeY=1024&sizeZ=64&sizeC=2&sizeT=1&pixelType=uint16&dimOrder=XYZCT&interleaved=false&blockX=256&blockY=256&blockZ=1.synthetic" << std::endl;
+  std::cout << "(pixelType uint8|uint16|uint32|float). Without images a default set is measured." << std::endl;
+}
+
+
+static bool ParseArguments(const std::vector<bpString>& aArguments, cBenchmarkOptions& aOptions, std::vector<bpString>& aImages)
+{
+  for (bpSize vArgIndex = 1; vArgIndex < aArguments.size(); ++vArgIndex) {
+    const bpString& vArgName = aArguments[vArgIndex];
+    if (vArgName == "-h" || vArgName == "-help" || vArgName == "--help") {
+      return false;
+    }
+    if (vArgName.empty() || vArgName[0] != '-') {
+      aImages.push_back(vArgName);
+      continue;
+    }
+    if (vArgIndex + 1 >= aArguments.size()) {
+      std::cerr << "Missing value of " << vArgName << std::endl;
+      return false;
+    }
+    const bpString& vArgValue = aArguments[++vArgIndex];
+    if (vArgName == "-s" || vArgName == "-scenario" || vArgName == "--scenario") {
+      aOptions.mScenarios = bpSplit(vArgValue, ",", true);
+    }
+    else if (vArgName == "-r" || vArgName == "-repeat" || vArgName == "--repeat") {
+      aOptions.mRepetitions = std::max<bpSize>(bpFromString<bpSize>(vArgValue), 1);
+    }
+    else if (vArgName == "-nt" || vArgName == "-nthreads" || vArgName == "--nthreads") {
+      aOptions.mNumberOfThreads = std::max<bpSize>(bpFromString<bpSize>(vArgValue), 1);
+    }
+    else if (vArgName == "-c" || vArgName == "-compression" || vArgName == "--compression") {
+      aOptions.mCompression = bpFromString<bpSize>(vArgValue);
+    }
+    else if (vArgName == "-ra" || vArgName == "-readahead" || vArgName == "--readahead") {
+      aOptions.mReadAheadBlocks = bpFromString<bpSize>(vArgValue);
+    }
+    else if (vArgName == "-o" || vArgName == "-output" || vArgName == "--output") {
+      aOptions.mOutputDirectory = vArgValue;
+    }
+    else {
+      std::cerr << "Unknown argument " << vArgName << std::endl;
+      return false;
+    }
+  }
+
+  for (const bpString& vScenario : aOptions.mScenarios) {
+    if (vScenario != "convert" && vScenario != "thumbnail" && vScenario != "hash") {
+      std::cerr << "Unknown scenario " << vScenario << std::endl;
+      return false;
+    }
+  }
+  if (aOptions.mOutputDirectory.empty()) {
+    aOptions.mOutputDirectory = bpfSysInfo::GetTemporaryPath();
+  }
+  return true;
+}
+
+
+static bpUInt64 GetImageBytes(const bpFileReader::tPtr& aReader)
+{
+  const auto& vReaderImpl = aReader->GetReaderImpl();
+  bpUInt64 vBytes = bpGetSizeOfType(vReaderImpl->GetDataType());
+  for (bpSize vSize : vReaderImpl->GetDataSizeV()) {
+    vBytes *= vSize;
+  }
+  return vBytes;
+}
+
+
+static void RunScenario(const bpString& aScenario, const bpFileReader::tPtr& aReader, const bpString& aImage, const cBenchmarkOptions& aOptions, cBenchmarkResult& aResult)
+{
+  bpString vOutputFile = aOptions.mOutputDirectory + "/bpConvertBenchmark";
+
+  bpStageMetrics::cSnapshot vBefore = bpStageMetrics::GetSnapshot();
+  auto vStart = std::chrono::steady_clock::now();
+
+  if (aScenario == "hash") {
+    bpString vXML = bpFileInfo::GetXML_ReadVoxelHash(aImage, aReader, 0, "", bpFileInfo::eVoxelHashSequential, {}, aOptions.mNumberOfThreads);
+    if (vXML.find("<Crash/>") != bpString::npos) {
+      throw std::runtime_error("Voxel hash failed: " + vXML);
+    }
+    const bpString vHashAttribute = "mVoxelHash=\"";
+    bpSize vHashBegin = vXML.find(vHashAttribute);
+    if (vHashBegin != bpString::npos) {
+      vHashBegin += vHashAttribute.size();
+      aResult.mVoxelHash = vXML.substr(vHashBegin, vXML.find('"', vHashBegin) - vHashBegin);
+    }
+  }
+  else {
+    bpConverterTypes::cOptions vWriteOptions;
+    vWriteOptions.mNumberOfThreads = aOptions.mNumberOfThreads;
+    vWriteOptions.mCompressionAlgorithmType = static_cast<bpConverterTypes::tCompressionAlgorithmType>(aOptions.mCompression);
+
+    bpImageConvertNew::cConvertOptions vConvertOptions;
+    vConvertOptions.mReadAheadBlocks = aOptions.mReadAheadBlocks;
+    if (aScenario == "thumbnail") {
+      vConvertOptions.mWriteMode = bpImageConvertNew::eWriteThumbnailOnly;
+      vOutputFile += ".png";
+    }
+    else {
+      vOutputFile += ".ims";
+    }
+    bpImageConvertNew::Convert(aReader, vOutputFile, vConvertOptions, vWriteOptions);
+    std::remove(vOutputFile.c_str());
+  }
+
+  auto vEnd = std::chrono::steady_clock::now();
+  bpStageMetrics::cSnapshot vStages = bpStageMetrics::GetSnapshot() - vBefore;
+
+  aResult.mSeconds = std::chrono::duration<bpDouble>(vEnd - vStart).count();
+  aResult.mReadMegaBytesPerSecond = vStages.GetMegaBytesPerSecond(bpStageMetrics::eStageRead);
+  aResult.mWriteMegaBytesPerSecond = vStages.GetMegaBytesPerSecond(bpStageMetrics::eStageWrite);
+}
+
+
+static bool RunImage(const bpSharedPtr<bpFileReaderFactory>& aFactory, const bpString& aImage, const cBenchmarkOptions& aOptions)
+{
+  bool vSuccess = true;
+  for (const bpString& vScenario : aOptions.mScenarios) {
+    cBenchmarkResult vBest;
+    bpUInt64 vBytes = 0;
+    try {
+      for (bpSize vRepetition = 0; vRepetition < aOptions.mRepetitions; ++vRepetition) {
+        // a new reader for every run, like a new conversion
+        bpFileReader::tPtr vReader = aFactory->CreateFileReader(aImage);
+        vBytes = GetImageBytes(vReader);
+        cBenchmarkResult vResult;
+        RunScenario(vScenario, vReader, aImage, aOptions, vResult);
+        if (vRepetition == 0 || vResult.mSeconds < vBest.mSeconds) {
+          vBest = vResult;
+        }
+      }
+    }
+    catch (const std::exception& vException) {
+      std::cerr << vScenario << " of " << aImage << " failed: " << vException.what() << std::endl;
+      vSuccess = false;
+      continue;
+    }
+    catch (...) {
+      std::cerr << vScenario << " of " << aImage << " failed" << std::endl;
+      vSuccess = false;
+      continue;
+    }
+
+    bpDouble vMegaBytes = vBytes / (1024.0 * 1024);
+    std::cout << std::left << std::setw(10) << vScenario << std::right << std::fixed << std::setprecision(1)
+      << std::setw(10) << vMegaBytes
+      << std::setw(10) << std::setprecision(3) << vBest.mSeconds << std::setprecision(1)
+      << std::setw(10) << (vBest.mSeconds > 0 ? vMegaBytes / vBest.mSeconds : 0.0)
+      << std::setw(10) << vBest.mReadMegaBytesPerSecond
+      << std::setw(10) << vBest.mWriteMegaBytesPerSecond
+      << std::setw(10) << bpfSysInfo::GetPeakMemoryUsage() / (1024.0 * 1024)
+      << "  " << bpFileTools::GetFile(aImage);
+    if (vScenario == "hash") {
+      std::cout << " (hash " << vBest.mVoxelHash << ")";
+    }
+    std::cout << std::endl;
+  }
+  return vSuccess;
+}
+
+
+int main(int argc, char* argv[])
+{
+  std::vector<bpString> vArguments(argv, argv + argc);
+
+  cBenchmarkOptions vOptions;
+  std::vector<bpString> vImages;
+  if (!ParseArguments(vArguments, vOptions, vImages)) {
+    PrintUsage(bpFileTools::GetFileExt(vArguments.front()));
+    return 1;
+  }
+  if (vImages.empty()) {
+    vImages = mDefaultImages;
+  }
+
+  auto vFactoryFileIO = bpfMakeSharedPtr<bpFileReaderFactoryFileIO>();
+  vFactoryFileIO->AddFactoryImpl(bpfMakeSharedPtr<bpfFileReaderSyntheticImplFactory>());
+  bpSharedPtr<bpFileReaderFactory> vFactory = vFactoryFileIO;
+
+  std::cout << std::left << std::setw(10) << "Scenario" << std::right
+    << std::setw(10) << "MB" << std::setw(10) << "Seconds" << std::setw(10) << "MB/s"
+    << std::setw(10) << "Read MB/s" << std::setw(10) << "Write MB/s" << std::setw(10) << "Peak MB"
+    << "  Image" << std::endl;
+
+  bool vSuccess = true;
+  for (const bpString& vImage : vImages) {
+    vSuccess = RunImage(vFactory, vImage, vOptions) && vSuccess;
+  }
+  return vSuccess ? 0 : 1;
+}
+
+
+// shared code from ImarisWriter, as in bpConvertMain.cxx
+#include "ImarisWriter/writer/bpHistogram.cxx"
+#include "ImarisWriter/writer/bpImsImage3D.cxx"
+#include "ImarisWriter/writer/bpImsImage5D.cxx"
+#include "ImarisWriter/writer/bpImsLayout.cxx"
+#include "ImarisWriter/writer/bpImsLayout3D.cxx"
+#include "ImarisWriter/writer/bpImsImageBlock.cxx"
+#include "ImarisWriter/writer/bpMemoryManager.cxx"
+#include "ImarisWriter/writer/bpMultiresolutionImsImage.cxx"
+#include "ImarisWriter/writer/bpOptimalBlockLayout.cxx"
+#include "ImarisWriter/writer/bpThreadPool.cxx"
+#include "ImarisWriter/writer/bpThumbnailBuilder.cxx"
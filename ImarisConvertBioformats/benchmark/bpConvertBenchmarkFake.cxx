@@ -0,0 +1,384 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+// Converts a matrix of Bio-Formats .fake images with the ImarisConvertBioformats
+// command line, i.e. through the JVM and bpfFileReaderBioformats:
+//
+//   bpConvertBenchmarkFake [options]
+//
+// Every run writes the totals of its stage metrics (-tj), from which the
+// conversion throughput, the share of the time spent reading blocks from
+// Bio-Formats (JNI calls and normalization) and the peak memory of the
+// converter are taken. The results are written into a CSV file. Given the CSV
+// file of an earlier run as baseline, slower or bigger runs are reported as
+// regressions and the exit code is 1.
+
+#include "fileiobase/types/bpfTypes.h"
+#include "fileiobase/utils/bpfFileTools.h"
+#include "fileiobase/utils/bpfSysInfo.h"
+#include "fileiobase/utils/bpfUtils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+
+class cFakeImage
+{
+public:
+  bpfString mPixelType;
+  bpfSize mBytesPerVoxel;
+  bpfSize mSizeX;
+  bpfSize mSizeY;
+  bpfSize mSizeZ;
+  bpfSize mSizeC;
+  bpfSize mRGB; // channels per plane
+  bool mLittleEndian;
+  bool mInterleaved;
+
+  bpfString GetName() const
+  {
+    std::ostringstream vName;
+    vName << mSizeX << "x" << mSizeY << "x" << mSizeZ << "x" << mSizeC << "-" << mPixelType << (mLittleEndian ? "-le" : "-be");
+    if (mRGB > 1) {
+      vName << (mInterleaved ? "-rgbinterleaved" : "-rgbplanar");
+    }
+    return vName.str();
+  }
+
+  bpfString GetFileName() const
+  {
+    std::ostringstream vName;
+    vName << "benchmark&sizeX=" << mSizeX << "&sizeY=" << mSizeY << "&sizeZ=" << mSizeZ << "&sizeC=" << mSizeC
+          << "&pixelType=" << mPixelType << "&little=" << (mLittleEndian ? "true" : "false");
+    if (mRGB > 1) {
+      vName << "&rgb=" << mRGB << "&interleaved=" << (mInterleaved ? "true" : "false");
+    }
+    vName << ".fake";
+    return vName.str();
+  }
+
+  bpfDouble GetMegaBytes() const
+  {
+    return static_cast<bpfDouble>(mSizeX) * mSizeY * mSizeZ * mSizeC * mBytesPerVoxel / (1024.0 * 1024);
+  }
+};
+
+
+class cBenchmarkOptions
+{
+public:
+#if defined(_WIN32)
+  bpfString mConverter = "ImarisConvertBioformats.exe";
+#else
+  bpfString mConverter = "./ImarisConvertBioformats";
+#endif
+  bpfString mConverterArguments;
+  bpfString mCsvFileName = "bpConvertBenchmarkFake.csv";
+  bpfString mBaselineFileName;
+  bpfString mFilter;
+  bpfString mWorkDirectory;
+  bpfSize mNumberOfThreads = 8;
+  bpfDouble mMaxSlowdownPercent = 10;
+  bpfDouble mMaxMemoryIncreasePercent = 20;
+};
+
+
+class cBenchmarkResult
+{
+public:
+  bool mSuccess = false;
+  bpfDouble mWallSeconds = 0;
+  bpfDouble mConvertSeconds = 0;
+  bpfDouble mMegaBytesPerSecond = 0;
+  bpfDouble mReadShare = 0;
+  bpfDouble mPeakMegaBytes = 0;
+};
+
+
+// one image of every kind, about 64 M voxels each except the special cases
+static std::vector<cFakeImage> GetMatrix()
+{
+  static const std::pair<const char*, bpfSize> vPixelTypes[] = { { "uint8", 1 }, { "uint16", 2 }, { "int16", 2 }, { "float", 4 } };
+
+  std::vector<cFakeImage> vMatrix;
+  for (bpfSize vPlaneSize : { 512, 2048, 4096 }) {
+    for (const auto& vPixelType : vPixelTypes) {
+      for (bool vLittleEndian : { true, false }) {
+        bpfSize vSizeZ = std::max<bpfSize>((64 << 20) / (vPlaneSize * vPlaneSize), 1);
+        vMatrix.push_back({ vPixelType.first, vPixelType.second, vPlaneSize, vPlaneSize, vSizeZ, 1, 1, vLittleEndian, false });
+      }
+    }
+  }
+
+  // interleaved and planar RGB
+  for (bool vInterleaved : { true, false }) {
+    vMatrix.push_back({ "uint8", 1, 1024, 1024, 32, 3, 3, true, vInterleaved });
+  }
+
+  // many small planes, the costs per block dominate
+  vMatrix.push_back({ "uint8", 1, 64, 64, 8192, 1, 1, true, false });
+  vMatrix.push_back({ "uint16", 2, 64, 64, 8192, 1, 1, true, false });
+  return vMatrix;
+}
+
+
+static void PrintUsage(const bpfString& aProgramName)
+{
+  std::cout << "Usage: " << aProgramName << " [options]" << std::endl;
+  std::cout << std::endl;
+  std::cout << "  -cli |--converter                Converter to run                  (default: ImarisConvertBioformats of the current directory)" << std::endl;
+  std::cout << "  -ca  |--converterarguments       More arguments of the converter   (default: none)" << std::endl;
+  std::cout << "  -csv |--csv                      Results CSV file                  (default: bpConvertBenchmarkFake.csv)" << std::endl;
+  std::cout << "  -b   |--baseline                 CSV file of an earlier run        (default: none - no regression check)" << std::endl;
+  std::cout << "  -ms  |--maxslowdown              Allowed throughput loss in %      (default: 10)" << std::endl;
+  std::cout << "  -mm  |--maxmemory                Allowed peak memory increase in % (default: 20)" << std::endl;
+  std::cout << "  -f   |--filter                   Run images whose name contains it (default: all - e.g. 2048x2048, uint16, -be, rgb)" << std::endl;
+  std::cout << "  -w   |--workdir                  Directory of the temporary files  (default: temporary directory)" << std::endl;
+  std::cout << "  -nt  |--nthreads                 Set number of compression threads (default: 8)" << std::endl;
+}
+
+
+static bool ParseArguments(const std::vector<bpfString>& aArguments, cBenchmarkOptions& aOptions)
+{
+  for (bpfSize vArgIndex = 1; vArgIndex < aArguments.size(); ++vArgIndex) {
+    const bpfString& vArgName = aArguments[vArgIndex];
+    if (vArgName == "-h" || vArgName == "-help" || vArgName == "--help" || vArgIndex + 1 >= aArguments.size()) {
+      return false;
+    }
+    const bpfString& vArgValue = aArguments[++vArgIndex];
+    if (vArgName == "-cli" || vArgName == "-converter" || vArgName == "--converter") {
+      aOptions.mConverter = vArgValue;
+    }
+    else if (vArgName == "-ca" || vArgName == "-converterarguments" || vArgName == "--converterarguments") {
+      aOptions.mConverterArguments = vArgValue;
+    }
+    else if (vArgName == "-csv" || vArgName == "--csv") {
+      aOptions.mCsvFileName = vArgValue;
+    }
+    else if (vArgName == "-b" || vArgName == "-baseline" || vArgName == "--baseline") {
+      aOptions.mBaselineFileName = vArgValue;
+    }
+    else if (vArgName == "-ms" || vArgName == "-maxslowdown" || vArgName == "--maxslowdown") {
+      bpfFromString(vArgValue, aOptions.mMaxSlowdownPercent);
+    }
+    else if (vArgName == "-mm" || vArgName == "-maxmemory" || vArgName == "--maxmemory") {
+      bpfFromString(vArgValue, aOptions.mMaxMemoryIncreasePercent);
+    }
+    else if (vArgName == "-f" || vArgName == "-filter" || vArgName == "--filter") {
+      aOptions.mFilter = vArgValue;
+    }
+    else if (vArgName == "-w" || vArgName == "-workdir" || vArgName == "--workdir") {
+      aOptions.mWorkDirectory = vArgValue;
+    }
+    else if (vArgName == "-nt" || vArgName == "-nthreads" || vArgName == "--nthreads") {
+      bpfFromString(vArgValue, aOptions.mNumberOfThreads);
+    }
+    else {
+      std::cerr << "Unknown argument " << vArgName << std::endl;
+      return false;
+    }
+  }
+
+  if (aOptions.mWorkDirectory.empty()) {
+    aOptions.mWorkDirectory = bpfSysInfo::GetTemporaryPath();
+  }
+  return true;
+}
+
+
+static bool GetJsonNumber(const bpfString& aJson, const bpfString& aKey, bpfSize aFrom, bpfDouble& aValue)
+{
+  bpfString vKey = "\"" + aKey + "\":";
+  bpfSize vPos = aJson.find(vKey, aFrom);
+  if (vPos == bpfString::npos) {
+    return false;
+  }
+  aValue = std::strtod(aJson.c_str() + vPos + vKey.size(), nullptr);
+  return true;
+}
+
+
+// the totals written by the converter at the end of the conversion
+static bool ReadTotals(const bpfString& aJsonFileName, cBenchmarkResult& aResult)
+{
+  std::ifstream vJson(aJsonFileName);
+  bpfString vLine;
+  bpfString vTotals;
+  while (std::getline(vJson, vLine)) {
+    if (vLine.find("\"final\":true") != bpfString::npos) {
+      vTotals = vLine;
+    }
+  }
+
+  bpfSize vReadStage = vTotals.find("\"read\":{");
+  return vReadStage != bpfString::npos &&
+         GetJsonNumber(vTotals, "seconds", 0, aResult.mConvertSeconds) &&
+         GetJsonNumber(vTotals, "busy", vReadStage, aResult.mReadShare) &&
+         GetJsonNumber(vTotals, "peakmb", 0, aResult.mPeakMegaBytes);
+}
+
+
+static cBenchmarkResult Run(const cFakeImage& aImage, const cBenchmarkOptions& aOptions)
+{
+  bpfString vDirectory = bpfFileTools::AppendSeparator(aOptions.mWorkDirectory);
+  bpfString vInputFile = vDirectory + aImage.GetFileName();
+  bpfString vOutputFile = vDirectory + "bpConvertBenchmarkFake.ims";
+  bpfString vJsonFile = vDirectory + "bpConvertBenchmarkFake.json";
+
+  // Bio-Formats only needs the name, the file stays empty
+  std::ofstream(vInputFile.c_str()).close();
+  std::remove(vJsonFile.c_str());
+
+  std::ostringstream vCommand;
+  vCommand << "\"" << aOptions.mConverter << "\" -i \"" << vInputFile << "\" -o \"" << vOutputFile << "\" -tj \"" << vJsonFile
+           << "\" -nt " << aOptions.mNumberOfThreads << " -l none " << aOptions.mConverterArguments;
+#if defined(_WIN32)
+  // cmd removes the outer quotes of the command
+  bpfString vCommandLine = "\"" + vCommand.str() + "\"";
+#else
+  bpfString vCommandLine = vCommand.str();
+#endif
+
+  cBenchmarkResult vResult;
+  auto vStart = std::chrono::steady_clock::now();
+  int vExitCode = std::system(vCommandLine.c_str());
+  vResult.mWallSeconds = std::chrono::duration<bpfDouble>(std::chrono::steady_clock::now() - vStart).count();
+
+  vResult.mSuccess = vExitCode == 0 && ReadTotals(vJsonFile, vResult);
+  if (vResult.mSuccess && vResult.mConvertSeconds > 0) {
+    vResult.mMegaBytesPerSecond = aImage.GetMegaBytes() / vResult.mConvertSeconds;
+  }
+
+  std::remove(vInputFile.c_str());
+  std::remove(vOutputFile.c_str());
+  std::remove(vJsonFile.c_str());
+  return vResult;
+}
+
+
+// name -> (MB/s, peak MB) of an earlier run
+static std::map<bpfString, std::pair<bpfDouble, bpfDouble>> ReadBaseline(const bpfString& aFileName)
+{
+  std::map<bpfString, std::pair<bpfDouble, bpfDouble>> vBaseline;
+  std::ifstream vCsv(aFileName);
+  bpfString vLine;
+  if (!std::getline(vCsv, vLine)) {
+    return vBaseline;
+  }
+  std::vector<bpfString> vHeader = bpfSplit(vLine, ",");
+  auto vColumn = [&vHeader](const bpfString& aName) {
+    return static_cast<bpfSize>(std::find(vHeader.begin(), vHeader.end(), aName) - vHeader.begin());
+  };
+  bpfSize vName = vColumn("name");
+  bpfSize vMegaBytesPerSecond = vColumn("mbps");
+  bpfSize vPeakMegaBytes = vColumn("peakmb");
+
+  while (std::getline(vCsv, vLine)) {
+    std::vector<bpfString> vValues = bpfSplit(vLine, ",");
+    if (vValues.size() != vHeader.size() || vName >= vValues.size() || vMegaBytesPerSecond >= vValues.size() || vPeakMegaBytes >= vValues.size()) {
+      continue;
+    }
+    bpfDouble vSpeed = 0;
+    bpfDouble vMemory = 0;
+    bpfFromString(vValues[vMegaBytesPerSecond], vSpeed);
+    bpfFromString(vValues[vPeakMegaBytes], vMemory);
+    vBaseline[vValues[vName]] = std::make_pair(vSpeed, vMemory);
+  }
+  return vBaseline;
+}
+
+
+static bpfString GetStatus(const cFakeImage& aImage, const cBenchmarkResult& aResult, const cBenchmarkOptions& aOptions,
+                           const std::map<bpfString, std::pair<bpfDouble, bpfDouble>>& aBaseline)
+{
+  if (!aResult.mSuccess) {
+    return "failed";
+  }
+  auto vBaseline = aBaseline.find(aImage.GetName());
+  if (vBaseline == aBaseline.end()) {
+    return "ok";
+  }
+  bpfString vStatus;
+  if (aResult.mMegaBytesPerSecond < vBaseline->second.first * (1 - aOptions.mMaxSlowdownPercent / 100)) {
+    vStatus = "slower";
+  }
+  if (aResult.mPeakMegaBytes > vBaseline->second.second * (1 + aOptions.mMaxMemoryIncreasePercent / 100)) {
+    vStatus += vStatus.empty() ? "memory" : "+memory";
+  }
+  return vStatus.empty() ? "ok" : vStatus;
+}
+
+
+int main(int argc, char* argv[])
+{
+  std::vector<bpfString> vArguments(argv, argv + argc);
+
+  cBenchmarkOptions vOptions;
+  if (!ParseArguments(vArguments, vOptions)) {
+    PrintUsage(bpfFileTools::GetFileExt(vArguments.front()));
+    return 1;
+  }
+
+  std::map<bpfString, std::pair<bpfDouble, bpfDouble>> vBaseline;
+  if (!vOptions.mBaselineFileName.empty()) {
+    vBaseline = ReadBaseline(vOptions.mBaselineFileName);
+    if (vBaseline.empty()) {
+      std::cerr << "No results in baseline " << vOptions.mBaselineFileName << std::endl;
+      return 1;
+    }
+  }
+
+  std::ofstream vCsv(vOptions.mCsvFileName);
+  if (!vCsv) {
+    std::cerr << "Cannot write " << vOptions.mCsvFileName << std::endl;
+    return 1;
+  }
+  vCsv << "name,sizex,sizey,sizez,sizec,pixeltype,littleendian,interleaved,megabytes,wallseconds,convertseconds,mbps,readshare,peakmb,status" << std::endl;
+
+  bool vSuccess = true;
+  for (const cFakeImage& vImage : GetMatrix()) {
+    if (vImage.GetName().find(vOptions.mFilter) == bpfString::npos) {
+      continue;
+    }
+
+    cBenchmarkResult vResult = Run(vImage, vOptions);
+    bpfString vStatus = GetStatus(vImage, vResult, vOptions, vBaseline);
+    vSuccess = vSuccess && vStatus == "ok";
+
+    vCsv << vImage.GetName() << "," << vImage.mSizeX << "," << vImage.mSizeY << "," << vImage.mSizeZ << "," << vImage.mSizeC << ","
+         << vImage.mPixelType << "," << (vImage.mLittleEndian ? 1 : 0) << "," << (vImage.mInterleaved ? 1 : 0) << ","
+         << vImage.GetMegaBytes() << "," << vResult.mWallSeconds << "," << vResult.mConvertSeconds << ","
+         << vResult.mMegaBytesPerSecond << "," << vResult.mReadShare << "," << vResult.mPeakMegaBytes << "," << vStatus << std::endl;
+
+    std::cout << std::left << std::setw(36) << vImage.GetName() << std::right << std::fixed << std::setprecision(1)
+              << std::setw(10) << vResult.mMegaBytesPerSecond << " MB/s"
+              << std::setw(8) << vResult.mReadShare * 100 << " % read"
+              << std::setw(10) << vResult.mPeakMegaBytes << " MB peak"
+              << "  " << vStatus << std::endl;
+  }
+
+  return vSuccess ? 0 : 1;
+}
@@ -20,8 +20,10 @@
 #include "bpConverter.h"
 #include "bpLogger.h"
 #include "bpOutput.h"
+#include "bpResultCache.h"
 
 #include "../src/bpImageConvertNew.h"
+#include "../src/bpConverterVersion.h"
 
 #include "../meta/bpUtils.h"
 #include "../meta/bpFileInfo.h"
@@ -32,6 +34,7 @@
 #include "../meta/bpParameterSection.h"
 #include "../meta/bpFileReaderFactory.h"
 #include "../meta/bpFileReaderSeriesAdjustable.h"
+#include "../meta/bpVoxelHashBlocks.h"
 
 #include <hdf5.h>
 
@@ -39,6 +42,30 @@
 #include <boost/filesystem.hpp>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+
+static bool IsProcessed(const bpString& aInputFileName, const std::set<bpString>& aProcessedInputFileNames)
+{
+  if (aProcessedInputFileNames.find(aInputFileName) != aProcessedInputFileNames.end()) {
+    return true;
+  }
+
+  boost::filesystem::path vInputPath(aInputFileName);
+  for (const auto& vProcessedFileName : aProcessedInputFileNames) {
+    boost::filesystem::path vProcessedPath(vProcessedFileName);
+    boost::system::error_code vErrorCode;
+
+    if (boost::filesystem::equivalent(vInputPath, vProcessedPath, vErrorCode)) {
+      return true;
+    }
+  }
+  return false;
+}
 
 
 bpConverter::bpConverter(bpSharedPtr<bpFileReaderFactory> aFileReaderFactory)
@@ -55,9 +82,14 @@ bpConverter::bpConverter(bpSharedPtr<bpFileReaderFactory> aFileReaderFactory)
   mMetaDataForArenaFileName(""),
   mVoxelHashFileName(""),
   mVoxelHashBlockSort("t"),
+  mVoxelHashVersion(bpFileInfo::eVoxelHashSequential),
+  mMetadataLevel(""),
   mImageDescriptorsFileName(""),
   mThumbnailSettings(),
   mLogFile(""),
+  mResultCacheDirectory(""),
+  mReaderMemoDirectory(""),
+  mReaderMemoMinimumElapsed(100),
   mDoMetaDataCalculation(false),
   mDoMetaDataForArenaCalculation(false),
   mDoVoxelHashCalculation(false),
@@ -68,6 +100,11 @@ bpConverter::bpConverter(bpSharedPtr<bpFileReaderFactory> aFileReaderFactory)
   mThroughputOutputInterval(0.0f),
   mFileReaderFactory(std::move(aFileReaderFactory)),
   mNumberOfThreads(8),
+  mReadAheadBlocks(2),
+  mNumberOfReaders(1),
+  mNumberOfJobs(1),
+  mCheckpointInterval(0.0f),
+  mResume(false),
   mCompressionAlgorithmType(bpConverterTypes::tCompressionAlgorithmType::eCompressionAlgorithmGzipLevel2)
 {
   bpLogger::SetSink(bpLogger::eSinkStdCOut);
@@ -229,6 +266,13 @@ void bpConverter::SetThroughputOutputInterval(bpUInt32 aTimeIntervalInMs)
 }
 
 
+void bpConverter::SetThroughputJsonFileName(const bpString& aJsonFileName, const bpString& aArgumentName)
+{
+  bpString vJsonFileName = bpFileTools::ConvertSeparators(bpFileTools::GetAbsoluteFilePath(aJsonFileName));
+  SetParameterOnce(mThroughputJsonFileName, vJsonFileName, aArgumentName);
+}
+
+
 void bpConverter::SetAllFilesFileName(const bpString& aAllFilesFileName, const bpString& aArgumentName)
 {
   SetParameterOnce(mAllFilesFileName, aAllFilesFileName, aArgumentName);
@@ -295,6 +339,25 @@ void bpConverter::SetLogFile(const bpString& aLogFile, const bpString& aArgument
 }
 
 
+void bpConverter::SetResultCacheDirectory(const bpString& aResultCacheDirectory, const bpString& aArgumentName)
+{
+  SetParameterOnce(mResultCacheDirectory, aResultCacheDirectory, aArgumentName);
+}
+
+
+void bpConverter::SetReaderMemoDirectory(const bpString& aReaderMemoDirectory, const bpString& aArgumentName)
+{
+  bpString vReaderMemoDirectory = bpFileTools::ConvertSeparators(bpFileTools::GetAbsoluteFilePath(aReaderMemoDirectory));
+  SetParameterOnce(mReaderMemoDirectory, vReaderMemoDirectory, aArgumentName);
+}
+
+
+void bpConverter::SetReaderMemoMinimumElapsed(bpSize aMinimumMilliseconds)
+{
+  mReaderMemoMinimumElapsed = aMinimumMilliseconds;
+}
+
+
 void bpConverter::SetEnableLogProgress(bool aEnableLogProgress)
 {
   mEnableLogProgress = aEnableLogProgress;
@@ -313,12 +376,70 @@ void bpConverter::SetVoxelHashBlockSort(const bpString& aVoxelHashBlockSort, con
 }
 
 
+void bpConverter::SetVoxelHashVersion(bpSize aVoxelHashVersion)
+{
+  if (aVoxelHashVersion != bpFileInfo::eVoxelHashSequential && aVoxelHashVersion != bpFileInfo::eVoxelHashBlocks) {
+    bpLogger::LogError("Unknown voxel hash version " + bpToString(aVoxelHashVersion) + ". Use --help for details");
+    throw bpConverterExit(IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS);
+  }
+  mVoxelHashVersion = aVoxelHashVersion;
+}
+
+
+void bpConverter::SetMetadataLevel(const bpString& aMetadataLevel)
+{
+  if (aMetadataLevel != "minimum" && aMetadataLevel != "no_overlays" && aMetadataLevel != "all") {
+    bpLogger::LogError("Unknown metadata level " + aMetadataLevel + ". Use --help for details");
+    throw bpConverterExit(IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS);
+  }
+  mMetadataLevel = aMetadataLevel;
+}
+
+
 void bpConverter::SetNumberOfThreads(bpSize aNumberOfThreads)
 {
   mNumberOfThreads = aNumberOfThreads;
 }
 
 
+void bpConverter::SetReadAheadBlocks(bpSize aReadAheadBlocks)
+{
+  mReadAheadBlocks = aReadAheadBlocks;
+}
+
+
+void bpConverter::SetMemoryLimit(bpSize aMemoryLimitMB)
+{
+  // the heap of the JVM is set by the application before the JVM starts
+  bpUInt64 vMemoryLimit = static_cast<bpUInt64>(aMemoryLimitMB) * 1024 * 1024;
+  mReadAheadMemory = std::make_shared<bpMemoryBudget>(bpMemoryBudget::GetReadAheadShare(vMemoryLimit));
+}
+
+
+void bpConverter::SetNumberOfReaders(bpSize aNumberOfReaders)
+{
+  mNumberOfReaders = aNumberOfReaders > 0 ? aNumberOfReaders : 1;
+}
+
+
+void bpConverter::SetNumberOfJobs(bpSize aNumberOfJobs)
+{
+  mNumberOfJobs = aNumberOfJobs > 0 ? aNumberOfJobs : 1;
+}
+
+
+void bpConverter::SetCheckpointInterval(bpFloat aCheckpointSeconds)
+{
+  mCheckpointInterval = aCheckpointSeconds > 0 ? aCheckpointSeconds : 0;
+}
+
+
+void bpConverter::SetResume(bool aResume)
+{
+  mResume = aResume;
+}
+
+
 void bpConverter::SetCompressionAlgorithmType(bpConverterTypes::tCompressionAlgorithmType aCompressionAlgorithmType)
 {
   mCompressionAlgorithmType = aCompressionAlgorithmType;
@@ -338,7 +459,7 @@ void bpConverter::SetParameterOnce(bpString& aParameter, const bpString& aValue,
   }
   else {
     bpLogger::LogError("You can not set argument \"" + aArgumentName + "\" multiple times. Use --help for details");
-    exit(IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS);
+    throw bpConverterExit(IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS);
   }
 }
 
@@ -366,7 +487,7 @@ bpConverter::cThumbnailSettings& bpConverter::GetThumbnailSettings()
   }
   else {
     bpLogger::LogError("Use option \"-t\" to specify a thumbnail, or call option \"--help\" for more details");
-    exit(IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS);
+    throw bpConverterExit(IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS);
   }
 }
 
@@ -375,7 +496,7 @@ void bpConverter::CheckParameters() const
 {
   if (mInputFileName.empty() && !mPrintSupportedFormats) {
     bpLogger::LogError("Missing input file name. Use --help for details");
-    exit(IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS);
+    throw bpConverterExit(IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS);
   }
 }
 
@@ -415,36 +536,52 @@ bool bpConverter::Execute()
     }
   }
 
+  if (mNumberOfJobs > 1 && !mAdditionalInputFileNames.empty()) {
+    if (WritesOutputFiles()) {
+      bpLogger::LogWarning("Parallel jobs only write to stdout, processing the input files one after the other");
+    }
+    else {
+      std::vector<bpString> vInput{ mInputFileName };
+      vInput.insert(vInput.end(), mAdditionalInputFileNames.begin(), mAdditionalInputFileNames.end());
+      mAdditionalInputFileNames.clear();
+      return ExecuteJobs(vInput) && vSuccess;
+    }
+  }
+
   bool vTriedCreateFileReader = false;
   bpSharedPtr<bpFileReader> vFileReader;
   auto vCreateFileReader = [&vTriedCreateFileReader, &vFileReader, this, &vXMLLayout] {
     if (!vTriedCreateFileReader) {
+      // the result cache checks that the files did not change while the results were computed
+      std::time_t vOpenTime = std::time(nullptr);
+      bpString vInputFileIdentity = bpResultCache::GetFileIdentity(mInputFileName);
       vFileReader = CreateFileReader(mInputFileName, mInputFileFormat, mInputFileImageIndex, vXMLLayout);
       vTriedCreateFileReader = true;
+      mInputFileIdentities.clear();
+      if (vFileReader && !mResultCacheDirectory.empty()) {
+        // the other files of the data set are only known once they were parsed by opening the input file,
+        // one modified since the opening started might have been parsed in either version
+        if (bpResultCache::AddFileIdentities(vFileReader->GetAllFileNamesOfDataSet(), vOpenTime, mInputFileIdentities)) {
+          mInputFileIdentities[mInputFileName] = vInputFileIdentity;
+        }
+        else {
+          mInputFileIdentities.clear();
+        }
+      }
     }
     return !!vFileReader;
   };
 
   // image descriptors output?
   if (mDoImageDescriptorsCalculation || !mImageDescriptorsFileName.empty()) {
-    boost::filesystem::path vInputPath(mInputFileName);
-    bool vIsFound = false;
-
-    for (const auto& vProcessedFileName : mProcessedInputFileNames) {
-      boost::filesystem::path vProcessedPath(vProcessedFileName);
-      boost::system::error_code vErrorCode;
-
-      if (boost::filesystem::equivalent(vInputPath, vProcessedPath, vErrorCode)) {
-        vIsFound = true;
-        break;
+    bool vIsProcessed = IsProcessed(mInputFileName, mProcessedInputFileNames);
+    if (vIsProcessed || !WriteCachedResult("ImageDescriptors", mImageDescriptorsFileName)) {
+      if (!vIsProcessed) {
+        vCreateFileReader(); // empty descriptor is a success
       }
-    }
 
-    if (!vIsFound) {
-      vCreateFileReader(); // empty descriptor is a success
+      vSuccess &= CreateImageDescriptors(vFileReader);
     }
-
-    vSuccess &= CreateImageDescriptors(vFileReader);
   }
 
   // list of all attached files output?
@@ -454,7 +591,7 @@ bool bpConverter::Execute()
 
   // meta info output?
   if (mDoMetaDataCalculation || !mMetaDataFileName.empty()) {
-    vSuccess &= vCreateFileReader() && CreateMetaData(vFileReader);
+    vSuccess &= WriteCachedResult("MetaData", mMetaDataFileName) || (vCreateFileReader() && CreateMetaData(vFileReader));
   }
 
   // meta info output?
@@ -462,19 +599,40 @@ bool bpConverter::Execute()
     vSuccess &= vCreateFileReader() && CreateMetaDataForArena(vFileReader);
   }
 
-  // voxel hash code output?
-  if (mDoVoxelHashCalculation || !mVoxelHashFileName.empty()) {
+  bool vDoVoxelHash = (mDoVoxelHashCalculation || !mVoxelHashFileName.empty()) && !WriteCachedResult("VoxelHash", mVoxelHashFileName);
+  bool vDoConvert = !mOutputFileName.empty() && !mOutputFileFormat.empty();
+  bool vDoThumbnails = !mThumbnailSettings.empty();
+
+  // voxel hash code output? if possible, it's computed from the blocks read for the output file or the thumbnails
+  bpSharedPtr<bpVoxelHashBlocks> vVoxelHash;
+  if (vDoVoxelHash && (vDoConvert || vDoThumbnails) && vCreateFileReader()) {
+    vVoxelHash = CreateVoxelHashBlocks(vFileReader);
+  }
+  if (vDoVoxelHash && !vVoxelHash) {
     vSuccess &= vCreateFileReader() && CreateVoxelHash(vFileReader);
   }
 
-  // Did the user request writing an output file?
-  if (!mOutputFileName.empty() && !mOutputFileFormat.empty()) {
-    vSuccess &= vCreateFileReader() && CheckIfVoxelSizeIsKnown(vFileReader) && ConvertFile(vFileReader);
+  // Did the user request writing an output file? the thumbnails are written in the same pass
+  bool vThumbnailsDone = false;
+  if (vDoConvert) {
+    std::vector<bpImageConvertNew::cThumbnailOutput> vFailedThumbnails;
+    bool vConverted = vCreateFileReader() && CheckIfVoxelSizeIsKnown(vFileReader) && ConvertFile(vFileReader, vDoThumbnails, vVoxelHash.get(), vFailedThumbnails);
+    vThumbnailsDone = vConverted;
+    vSuccess &= vConverted;
+    // the output file is complete, only the failed thumbnails are written again
+    if (vConverted && !vFailedThumbnails.empty()) {
+      vSuccess &= CreateThumbnails(vFileReader, nullptr, vFailedThumbnails);
+    }
   }
 
   // Did the user request writing thumbnails?
-  if (!mThumbnailSettings.empty()) {
-    vSuccess &= vCreateFileReader() && CreateThumbnails(vFileReader);
+  if (vDoThumbnails && !vThumbnailsDone) {
+    vSuccess &= vCreateFileReader() && CreateThumbnails(vFileReader, vDoConvert ? nullptr : vVoxelHash.get());
+  }
+
+  // read the blocks again, if the pass above didn't see all of them
+  if (vVoxelHash) {
+    vSuccess &= CreateVoxelHash(vFileReader, vVoxelHash.get());
   }
 
   if (!mAdditionalInputFileNames.empty()) {
@@ -490,6 +648,192 @@ bool bpConverter::Execute()
 }
 
 
+bool bpConverter::WritesOutputFiles() const
+{
+  // the throughput is measured for the whole process and printed by the fetcher thread, not per job
+  return !mOutputFileName.empty() || !mThumbnailSettings.empty() || !mAllFilesFileName.empty() || !mMetaDataFileName.empty() ||
+    !mMetaDataForArenaFileName.empty() || !mVoxelHashFileName.empty() || !mImageDescriptorsFileName.empty() ||
+    mThroughputOutputInterval > 0 || !mThroughputJsonFileName.empty();
+}
+
+
+bpString bpConverter::GetResultCacheKey(const bpString& aResultName) const
+{
+  // everything that changes the result, except for the content of the input files
+  std::vector<bpString> vKey{
+    aResultName,
+    IMARISCONVERT_VERSION_MAJOR_STR "." IMARISCONVERT_VERSION_MINOR_STR "." IMARISCONVERT_VERSION_PATCH_STR IMARISCONVERT_VERSION_BUILD_STR " " BP_REVISION_NUMBER_STR,
+    bpFileTools::GetAbsoluteFilePath(mInputFileName),
+    mInputFileFormat,
+    bpToString(mInputFileImageIndex),
+    bpToString(mInputFileCropSizes, ","),
+    bpToString(mInputVoxelSize),
+    ReadXMLLayoutFromFile(),
+    bpToString(bpFileReaderImpl::GetColorHint()),
+    bpToString(bpFileReaderImpl::GetDefaultColors(), ",")
+  };
+  if (!mMetadataLevel.empty()) {
+    vKey.push_back(mMetadataLevel);
+  }
+  for (const auto& vDelimiters : mFileSeriesDelimiters.GetDelimiters()) {
+    vKey.push_back(bpToString(static_cast<bpSize>(vDelimiters.first)) + ":" + vDelimiters.second);
+  }
+  if (aResultName == "VoxelHash") {
+    vKey.push_back(mVoxelHashBlockSort);
+    vKey.push_back(bpToString(mVoxelHashVersion));
+  }
+  return bpJoin(vKey, "|");
+}
+
+
+bool bpConverter::WriteCachedResult(const bpString& aResultName, const bpString& aOutputFileName)
+{
+  if (mResultCacheDirectory.empty()) {
+    return false;
+  }
+
+  bpString vResult;
+  bpResultCache vCache(mResultCacheDirectory);
+  if (!vCache.Read(GetResultCacheKey(aResultName), vResult, mProcessedInputFileNames)) {
+    return false;
+  }
+
+  bpOutput vOutput;
+  if (aOutputFileName.empty()) {
+    vOutput.SetSink(bpOutput::eSinkStdCOut);
+  }
+  else {
+    vOutput.SetSink(bpOutput::eSinkFile);
+    vOutput.SetOutputFileName(aOutputFileName);
+  }
+
+  try {
+    vOutput.Write(vResult);
+  }
+  catch (std::exception& aException) {
+    bpLogger::LogError(bpString(aException.what()) + " on " + mInputFileName);
+    return false;
+  }
+  return true;
+}
+
+
+void bpConverter::StoreResult(const bpString& aResultName, const bpSharedPtr<bpFileReader>& aFileReader, const std::set<bpString>& aProcessedFileNames, const bpString& aResult) const
+{
+  // results of failed reads are not stored, they might succeed next time
+  if (mResultCacheDirectory.empty() || !aFileReader || mInputFileIdentities.empty() || aResult.find("<Crash/>") != bpString::npos) {
+    return;
+  }
+
+  bpResultCache vCache(mResultCacheDirectory);
+  vCache.Write(GetResultCacheKey(aResultName), mInputFileIdentities, aProcessedFileNames, aResult);
+}
+
+
+bool bpConverter::ExecuteJobs(const std::vector<bpString>& aInputFileNames)
+{
+  bpSize vNumberOfJobs = std::min<bpSize>(mNumberOfJobs, aInputFileNames.size());
+  // the jobs running at the same time share the compression threads
+  bpSize vNumberOfThreadsPerJob = std::max<bpSize>(mNumberOfThreads / vNumberOfJobs, 1);
+
+  std::vector<cJob> vJobs(aInputFileNames.size());
+  for (bpSize vIndex = 0; vIndex < aInputFileNames.size(); vIndex++) {
+    vJobs[vIndex].mInputFileName = aInputFileNames[vIndex];
+  }
+
+  std::mutex vMutex;
+  std::condition_variable vJobDone;
+  bpSize vNextJob = 0;
+  std::vector<std::thread> vThreads;
+  for (bpSize vIndex = 0; vIndex < vNumberOfJobs; vIndex++) {
+    vThreads.emplace_back([this, &vJobs, &vMutex, &vJobDone, &vNextJob, vNumberOfThreadsPerJob] {
+      while (true) {
+        cJob* vJob = nullptr;
+        {
+          std::lock_guard<std::mutex> vLock(vMutex);
+          if (vNextJob == vJobs.size()) {
+            return;
+          }
+          vJob = &vJobs[vNextJob++];
+        }
+        ExecuteJob(*vJob, vNumberOfThreadsPerJob, mProcessedInputFileNames);
+        {
+          std::lock_guard<std::mutex> vLock(vMutex);
+          vJob->mDone = true;
+        }
+        vJobDone.notify_all();
+      }
+    });
+  }
+
+  // write the results in the order of the list, as if the files were processed one after the other
+  std::set<bpString> vProcessedInputFileNames = mProcessedInputFileNames;
+  bpSize vNumberOfFailedJobs = 0;
+  for (cJob& vJob : vJobs) {
+    {
+      std::unique_lock<std::mutex> vLock(vMutex);
+      vJobDone.wait(vLock, [&vJob] { return vJob.mDone; });
+    }
+
+    // the job did not know that the file is part of an image of a previous file (see image descriptors)
+    if (IsProcessed(vJob.mInputFileName, vProcessedInputFileNames)) {
+      ExecuteJob(vJob, vNumberOfThreadsPerJob, vProcessedInputFileNames);
+    }
+    vProcessedInputFileNames.insert(vJob.mProcessedInputFileNames.begin(), vJob.mProcessedInputFileNames.end());
+
+    std::cout << vJob.mOutput << std::flush;
+    if (!vJob.mSuccess) {
+      ++vNumberOfFailedJobs;
+    }
+  }
+
+  for (std::thread& vThread : vThreads) {
+    vThread.join();
+  }
+  mProcessedInputFileNames = std::move(vProcessedInputFileNames);
+
+  for (const cJob& vJob : vJobs) {
+    bpString vMessage = "\"" + vJob.mInputFileName + "\" " + (vJob.mSuccess ? "succeeded" : "failed") + " after " + bpToString(vJob.mSeconds) + " s";
+    vJob.mSuccess ? bpLogger::LogInfo(vMessage) : bpLogger::LogError(vMessage);
+  }
+  bpString vSummary = bpToString(vJobs.size() - vNumberOfFailedJobs) + " of " + bpToString(vJobs.size()) + " files processed successfully with " + bpToString(vNumberOfJobs) + " jobs";
+  vNumberOfFailedJobs == 0 ? bpLogger::LogInfo(vSummary) : bpLogger::LogError(vSummary);
+
+  return vNumberOfFailedJobs == 0;
+}
+
+
+void bpConverter::ExecuteJob(cJob& aJob, bpSize aNumberOfThreads, const std::set<bpString>& aProcessedInputFileNames) const
+{
+  // every job works on its own copy of the settings
+  bpConverter vConverter(*this);
+  vConverter.mInputFileName = aJob.mInputFileName;
+  vConverter.mAdditionalInputFileNames.clear();
+  vConverter.mProcessedInputFileNames = aProcessedInputFileNames;
+  vConverter.mNumberOfJobs = 1;
+  vConverter.mNumberOfThreads = aNumberOfThreads;
+
+  aJob.mOutput.clear();
+  auto vStart = std::chrono::steady_clock::now();
+  {
+    bpOutput::cCaptureStdCOut vCapture(aJob.mOutput);
+    try {
+      aJob.mSuccess = vConverter.Execute();
+    }
+    catch (std::exception& vException) {
+      bpLogger::LogError("Error during conversion : '" + bpString(vException.what()) + " on " + aJob.mInputFileName);
+      aJob.mSuccess = false;
+    }
+    catch (...) {
+      bpLogger::LogError("Unknown error during conversion on " + aJob.mInputFileName);
+      aJob.mSuccess = false;
+    }
+  }
+  aJob.mSeconds = std::chrono::duration<bpFloat>(std::chrono::steady_clock::now() - vStart).count();
+  aJob.mProcessedInputFileNames = std::move(vConverter.mProcessedInputFileNames);
+}
+
+
 bpSharedPtr<bpFileReader> bpConverter::CreateFileReader(const bpString& aInputFileName,
                                                          const bpString& aInputFileFormat,
                                                          bpSize aInputFileImageIndex,
@@ -498,6 +842,9 @@ bpSharedPtr<bpFileReader> bpConverter::CreateFileReader(const bpString& aInputFi
   bpFileReader::tPtr vFileReader;
 
   try {
+    GetFileReaderFactory()->SetMetadataLevel(GetMetadataLevel());
+    GetFileReaderFactory()->SetReaderStateCache(mReaderMemoDirectory, mReaderMemoMinimumElapsed);
+
     if (!aInputFileFormat.empty()) {
       vFileReader = GetFileReaderFactory()->CreateFileReader(aInputFileName, aInputFileFormat);
     }
@@ -551,9 +898,115 @@ bpSharedPtr<bpFileReader> bpConverter::CreateFileReader(const bpString& aInputFi
 }
 
 
-bool bpConverter::ConvertFile(bpSharedPtr<bpFileReader> aFileReader)
+std::vector<bpSharedPtr<bpFileReader>> bpConverter::CreateAdditionalFileReaders(bpSharedPtr<bpFileReader> aFileReader) const
+{
+  std::vector<bpSharedPtr<bpFileReader>> vFileReaders;
+  if (mNumberOfReaders < 2 || !aFileReader->GetReaderImpl()) {
+    return vFileReaders;
+  }
+
+  // open the same image again, re-using the series layout of the first reader
+  bpString vXMLLayout;
+  if (aFileReader->GetReaderImpl()->SeriesConfigurable()) {
+    std::vector<bpString> vXMLLayouts = aFileReader->GetFileSeriesLayoutXmls();
+    if (!vXMLLayouts.empty()) {
+      vXMLLayout = vXMLLayouts.front();
+    }
+  }
+
+  for (bpSize vIndex = 1; vIndex < mNumberOfReaders; ++vIndex) {
+    bpSharedPtr<bpFileReader> vFileReader = CreateFileReader(mInputFileName, mInputFileFormat, aFileReader->GetActiveDataSetIndex(), vXMLLayout);
+    if (!vFileReader || !vFileReader->GetReaderImpl()) {
+      bpLogger::LogInfo("Continue with " + bpToString(vIndex) + " readers on " + mInputFileName);
+      break;
+    }
+    vFileReaders.push_back(vFileReader);
+  }
+  return vFileReaders;
+}
+
+
+std::vector<bpImageConvertNew::cThumbnailOutput> bpConverter::GetThumbnailOutputs() const
 {
-  mMeasurementFetcherThread.Start(mThroughputOutputInterval);
+  std::vector<bpImageConvertNew::cThumbnailOutput> vThumbnails;
+  for (const cThumbnailSettings& vThumbnailSettings : mThumbnailSettings) {
+    // keep the user informed
+    bpLogger::LogInfo("Generate Thumbnail ("
+      + bpToString(vThumbnailSettings.mSliceIndexZ) + " "
+      + bpToString(vThumbnailSettings.mTimeIndex) + " "
+      + vThumbnailSettings.mMode + " "
+      + bpToString(vThumbnailSettings.mImageSize) + " "
+      + vThumbnailSettings.mBackground + " "
+      + vThumbnailSettings.mOutputFormat + ") on "
+      + mInputFileName);
+
+    // skip, if there is no name
+    if (vThumbnailSettings.mFileName.empty()) {
+      continue;
+    }
+
+    // keep the user informed
+    bpLogger::LogInfo("Save as " + vThumbnailSettings.mFileName + " of " + mInputFileName);
+
+    bpImageConvertNew::cThumbnailOutput vThumbnail;
+    vThumbnail.mOutputFile = vThumbnailSettings.mFileName;
+    vThumbnail.mCompressThumbnail = vThumbnailSettings.mOutputFormat == "jpg" || vThumbnailSettings.mOutputFormat == "jpeg";
+    vThumbnails.push_back(vThumbnail);
+  }
+  return vThumbnails;
+}
+
+
+bpSharedPtr<bpVoxelHashBlocks> bpConverter::CreateVoxelHashBlocks(bpSharedPtr<bpFileReader> aFileReader) const
+{
+  // only the block hash of one uncropped image is computed from the blocks of the other outputs,
+  // the sequential hash depends on the order of the blocks
+  const auto& vReaderImpl = aFileReader->GetReaderImpl();
+  bool vIsCropped = std::any_of(mInputFileCropSizes.begin(), mInputFileCropSizes.end(), [](bpSize aSize) { return aSize != 0; });
+  bool vIsOneImage = mInputFileImageIndex != static_cast<bpSize>(-1) || aFileReader->GetNumberOfDataSets() == 1;
+  if (mVoxelHashVersion != bpFileInfo::eVoxelHashBlocks || vIsCropped || !vIsOneImage || !vReaderImpl) {
+    return {};
+  }
+
+  try {
+    vReaderImpl->SetActiveResolutionLevel(0);
+    return std::make_shared<bpVoxelHashBlocks>(vReaderImpl->GetDataSizeV(), vReaderImpl->GetDataBlockSizeV(), bpGetSizeOfType(vReaderImpl->GetDataType()));
+  }
+  catch (const std::exception& vException) {
+    bpLogger::LogWarning(bpString(vException.what()) + " on " + mInputFileName);
+    return {};
+  }
+}
+
+
+bpfFileReaderImplFactoryBase::tMetadataLevel bpConverter::GetMetadataLevel() const
+{
+  if (mMetadataLevel == "minimum") {
+    return bpfFileReaderImplFactoryBase::eMetadataLevelMinimum;
+  }
+  if (mMetadataLevel == "no_overlays") {
+    return bpfFileReaderImplFactoryBase::eMetadataLevelNoOverlays;
+  }
+  if (mMetadataLevel == "all") {
+    return bpfFileReaderImplFactoryBase::eMetadataLevelAll;
+  }
+
+  // the output file and the meta data outputs keep all parameters, the thumbnails need colors and voxel sizes,
+  // the voxel hash and the list of files only need the image layout
+  if (!mOutputFileName.empty() || mDoMetaDataCalculation || !mMetaDataFileName.empty() || mDoMetaDataForArenaCalculation ||
+      !mMetaDataForArenaFileName.empty() || mDoImageDescriptorsCalculation || !mImageDescriptorsFileName.empty()) {
+    return bpfFileReaderImplFactoryBase::eMetadataLevelAll;
+  }
+  if (!mThumbnailSettings.empty()) {
+    return bpfFileReaderImplFactoryBase::eMetadataLevelNoOverlays;
+  }
+  return bpfFileReaderImplFactoryBase::eMetadataLevelMinimum;
+}
+
+
+bool bpConverter::ConvertFile(bpSharedPtr<bpFileReader> aFileReader, bool aWithThumbnails, bpVoxelHashBlocks* aVoxelHash, std::vector<bpImageConvertNew::cThumbnailOutput>& aFailedThumbnails)
+{
+  mMeasurementFetcherThread.Start(static_cast<bpUInt32>(mThroughputOutputInterval), mThroughputJsonFileName, mInputFileName);
 
   bool vSuccess = true;
   try {
@@ -563,7 +1016,36 @@ bool bpConverter::ConvertFile(bpSharedPtr<bpFileReader> aFileReader)
     vOptions.mEnableLogProgress = mEnableLogProgress;
     vOptions.mNumberOfThreads = mNumberOfThreads;
     vOptions.mCompressionAlgorithmType = mCompressionAlgorithmType;
-    bpImageConvertNew::Convert(aFileReader, mOutputFileName, {}, vOptions);
+
+    bpImageConvertNew::cConvertOptions vConvertOptions;
+    vConvertOptions.mReadAheadBlocks = mReadAheadBlocks;
+    vConvertOptions.mReadAheadMemory = mReadAheadMemory;
+    vConvertOptions.mAdditionalReaders = CreateAdditionalFileReaders(aFileReader);
+    if (aWithThumbnails) {
+      vConvertOptions.mThumbnails = GetThumbnailOutputs();
+    }
+    if (aVoxelHash) {
+      vConvertOptions.mBlockCallback = [aVoxelHash](bpSize aBlockNumber, const void* aDataBlock) {
+        aVoxelHash->AddBlock(aBlockNumber, aDataBlock);
+      };
+    }
+    if (mCheckpointInterval > 0 || mResume) {
+      // a journal is only resumed if neither the options nor the files of the image changed
+      std::vector<bpString> vJournalKey{ GetResultCacheKey("Convert") };
+      for (const bpString& vFileName : aFileReader->GetAllFileNamesOfDataSet()) {
+        vJournalKey.push_back(bpResultCache::GetFileIdentity(vFileName));
+      }
+      vConvertOptions.mJournalKey = bpJoin(vJournalKey, "|");
+      vConvertOptions.mCheckpointInterval = mCheckpointInterval > 0 ? mCheckpointInterval : 60;
+      vConvertOptions.mResume = mResume;
+    }
+    aFailedThumbnails = bpImageConvertNew::Convert(aFileReader, mOutputFileName, vConvertOptions, vOptions);
+    for (const auto& vThumbnail : aFailedThumbnails) {
+      bpLogger::LogWarning("Unable to write \"" + vThumbnail.mOutputFile + "\" along with the conversion, writing it separately");
+    }
+    if (!vConvertOptions.mThumbnails.empty() && aFailedThumbnails.empty()) {
+      bpLogger::LogInfo("Thumbnail Saved of " + mInputFileName);
+    }
   }
   catch (std::exception& vException) {
     bpLogger::LogError("Error during conversion : '" + bpString(vException.what()) + " on " + mInputFileName);
@@ -646,48 +1128,51 @@ bpString bpConverter::ReadXMLLayoutFromFile() const
 //}
 
 
-bool bpConverter::CreateThumbnails(bpSharedPtr<bpFileReader> aFileReader) const
+bool bpConverter::CreateThumbnails(bpSharedPtr<bpFileReader> aFileReader, bpVoxelHashBlocks* aVoxelHash) const
 {
-  bool vSuccess = true;
-  // loop over all thumbnails
-  for (const cThumbnailSettings& vThumbnailSettings : mThumbnailSettings) {
-    // keep the user informed
-    bpLogger::LogInfo("Generate Thumbnail ("
-      + bpToString(vThumbnailSettings.mSliceIndexZ) + " "
-      + bpToString(vThumbnailSettings.mTimeIndex) + " "
-      + vThumbnailSettings.mMode + " "
-      + bpToString(vThumbnailSettings.mImageSize) + " "
-      + vThumbnailSettings.mBackground + " "
-      + vThumbnailSettings.mOutputFormat + ") on "
-      + mInputFileName);
+  return CreateThumbnails(aFileReader, aVoxelHash, GetThumbnailOutputs());
+}
 
-    // skip, if there is no name
-    if (vThumbnailSettings.mFileName.empty()) {
-      continue;
-    }
 
-    // keep the user informed
-    bpLogger::LogInfo("Save as " + vThumbnailSettings.mFileName + " of " + mInputFileName);
+bool bpConverter::CreateThumbnails(bpSharedPtr<bpFileReader> aFileReader, bpVoxelHashBlocks* aVoxelHash, const std::vector<bpImageConvertNew::cThumbnailOutput>& aThumbnails) const
+{
+  if (aThumbnails.empty()) {
+    return true;
+  }
 
-    bpImageConvertNew::cConvertOptions vConvertOptions;
-    vConvertOptions.mWriteMode = bpImageConvertNew::eWriteThumbnailOnly;
-    vConvertOptions.mCompressThumbnail = vThumbnailSettings.mOutputFormat == "jpg" || vThumbnailSettings.mOutputFormat == "jpeg";
+  // all thumbnails are written from one pass over the blocks
+  bpImageConvertNew::cConvertOptions vConvertOptions;
+  vConvertOptions.mWriteMode = bpImageConvertNew::eWriteThumbnailOnly;
+  vConvertOptions.mCompressThumbnail = aThumbnails.front().mCompressThumbnail;
+  vConvertOptions.mReadAheadBlocks = mReadAheadBlocks;
+  vConvertOptions.mReadAheadMemory = mReadAheadMemory;
+  vConvertOptions.mThumbnails.assign(aThumbnails.begin() + 1, aThumbnails.end());
+  if (aVoxelHash) {
+    vConvertOptions.mBlockCallback = [aVoxelHash](bpSize aBlockNumber, const void* aDataBlock) {
+      aVoxelHash->AddBlock(aBlockNumber, aDataBlock);
+    };
+  }
 
-    bpConverterTypes::cOptions vOptions;
-    vOptions.mEnableLogProgress = mEnableLogProgress;
+  bpConverterTypes::cOptions vOptions;
+  vOptions.mEnableLogProgress = mEnableLogProgress;
 
-    try {
-      bpImageConvertNew::Convert(aFileReader, vThumbnailSettings.mFileName, vConvertOptions, vOptions);
-    }
-    catch (const std::exception& vException) {
-      bpLogger::LogError("Unable to convert \"" + vThumbnailSettings.mFileName + "\"");
-      bpLogger::LogError(vException.what());
+  bool vSuccess = true;
+  try {
+    for (const auto& vThumbnail : bpImageConvertNew::Convert(aFileReader, aThumbnails.front().mOutputFile, vConvertOptions, vOptions)) {
+      bpLogger::LogError("Unable to convert \"" + vThumbnail.mOutputFile + "\"");
       vSuccess = false;
     }
-
-    vSuccess ? bpLogger::LogInfo("Thumbnail Saved of " + mInputFileName) : bpLogger::LogError("Thumbnail Failed of " + mInputFileName);
+  }
+  catch (const std::exception& vException) {
+    for (const auto& vThumbnail : aThumbnails) {
+      bpLogger::LogError("Unable to convert \"" + vThumbnail.mOutputFile + "\"");
+    }
+    bpLogger::LogError(vException.what());
+    vSuccess = false;
   }
 
+  vSuccess ? bpLogger::LogInfo("Thumbnail Saved of " + mInputFileName) : bpLogger::LogError("Thumbnail Failed of " + mInputFileName);
+
   return vSuccess;
 }
 
@@ -758,6 +1243,7 @@ bool bpConverter::CreateMetaData(bpSharedPtr<bpFileReader> aFileReader) const
     // finally write out
     vOutput.Write("<?xml version = \"1.0\" encoding = \"UTF-8\"?>\n");
     vOutput.Write(vXML);
+    StoreResult("MetaData", aFileReader, {}, "<?xml version = \"1.0\" encoding = \"UTF-8\"?>\n" + vXML);
 
     // finished
     bpLogger::LogInfo("Finished writing metadata of " + mInputFileName);
@@ -811,7 +1297,7 @@ bool bpConverter::CreateMetaDataForArena(bpSharedPtr<bpFileReader> aFileReader)
 }
 
 
-bool bpConverter::CreateVoxelHash(bpSharedPtr<bpFileReader> aFileReader) const
+bool bpConverter::CreateVoxelHash(bpSharedPtr<bpFileReader> aFileReader, const bpVoxelHashBlocks* aVoxelHash) const
 {
   bool vSuccess = true;
 
@@ -830,12 +1316,29 @@ bool bpConverter::CreateVoxelHash(bpSharedPtr<bpFileReader> aFileReader) const
   bpLogger::LogInfo(vLogMessage);
 
   try {
-    // get the xml information
-    bpString vXML = bpFileInfo::GetXML_ReadVoxelHash(mInputFileName, aFileReader, mInputFileImageIndex, mVoxelHashBlockSort);
+    // get the xml information, the block hash reads with all readers (unless all blocks were already hashed)
+    bpString vXML;
+    if (aVoxelHash && aVoxelHash->IsComplete()) {
+      vXML = bpFileInfo::GetXML_VoxelHash(aFileReader, aFileReader->GetActiveDataSetIndex(), *aVoxelHash);
+    }
+    else {
+      // thumbnails may have left the reader on a smaller resolution level
+      if (aFileReader->GetReaderImpl()) {
+        aFileReader->GetReaderImpl()->SetActiveResolutionLevel(0);
+      }
+      auto vVersion = static_cast<bpFileInfo::tVoxelHashVersion>(mVoxelHashVersion);
+      std::vector<bpSharedPtr<bpFileReader>> vAdditionalFileReaders;
+      if (vVersion == bpFileInfo::eVoxelHashBlocks) {
+        vAdditionalFileReaders = CreateAdditionalFileReaders(aFileReader);
+      }
+      vXML = bpFileInfo::GetXML_ReadVoxelHash(mInputFileName, aFileReader, mInputFileImageIndex, mVoxelHashBlockSort,
+                                              vVersion, vAdditionalFileReaders, mNumberOfThreads);
+    }
 
     // finally write out
     vOutput.Write("<?xml version = \"1.0\" encoding = \"UTF-8\"?>\n");
     vOutput.Write(vXML);
+    StoreResult("VoxelHash", aFileReader, {}, "<?xml version = \"1.0\" encoding = \"UTF-8\"?>\n" + vXML);
 
     // finished
     bpLogger::LogInfo("Finished writing voxelhash of " + mInputFileName);
@@ -868,12 +1371,15 @@ bool bpConverter::CreateImageDescriptors(bpSharedPtr<bpFileReader> aFileReader)
 
   try {
     bpImageDescriptorFactory::tFilesDescriptors vFileDescriptors;
-    if (aFileReader && mProcessedInputFileNames.find(mInputFileName) == mProcessedInputFileNames.end()) {
+    std::set<bpString> vProcessedFileNames;
+    bool vIsProcessed = mProcessedInputFileNames.find(mInputFileName) != mProcessedInputFileNames.end();
+    if (aFileReader && !vIsProcessed) {
       vFileDescriptors = bpImageDescriptorFactory::CreateImageDescriptors(mInputFileName, aFileReader);
       for (const auto& vImageDescriptors : vFileDescriptors) {
-        mProcessedInputFileNames.insert(vImageDescriptors.first);
-        mProcessedInputFileNames.insert(vImageDescriptors.second.mImageDependencies.begin(), vImageDescriptors.second.mImageDependencies.end());
+        vProcessedFileNames.insert(vImageDescriptors.first);
+        vProcessedFileNames.insert(vImageDescriptors.second.mImageDependencies.begin(), vImageDescriptors.second.mImageDependencies.end());
       }
+      mProcessedInputFileNames.insert(vProcessedFileNames.begin(), vProcessedFileNames.end());
     }
 
     auto vXmlTree = bpImageDescriptorXmlTree::ToXml(vFileDescriptors);
@@ -887,6 +1393,9 @@ bool bpConverter::CreateImageDescriptors(bpSharedPtr<bpFileReader> aFileReader)
     // finally write out
     vOutput.Write("<?xml version = \"1.0\" encoding = \"UTF-8\"?>\n");
     vOutput.Write(vXML);
+    if (!vIsProcessed) {
+      StoreResult("ImageDescriptors", aFileReader, vProcessedFileNames, "<?xml version = \"1.0\" encoding = \"UTF-8\"?>\n" + vXML);
+    }
 
     // finished
     bpLogger::LogInfo("Finished writing Image Descriptors of " + mInputFileName);
@@ -937,7 +1446,7 @@ bool bpConverter::CheckIfVoxelSizeIsKnown(bpSharedPtr<bpFileReader> aFileReader)
            << " Please use the option -vs to specify the voxel size."
            << " To set the voxel size along a particular axis use the options -vsx, -vsy, and/or -vsz.";
     bpLogger::LogError(vError.str());
-    exit(IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS);
+    throw bpConverterExit(IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS);
   }
   else {
     return true;
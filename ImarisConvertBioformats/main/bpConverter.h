@@ -22,12 +22,16 @@
 
 
 #include "../src/bpThroughputMeasurementsFetcher.h"
+#include "../src/bpImageConvertNew.h"
 
 #include "../meta/bpFileSeriesDelimiters.h"
+#include "bpResultCache.h"
+#include "fileiobase/application/bpfFileReaderImplFactoryBase.h"
 
 class bpParameterSection;
 class bpFileReaderFactory;
 class bpFileReader;
+class bpVoxelHashBlocks;
 
 #define IMARIS_CONVERT_EXIT_SUCCESS              0
 #define IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS    2
@@ -35,6 +39,22 @@ class bpFileReader;
 #define IMARIS_CONVERT_EXIT_ABNORMAL_TERMINATION 4
 #define IMARIS_CONVERT_EXIT_TIMEOUT              99
 
+/**
+ * Thrown where the command line tool used to exit the process (invalid arguments, help),
+ * so that a long running server can answer the request and carry on with the next one.
+ * Not derived from std::exception to pass through the error handling of the conversion.
+ */
+class bpConverterExit
+{
+public:
+  explicit bpConverterExit(int aExitCode) : mExitCode(aExitCode) {}
+
+  int GetExitCode() const { return mExitCode; }
+
+private:
+  int mExitCode;
+};
+
 /**
  * Performs the conversion of an image file into meta-data, voxel-hash,
  * thumbnails, or other image formats.
@@ -67,15 +87,27 @@ public:
   void SetThumbnailMaxSizeXY(bpSize aThumbnailMaxSizeXY);
   void SetThumbnailOutputFormat(const bpString& aOutputFormat);
   void SetThroughputOutputInterval(bpUInt32 aTimeIntervalInMs);
+  void SetThroughputJsonFileName(const bpString& aJsonFileName, const bpString& aArgumentName);
   void SetAllFilesFileName(const bpString& aMetaDataFileName, const bpString& aArgumentName);
   void SetMetaDataFileName(const bpString& aMetaDataFileName, const bpString& aArgumentName);
   void SetMetaDataForArenaFileName(const bpString& aMetaDataFileName, const bpString& aArgumentName);
   void SetVoxelHashFileName(const bpString& aVoxelHashFileName, const bpString& aArgumentName);
   void SetVoxelHashBlockSort(const bpString& aVoxelHashBlockSort, const bpString& aArgumentName);
+  void SetVoxelHashVersion(bpSize aVoxelHashVersion);
+  void SetMetadataLevel(const bpString& aMetadataLevel);
   void SetNumberOfThreads(bpSize aNumberOfThreads);
+  void SetReadAheadBlocks(bpSize aReadAheadBlocks);
+  void SetMemoryLimit(bpSize aMemoryLimitMB);
+  void SetNumberOfReaders(bpSize aNumberOfReaders);
+  void SetNumberOfJobs(bpSize aNumberOfJobs);
+  void SetCheckpointInterval(bpFloat aCheckpointSeconds);
+  void SetResume(bool aResume);
   void SetCompressionAlgorithmType(bpConverterTypes::tCompressionAlgorithmType aCompressionAlgorithmType);
   void SetImageDescriptorsFileName(const bpString& aImageDescriptorsFileName, const bpString& aArgumentName);
   void SetLogFile(const bpString& aLogFile, const bpString& aArgumentName);
+  void SetResultCacheDirectory(const bpString& aResultCacheDirectory, const bpString& aArgumentName);
+  void SetReaderMemoDirectory(const bpString& aReaderMemoDirectory, const bpString& aArgumentName);
+  void SetReaderMemoMinimumElapsed(bpSize aMinimumMilliseconds);
   void SetEnableLogProgress(bool aEnableLogProgress);
   void SetPrintSupportedFormats(bool aEnable);
 
@@ -108,20 +140,41 @@ private:
     bpString mOutputFormat;
   };
 
+  class cJob {
+  public:
+    bpString mInputFileName;
+    bpString mOutput;
+    std::set<bpString> mProcessedInputFileNames;
+    bool mSuccess = false;
+    bool mDone = false;
+    bpFloat mSeconds = 0;
+  };
+
   // helpers
   cThumbnailSettings& GetThumbnailSettings();
   void SetParameterOnce(bpString& aParameter, const bpString& aValue, const bpString& aArgumentName);
   bpSharedPtr<bpFileReader> CreateFileReader(const bpString& aInputFileName, const bpString& aInputFileFormat, bpSize aInputFileImageIndex, bpString aXMLLayout = "") const;
+  std::vector<bpSharedPtr<bpFileReader>> CreateAdditionalFileReaders(bpSharedPtr<bpFileReader> aFileReader) const;
   bpUInt64 GetValueFromHexString(const bpString& aValue) const;
   bpString ReadXMLLayoutFromFile() const;
+  bool WritesOutputFiles() const;
+  bpString GetResultCacheKey(const bpString& aResultName) const;
+  bool WriteCachedResult(const bpString& aResultName, const bpString& aOutputFileName);
+  void StoreResult(const bpString& aResultName, const bpSharedPtr<bpFileReader>& aFileReader, const std::set<bpString>& aProcessedFileNames, const bpString& aResult) const;
+  std::vector<bpImageConvertNew::cThumbnailOutput> GetThumbnailOutputs() const;
+  bpSharedPtr<bpVoxelHashBlocks> CreateVoxelHashBlocks(bpSharedPtr<bpFileReader> aFileReader) const;
+  bpfFileReaderImplFactoryBase::tMetadataLevel GetMetadataLevel() const;
 
   // workers
-  bool ConvertFile(bpSharedPtr<bpFileReader> aFileReader);
-  bool CreateThumbnails(bpSharedPtr<bpFileReader> aFileReader) const;
+  bool ConvertFile(bpSharedPtr<bpFileReader> aFileReader, bool aWithThumbnails, bpVoxelHashBlocks* aVoxelHash, std::vector<bpImageConvertNew::cThumbnailOutput>& aFailedThumbnails);
+  bool ExecuteJobs(const std::vector<bpString>& aInputFileNames);
+  void ExecuteJob(cJob& aJob, bpSize aNumberOfThreads, const std::set<bpString>& aProcessedInputFileNames) const;
+  bool CreateThumbnails(bpSharedPtr<bpFileReader> aFileReader, bpVoxelHashBlocks* aVoxelHash) const;
+  bool CreateThumbnails(bpSharedPtr<bpFileReader> aFileReader, bpVoxelHashBlocks* aVoxelHash, const std::vector<bpImageConvertNew::cThumbnailOutput>& aThumbnails) const;
   bool CreateAllFiles(bpSharedPtr<bpFileReader> aFileReader) const;
   bool CreateMetaData(bpSharedPtr<bpFileReader> aFileReader) const;
   bool CreateMetaDataForArena(bpSharedPtr<bpFileReader> aFileReader) const;
-  bool CreateVoxelHash(bpSharedPtr<bpFileReader> aFileReader) const;
+  bool CreateVoxelHash(bpSharedPtr<bpFileReader> aFileReader, const bpVoxelHashBlocks* aVoxelHash = nullptr) const;
   bool CreateImageDescriptors(bpSharedPtr<bpFileReader> aFileReader);
   bool ConfigureSeriesReader(bpSharedPtr<bpFileReader> aFileReader) const;
   bool CheckIfVoxelSizeIsKnown(bpSharedPtr<bpFileReader> aFileReader) const;
@@ -143,10 +196,22 @@ private:
   bpString mMetaDataForArenaFileName;
   bpString mVoxelHashFileName;
   bpString mVoxelHashBlockSort;
+  bpSize mVoxelHashVersion;
+  bpString mMetadataLevel;
   bpString mImageDescriptorsFileName;
   std::vector<cThumbnailSettings> mThumbnailSettings;
   bpString mLogFile;
+  bpString mResultCacheDirectory;
+  bpResultCache::tFileIdentities mInputFileIdentities; // taken when the reader is created, before the files are read
+  bpString mReaderMemoDirectory;
+  bpSize mReaderMemoMinimumElapsed;
   bpSize mNumberOfThreads;
+  bpSize mReadAheadBlocks;
+  bpSharedPtr<bpMemoryBudget> mReadAheadMemory; // shared by the jobs
+  bpSize mNumberOfReaders;
+  bpSize mNumberOfJobs;
+  bpFloat mCheckpointInterval; // seconds, no journal if 0
+  bool mResume;
   bpConverterTypes::tCompressionAlgorithmType mCompressionAlgorithmType;
 
   bpThroughputMeasurementsFetcher mMeasurementFetcherThread;
@@ -160,6 +225,7 @@ private:
   bool mPrintSupportedFormats;
 
   bpFloat mThroughputOutputInterval;
+  bpString mThroughputJsonFileName;
 
   bpSharedPtr<bpFileReaderFactory> mFileReaderFactory;
 
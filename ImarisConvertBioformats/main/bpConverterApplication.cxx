@@ -28,11 +28,15 @@
 #include "../meta/bpFileReaderImpl.h"
 #include "../meta/bpFileReaderFactoryFileIO.h"
 #include "../meta/bpFileReaderScene.h"
+#include "../src/bpMemoryBudget.h"
 
 #include "fileiobase/types/bpfSmartPtr.h"
 
+#include <boost/property_tree/json_parser.hpp>
 #include <hdf5.h>
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 
 
 void bpConverterApplication::LogMessage(const bpString& aMessage) const
@@ -194,6 +198,23 @@ void bpConverterApplication::PrintCmdLineUsage(const bpString& aProgramName) con
   std::cout << "compressed tiff-image image with 128 x 128 pixels. If the option \"-ts\" is not" << std::endl;
   std::cout << "specified, the output image has the same size as the original image." << std::endl;
   std::cout << std::endl;
+  std::cout << "> " << aProgramName << " --server -nt 4" << std::endl;
+  std::cout << std::endl;
+  std::cout << "Keeps running and reads one request per line from stdin, e.g." << std::endl;
+  std::cout << "{\"id\": \"1\", \"args\": [\"-i\", \"retina.lif\", \"-m\"]}" << std::endl;
+  std::cout << "Each request is processed as if its args were given on the command line (with" << std::endl;
+  std::cout << "\"-nt 4\" added) and answered by one line on stdout with the fields \"id\"," << std::endl;
+  std::cout << "\"exitcode\", \"output\" (stdout) and \"error\" (stderr). The java vm and the" << std::endl;
+  std::cout << "file readers are loaded only once. The server stops at the end of stdin." << std::endl;
+  std::cout << std::endl;
+  std::cout << "> " << aProgramName << " -i \"lightsheet.czi\" -o \"lightsheet.ims\" --resume -cp 300" << std::endl;
+  std::cout << std::endl;
+  std::cout << "Keeps the blocks read so far in \"lightsheet.ims.journal.blocks\", made durable" << std::endl;
+  std::cout << "every 300 seconds. If the conversion is interrupted (timeout, killed process)," << std::endl;
+  std::cout << "the same command continues it: the journaled blocks are read from disk instead of" << std::endl;
+  std::cout << "the input file and \"lightsheet.ims\" is written again from the start. The journal" << std::endl;
+  std::cout << "needs the uncompressed size of the image on disk and is deleted when done." << std::endl;
+  std::cout << std::endl;
 }
 
 
@@ -215,7 +236,7 @@ void bpConverterApplication::PrintCmdLineHelp(const std::vector<bpSharedPtr<bpfF
   std::cout << "  -if  |--inputformat              Input File Format                 (default: autodetect)" << std::endl;
   std::cout << "  -ii  |--inputindex               Input File Image Index            (files with multiple images, default: 0)" << std::endl;
   std::cout << "  -ic  |--inputcrop                Crop Input File Image             (default: do not crop - MinX,MaxX,MinY,MaxY,MinZ,MaxZ,MinC,MaxC,MinT,MaxT" << std::endl;
-  std::cout << "                                                                     0 defaults to min or max, resp.)" << std::endl;
+  std::cout << "                                                                     0 defaults to min or max, resp., max is exclusive)" << std::endl;
   std::cout << "  -il  |--inputlayout              Apply layout to file series       (default: no layout - filename" << std::endl;
   std::cout << "  -vs  |--voxelsize                Set Voxel Size                    (default: empty - read from file)" << std::endl;
   std::cout << "  -vx  |--voxelsizex               Set Voxel Size in X dimension     (default: empty - read from file)" << std::endl;
@@ -231,19 +252,35 @@ void bpConverterApplication::PrintCmdLineHelp(const std::vector<bpSharedPtr<bpfF
   std::cout << "  -tz  |--tSliceIndexZ             Thumbnail Image z slice           (default: 0)" << std::endl;
   std::cout << "  -tf  |--tformat                  Thumbnail Image output format     (default: png - tiff|jpeg (75:1 quality) )" << std::endl;
   std::cout << "  -to  |--timeout                  Timeout in seconds                (default: no timeout)" << std::endl;
-  std::cout << "  -ti  |--tointerval               Throughput output interval in ms  (default: 0 - no throughput output)" << std::endl;
+  std::cout << "  -ti  |--tointerval               Throughput output interval in ms  (default: 0 - no throughput output, per stage below the total)" << std::endl;
+  std::cout << "  -tr  |--trace                    Trace of the conversion stages    (default: empty - no trace, Chrome trace event JSON for chrome://tracing or Perfetto)" << std::endl;
+  std::cout << "  -tj  |--tojson                   Throughput JSON lines file        (default: empty - none, appended every -ti and with the totals per file)" << std::endl;
   std::cout << "  -a   |--allfiles                 Show Attached Files               (default: empty - do not generate. -a [filename])" << std::endl;
   std::cout << "  -m   |--metadata                 Show Image Meta Data              (default: empty - do not generate. -m [filename])" << std::endl;
   std::cout << "  -x   |--voxelhash                Show Voxel Hash Code              (default: empty - do not generate. -x [filename])" << std::endl;
   std::cout << "  -d   |--descriptors              Show Image Descriptors            (default: empty - do not generate. -d [filename])" << std::endl;
   std::cout << "  -xs  |--vblocksort               Block reading sequence            (n|t - default is t, n=no, t=time)" << std::endl; // could enhance it to any combination of x|y|z|c|t
+  std::cout << "  -xv  |--vhashversion             Voxel hash algorithm              (default: 1 - 2=64 bit, blocks hashed in parallel with -nt and -nr)" << std::endl;
+  std::cout << "  -ml  |--metadatalevel            Meta data read from the input     (default: all that the outputs need - minimum|no_overlays|all)" << std::endl;
+  std::cout << "  -rc  |--resultcache              Cache of -m -x -d results         (default: empty - no cache, directory reused until the input files change)" << std::endl;
+  std::cout << "  -rm  |--readermemo               Cache of opened reader states     (default: empty - no cache, Bio-Formats memo files reused until the input file changes)" << std::endl;
+  std::cout << "  -rmt |--readermemotime           Open time to keep reader state    (default: 100 ms - only slower opens are cached)" << std::endl;
   std::cout << "  -l   |--log                      Log into file                     (default: to stdout - filename|\"none\")" << std::endl;
   std::cout << "  -lp  |--logprogress              Log R/W progress to stdout        (default: do not log progress)" << std::endl;
   std::cout << "  -nt  |--nthreads                 Set number of compression threads (default: 8)" << std::endl;
+  std::cout << "  -ra  |--readahead                Blocks read ahead of the writer   (default: 2 - 0 reads synchronously)" << std::endl;
+  std::cout << "  -mem |--memorylimit              Memory limit in MB                (default: none - 40% JVM heap, 30% read ahead, rest writer)" << std::endl;
+  std::cout << "  -nr  |--nreaders                 Set number of parallel readers    (default: 1 - each reader opens the input file)" << std::endl;
+  std::cout << "  -j   |--jobs                     Files of -mi processed at once    (default: 1 - jobs share the threads of -nt, stdout output only)" << std::endl;
+  std::cout << "  -cp  |--checkpoint               Seconds between journal updates   (default: 0 - no journal, else kept next to -o until the output is complete)" << std::endl;
+  std::cout << "  -rs  |--resume                   Resume an interrupted conversion  (default: no - read blocks of the journal, 60 s checkpoints without -cp)" << std::endl;
+  std::cout << "  -sv  |--server                   Run requests read from stdin      (default: no - one JSON request per line, other options apply to all)" << std::endl;
   std::cout << "  -f   |--formats                  Get supported file formats        -" << std::endl;
   std::cout << "  -c   |--compression              Compression level                 (default: 2)" << std::endl;
   std::cout << "  -ch  |--colorhint                Color hint                        (default: ColorLUTHint - ColorLUTHint|ColorEmissionHint|ColorDefaultHint)" << std::endl;
   std::cout << "  -frp |--filereaderplugins        File Reader Plugins Path          (default: empty - no plugins)" << std::endl;
+  std::cout << "  -jo  |--jvmoption                Option of the Java VM             (default: none - repeatable, also from IMARISCONVERT_JVM_OPTIONS)" << std::endl;
+  std::cout << "  -jc  |--jvmclassarchive          Java class data sharing archive   (default: empty - no archive, written by the first run if missing)" << std::endl;
   std::cout << "  -dcl |--defaultcolorlist         Default color list                (4 #RRGGBB colors that apply to first, second, third and other channels)" << std::endl;
   std::cout << "  -fsdx|--fileseriesdelimitersx    File series delimiters X          (X delimiters to apply to configurable file formats, colon separated)" << std::endl;
   std::cout << "  -fsdy|--fileseriesdelimitersy    File series delimiters Y          (Y delimiters to apply to configurable file formats, colon separated)" << std::endl;
@@ -275,10 +312,200 @@ bpSharedPtr<bpFileReaderFactory> bpConverterApplication::CreateFileReaderFactory
 
 
 
+void bpConverterApplication::SetVirtualMachineOptions(const tFileReaderImplFactories& aFileReaderFactories, const std::vector<bpString>& aArguments) const
+{
+  std::vector<bpString> vOptions;
+  bpString vClassArchive;
+  for (bpSize vArgIndex = 1; vArgIndex + 1 < aArguments.size(); ++vArgIndex) {
+    const bpString& vArgName = aArguments[vArgIndex];
+    if (IsMemoryLimitArgument(vArgName)) {
+      // the heap share of the memory limit comes first, an explicit -Xmx of -jo still overrides it
+      bpUInt64 vMemoryLimit = static_cast<bpUInt64>(bpFromString<bpSize>(aArguments[++vArgIndex])) * 1024 * 1024;
+      bpUInt64 vHeapMB = std::max<bpUInt64>(bpMemoryBudget::GetJavaHeapShare(vMemoryLimit) / (1024 * 1024), 1);
+      vOptions.insert(vOptions.begin(), "-Xmx" + bpToString(vHeapMB) + "m");
+    }
+    else if (vArgName == "-jo" || vArgName == "-jvmoption" || vArgName == "--jvmoption") {
+      vOptions.push_back(aArguments[++vArgIndex]);
+    }
+    else if (vArgName == "-jc" || vArgName == "-jvmclassarchive" || vArgName == "--jvmclassarchive") {
+      vClassArchive = bpFileTools::ConvertSeparators(bpFileTools::GetAbsoluteFilePath(aArguments[++vArgIndex]));
+    }
+  }
+
+  for (const auto& vFileReaderImplFactory : aFileReaderFactories) {
+    if (!vOptions.empty()) {
+      vFileReaderImplFactory->AddVirtualMachineOptions(vOptions);
+    }
+    if (!vClassArchive.empty()) {
+      vFileReaderImplFactory->SetVirtualMachineClassArchive(vClassArchive);
+    }
+  }
+}
+
+
+void bpConverterApplication::StartTrace(const tFileReaderImplFactories& aFileReaderFactories, const std::vector<bpString>& aArguments)
+{
+  for (bpSize vArgIndex = 1; vArgIndex + 1 < aArguments.size(); ++vArgIndex) {
+    const bpString& vArgName = aArguments[vArgIndex];
+    if (vArgName == "-tr" || vArgName == "-trace" || vArgName == "--trace") {
+      bpString vTraceFileName = bpFileTools::ConvertSeparators(bpFileTools::GetAbsoluteFilePath(aArguments[vArgIndex + 1]));
+      mTrace = std::make_shared<bpTraceFile>(vTraceFileName);
+    }
+  }
+
+  if (mTrace) {
+    bpTraceFile::SetRecorder(mTrace);
+    for (const auto& vFileReaderImplFactory : aFileReaderFactories) {
+      vFileReaderImplFactory->SetTraceRecorder(mTrace);
+    }
+  }
+}
+
+
+void bpConverterApplication::StopTrace(const tFileReaderImplFactories& aFileReaderFactories)
+{
+  if (!mTrace) {
+    return;
+  }
+
+  bpTraceFile::SetRecorder(nullptr);
+  for (const auto& vFileReaderImplFactory : aFileReaderFactories) {
+    vFileReaderImplFactory->SetTraceRecorder(nullptr);
+  }
+
+  try {
+    mTrace->Write();
+  }
+  catch (const std::exception& vException) {
+    bpLogger::LogError(vException.what());
+  }
+  mTrace.reset();
+}
+
+
 int bpConverterApplication::Execute(const std::vector<bpSharedPtr<bpfFileReaderImplFactoryBase>>& aFileReaderFactories, const std::vector<bpString>& aArguments)
 {
+  // the virtual machine of the readers starts with the first format query, before the arguments are parsed
+  try {
+    SetVirtualMachineOptions(aFileReaderFactories, aArguments);
+  }
+  catch (const std::exception& vException) {
+    bpLogger::LogError(vException.what());
+    return IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS;
+  }
+
+  // the trace covers the whole process, from the start of the virtual machine to the last request
+  StartTrace(aFileReaderFactories, aArguments);
+
   auto vFileReaderFactory = CreateFileReaderFactory(aFileReaderFactories);
-  bpConverter vConverter{ vFileReaderFactory };
+
+  int vExitCode = IMARIS_CONVERT_EXIT_SUCCESS;
+  auto vIsServerArgument = [this](const bpString& aArgument) { return IsServerArgument(aArgument); };
+  if (aArguments.size() > 1 && std::any_of(aArguments.begin() + 1, aArguments.end(), vIsServerArgument)) {
+    vExitCode = ExecuteServer(aFileReaderFactories, vFileReaderFactory, aArguments);
+  }
+  else {
+    try {
+      vExitCode = ExecuteArguments(aFileReaderFactories, vFileReaderFactory, aArguments);
+    }
+    catch (const bpConverterExit& vExit) {
+      vExitCode = vExit.GetExitCode();
+    }
+  }
+
+  StopTrace(aFileReaderFactories);
+  return vExitCode;
+}
+
+
+int bpConverterApplication::ExecuteServer(const tFileReaderImplFactories& aFileReaderFactories, const bpSharedPtr<bpFileReaderFactory>& aFileReaderFactory, const std::vector<bpString>& aArguments)
+{
+  mServerMode = true;
+
+  // the remaining arguments of the server apply to every request
+  std::vector<bpString> vArguments;
+  for (const auto& vArgument : aArguments) {
+    if (!IsServerArgument(vArgument)) {
+      vArguments.push_back(vArgument);
+    }
+  }
+
+  // color settings are static, no request may change them for the following ones
+  bpColorHint vColorHint = bpFileReaderImpl::GetColorHint();
+  bpFileConversionColors::tDefaultColors vDefaultColors = bpFileReaderImpl::GetDefaultColors();
+
+  bpString vRequest;
+  while (std::getline(std::cin, vRequest)) {
+    if (vRequest.find_first_not_of(" \t\r") == bpString::npos) {
+      continue;
+    }
+
+    bpFileReaderImpl::SetColorHint(vColorHint);
+    bpFileReaderImpl::SetDefaultColors(vDefaultColors);
+
+    bpString vReply = ExecuteServerRequest(aFileReaderFactories, aFileReaderFactory, vArguments, vRequest);
+    std::cout << vReply << std::endl << std::flush;
+  }
+
+  return IMARIS_CONVERT_EXIT_SUCCESS;
+}
+
+
+bpString bpConverterApplication::ExecuteServerRequest(const tFileReaderImplFactories& aFileReaderFactories, const bpSharedPtr<bpFileReaderFactory>& aFileReaderFactory, const std::vector<bpString>& aArguments, const bpString& aRequest)
+{
+  bpString vId;
+  int vExitCode = IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS;
+
+  // whatever a single run would print goes into the reply
+  std::ostringstream vOutput;
+  std::ostringstream vError;
+  std::streambuf* vCOutBuffer = std::cout.rdbuf(vOutput.rdbuf());
+  std::streambuf* vCErrBuffer = std::cerr.rdbuf(vError.rdbuf());
+
+  try {
+    boost::property_tree::ptree vTree;
+    std::istringstream vStream(aRequest);
+    boost::property_tree::read_json(vStream, vTree);
+
+    vId = vTree.get<bpString>("id", "");
+    std::vector<bpString> vArguments = aArguments;
+    auto vArgs = vTree.get_child_optional("args");
+    if (vArgs) {
+      for (const auto& vArg : *vArgs) {
+        vArguments.push_back(vArg.second.data());
+      }
+    }
+
+    vExitCode = ExecuteArguments(aFileReaderFactories, aFileReaderFactory, vArguments);
+  }
+  catch (const bpConverterExit& vExit) {
+    vExitCode = vExit.GetExitCode();
+  }
+  catch (const boost::property_tree::ptree_error& vException) {
+    std::cerr << "Invalid request: " << vException.what() << std::endl;
+  }
+  catch (const std::exception& vException) {
+    std::cerr << "Abnormal termination of request: " << vException.what() << std::endl;
+    vExitCode = IMARIS_CONVERT_EXIT_ABNORMAL_TERMINATION;
+  }
+  catch (...) {
+    std::cerr << "Abnormal termination of request" << std::endl;
+    vExitCode = IMARIS_CONVERT_EXIT_ABNORMAL_TERMINATION;
+  }
+
+  std::cout.rdbuf(vCOutBuffer);
+  std::cerr.rdbuf(vCErrBuffer);
+
+  return "{\"id\":" + bpToJsonString(vId) +
+    ",\"exitcode\":" + std::to_string(vExitCode) +
+    ",\"output\":" + bpToJsonString(vOutput.str()) +
+    ",\"error\":" + bpToJsonString(vError.str()) + "}";
+}
+
+
+int bpConverterApplication::ExecuteArguments(const tFileReaderImplFactories& aFileReaderFactories, const bpSharedPtr<bpFileReaderFactory>& aFileReaderFactory, const std::vector<bpString>& aArguments)
+{
+  bpConverter vConverter{ aFileReaderFactory };
 
   //
   // parse the command line arguments
@@ -295,11 +522,11 @@ int bpConverterApplication::Execute(const std::vector<bpSharedPtr<bpfFileReaderI
 
     if (vArgName == "-h" || vArgName == "-help" || vArgName == "--help") {
       PrintCmdLineHelp(aFileReaderFactories, aArguments[0]);
-      exit(IMARIS_CONVERT_EXIT_SUCCESS);
+      throw bpConverterExit(IMARIS_CONVERT_EXIT_SUCCESS);
     }
     else if (vArgName == "-v" || vArgName == "-version" || vArgName == "--version") {
       PrintCmdLineVersion(aFileReaderFactories);
-      exit(IMARIS_CONVERT_EXIT_SUCCESS);
+      throw bpConverterExit(IMARIS_CONVERT_EXIT_SUCCESS);
     }
     else if (vArgName == "-f" || vArgName == "-formats" || vArgName == "--formats") {
       vConverter.SetPrintSupportedFormats(true);
@@ -347,6 +574,12 @@ int bpConverterApplication::Execute(const std::vector<bpSharedPtr<bpfFileReaderI
         continue;
       }
     }
+    else if (vArgName == "-rs" || vArgName == "-resume" || vArgName == "--resume") {
+      if (IsAtomicArgument(vArgIndex, aArguments)) {
+        vConverter.SetResume(true);
+        continue;
+      }
+    }
 
     //
     // the following options require an argument
@@ -355,7 +588,7 @@ int bpConverterApplication::Execute(const std::vector<bpSharedPtr<bpfFileReaderI
     ++vArgIndex;
     if (vArgIndex == aArguments.size()) {
       std::cerr << "Option " << vArgName << " requires an argument. Use --help for details" << std::endl;
-      exit(IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS);
+      throw bpConverterExit(IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS);
     }
 
     bpString vArgValue(aArguments[vArgIndex]);
@@ -425,7 +658,10 @@ int bpConverterApplication::Execute(const std::vector<bpSharedPtr<bpfFileReaderI
     }
     else if (vArgName == "-to" || vArgName == "-timeout" || vArgName == "--timeout") {
       bpFloat vTimeout = bpFromString<bpFloat>(vArgValue);
-      if (vTimeout > 0.0f) {
+      if (mServerMode) {
+        bpLogger::LogWarning("Option " + vArgName + " is ignored by the server, the client has to enforce the timeout");
+      }
+      else if (vTimeout > 0.0f) {
         mTimeout.Start(vTimeout, IMARIS_CONVERT_EXIT_TIMEOUT);
       }
     }
@@ -433,6 +669,9 @@ int bpConverterApplication::Execute(const std::vector<bpSharedPtr<bpfFileReaderI
       bpUInt32 vOutputInterval = bpFromString<bpUInt32>(vArgValue);
       vConverter.SetThroughputOutputInterval(vOutputInterval);
     }
+    else if (vArgName == "-tj" || vArgName == "-tojson" || vArgName == "--tojson") {
+      vConverter.SetThroughputJsonFileName(vArgValue, vArgName);
+    }
     else if (vArgName == "-ps" || vArgName == "-datacachesize" || vArgName == "--datacachesize") {
       // old argument: ignore
     }
@@ -451,15 +690,45 @@ int bpConverterApplication::Execute(const std::vector<bpSharedPtr<bpfFileReaderI
     else if (vArgName == "-d" || vArgName == "-descriptors" || vArgName == "--descriptors") {
       vConverter.SetImageDescriptorsFileName(vArgValue, vArgName);
     }
+    else if (vArgName == "-rc" || vArgName == "-resultcache" || vArgName == "--resultcache") {
+      vConverter.SetResultCacheDirectory(vArgValue, vArgName);
+    }
+    else if (vArgName == "-rm" || vArgName == "-readermemo" || vArgName == "--readermemo") {
+      vConverter.SetReaderMemoDirectory(vArgValue, vArgName);
+    }
+    else if (vArgName == "-rmt" || vArgName == "-readermemotime" || vArgName == "--readermemotime") {
+      vConverter.SetReaderMemoMinimumElapsed(bpFromString<bpSize>(vArgValue));
+    }
     else if (vArgName == "-l" || vArgName == "-log" || vArgName == "--log") {
       vConverter.SetLogFile(vArgValue, vArgName);
     }
     else if (vArgName == "-xs" || vArgName == "-vblocksort" || vArgName == "--vblocksort") {
       vConverter.SetVoxelHashBlockSort(vArgValue, vArgName);
     }
+    else if (vArgName == "-xv" || vArgName == "-vhashversion" || vArgName == "--vhashversion") {
+      vConverter.SetVoxelHashVersion(bpFromString<bpSize>(vArgValue));
+    }
+    else if (vArgName == "-ml" || vArgName == "-metadatalevel" || vArgName == "--metadatalevel") {
+      vConverter.SetMetadataLevel(vArgValue);
+    }
     else if (vArgName == "-nt" || vArgName == "-nthreads" || vArgName == "--nthreads") {
       vConverter.SetNumberOfThreads(bpFromString<bpSize>(vArgValue));
     }
+    else if (vArgName == "-ra" || vArgName == "-readahead" || vArgName == "--readahead") {
+      vConverter.SetReadAheadBlocks(bpFromString<bpSize>(vArgValue));
+    }
+    else if (IsMemoryLimitArgument(vArgName)) {
+      vConverter.SetMemoryLimit(bpFromString<bpSize>(vArgValue));
+    }
+    else if (vArgName == "-nr" || vArgName == "-nreaders" || vArgName == "--nreaders") {
+      vConverter.SetNumberOfReaders(bpFromString<bpSize>(vArgValue));
+    }
+    else if (vArgName == "-j" || vArgName == "-jobs" || vArgName == "--jobs") {
+      vConverter.SetNumberOfJobs(bpFromString<bpSize>(vArgValue));
+    }
+    else if (vArgName == "-cp" || vArgName == "-checkpoint" || vArgName == "--checkpoint") {
+      vConverter.SetCheckpointInterval(bpFromString<bpFloat>(vArgValue));
+    }
     else if (vArgName == "-c" || vArgName == "-compression" || vArgName == "--compression") {
       vConverter.SetCompressionAlgorithmType(static_cast<bpConverterTypes::tCompressionAlgorithmType>(bpFromString<bpSize>(vArgValue)));
     }
@@ -467,7 +736,20 @@ int bpConverterApplication::Execute(const std::vector<bpSharedPtr<bpfFileReaderI
       SetColorHint(vArgValue);
     }
     else if (vArgName == "-frp" || vArgName == "-filereaderplugins" || vArgName == "--filereaderplugins") {
-      vFileReaderFactory->SetPluginsPath(vArgValue);
+      aFileReaderFactory->SetPluginsPath(vArgValue);
+    }
+    else if (vArgName == "-tr" || vArgName == "-trace" || vArgName == "--trace") {
+      // started by Execute, before the virtual machine
+      if (mServerMode) {
+        bpLogger::LogWarning("Option " + vArgName + " is ignored in requests, it has to be passed to the server");
+      }
+    }
+    else if (vArgName == "-jo" || vArgName == "-jvmoption" || vArgName == "--jvmoption" ||
+             vArgName == "-jc" || vArgName == "-jvmclassarchive" || vArgName == "--jvmclassarchive") {
+      // applied by Execute before the virtual machine started
+      if (mServerMode) {
+        bpLogger::LogWarning("Option " + vArgName + " is ignored in requests, it has to be passed to the server");
+      }
     }
     else if (vArgName == "-dcl" || vArgName == "-defaultcolorlist" || vArgName == "--defaultcolorlist") {
       if (vArgIndex + 3 < aArguments.size()) {
@@ -499,7 +781,7 @@ int bpConverterApplication::Execute(const std::vector<bpSharedPtr<bpfFileReaderI
     }
     else {
       std::cerr << "Option " << vArgName << " not understood. Use --help for details" << std::endl;
-      exit(IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS);
+      throw bpConverterExit(IMARIS_CONVERT_EXIT_INVALID_ARGUMENTS);
     }
   }
 
@@ -526,6 +808,18 @@ int bpConverterApplication::Execute(const std::vector<bpSharedPtr<bpfFileReaderI
 }
 
 
+bool bpConverterApplication::IsServerArgument(const bpString& aArgument) const
+{
+  return aArgument == "-sv" || aArgument == "-server" || aArgument == "--server";
+}
+
+
+bool bpConverterApplication::IsMemoryLimitArgument(const bpString& aArgument) const
+{
+  return aArgument == "-mem" || aArgument == "-memorylimit" || aArgument == "--memorylimit" || aArgument == "--memory-limit";
+}
+
+
 bool bpConverterApplication::IsAtomicArgument(bpSize aArgIndex, const std::vector<bpString>& aArguments)
 {
   return aArgIndex == aArguments.size() - 1 || (aArgIndex < aArguments.size() - 1 && bpStartsWith(aArguments[aArgIndex + 1], "-"));
@@ -22,6 +22,7 @@
 
 
 #include "../src/bpTimeout.h"
+#include "../src/bpTraceFile.h"
 #include "fileiobase/application/bpfFileReaderImplFactoryBase.h"
 
 class bpFileReaderFactory;
@@ -33,6 +34,14 @@ public:
   int Execute(const std::vector<bpSharedPtr<bpfFileReaderImplFactoryBase>>& aFileReaderFactories, const std::vector<bpString>& aArguments);
 
 private:
+  using tFileReaderImplFactories = std::vector<bpSharedPtr<bpfFileReaderImplFactoryBase>>;
+
+  int ExecuteArguments(const tFileReaderImplFactories& aFileReaderFactories, const bpSharedPtr<bpFileReaderFactory>& aFileReaderFactory, const std::vector<bpString>& aArguments);
+  int ExecuteServer(const tFileReaderImplFactories& aFileReaderFactories, const bpSharedPtr<bpFileReaderFactory>& aFileReaderFactory, const std::vector<bpString>& aArguments);
+  bpString ExecuteServerRequest(const tFileReaderImplFactories& aFileReaderFactories, const bpSharedPtr<bpFileReaderFactory>& aFileReaderFactory, const std::vector<bpString>& aArguments, const bpString& aRequest);
+  bool IsServerArgument(const bpString& aArgument) const;
+  bool IsMemoryLimitArgument(const bpString& aArgument) const;
+
   void PrintInputFormats(const std::vector<bpSharedPtr<bpfFileReaderImplFactoryBase>>& aFileReaderFactories) const;
   void PrintOutputFormats() const;
   void PrintCmdLineHelp(const std::vector<bpSharedPtr<bpfFileReaderImplFactoryBase>>& aFileReaderFactories, const bpString& aProgramName) const;
@@ -47,9 +56,14 @@ private:
   bool IsAtomicArgument(bpSize aArgIndex, const std::vector<bpString>& aArguments);
 
   bpString GetVersionFullStringRevision(const std::vector<bpSharedPtr<bpfFileReaderImplFactoryBase>>& aFileReaderFactories) const;
+  void StartTrace(const tFileReaderImplFactories& aFileReaderFactories, const std::vector<bpString>& aArguments);
+  void StopTrace(const tFileReaderImplFactories& aFileReaderFactories);
+  void SetVirtualMachineOptions(const tFileReaderImplFactories& aFileReaderFactories, const std::vector<bpString>& aArguments) const;
   bpSharedPtr<bpFileReaderFactory> CreateFileReaderFactory(const std::vector<bpSharedPtr<bpfFileReaderImplFactoryBase>>& aFileReaderFactories) const;
 
   bpTimeout mTimeout;
+  bool mServerMode = false;
+  bpSharedPtr<bpTraceFile> mTrace;
 };
 
 
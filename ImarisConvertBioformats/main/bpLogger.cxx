@@ -82,6 +82,8 @@ void bpLogger::LogImpl(bpLogger::tLogLevel aLogLevel, const bpString& aMessage)
     return;
   }
 
+  std::lock_guard<std::mutex> vLock(mMutex);
+
   std::ostringstream vLogString;
   vLogString << GetCurrentFilesystemTime() << "\t" << GetProcessId() << "\t" << GetThreadId() << "\t"<< LogLevelToString(aLogLevel) << "\t" << aMessage << std::endl;
 
@@ -24,6 +24,7 @@
 
 #include <set>
 #include <map>
+#include <mutex>
 
 
 class bpLoggerSink;
@@ -132,6 +133,9 @@ private:
   tSinkFlags mSinkFlags;
   std::map<bpString, bpLoggerSink*> mSinks;
 
+  // messages may be logged from several threads (parallel jobs, readers)
+  std::mutex mMutex;
+
   // message recording
   typedef std::vector<bpString> tLogMessages;
   std::set<tLogLevel> mRecordedLogLevels;
@@ -25,6 +25,9 @@
 #include <iostream>
 
 
+static thread_local bpString* gCapturedStdCOut = nullptr;
+
+
 bpOutput::bpOutput()
 : mOutputFileName(""),
   mSinkFlags(eSinkStdCOut)
@@ -70,6 +73,10 @@ void bpOutput::SetOutputFileName(const bpString& aOutputFileName)
 
 void bpOutput::WriteToStdCout(const bpString aContent)
 {
+  if (gCapturedStdCOut) {
+    *gCapturedStdCOut += aContent;
+    return;
+  }
   std::cout << aContent << std::flush;
 }
 
@@ -99,3 +106,16 @@ void bpOutput::OpenFile()
 
   }
 }
+
+
+bpOutput::cCaptureStdCOut::cCaptureStdCOut(bpString& aBuffer)
+  : mPreviousBuffer(gCapturedStdCOut)
+{
+  gCapturedStdCOut = &aBuffer;
+}
+
+
+bpOutput::cCaptureStdCOut::~cCaptureStdCOut()
+{
+  gCapturedStdCOut = mPreviousBuffer;
+}
@@ -72,6 +72,21 @@ public:
    */
   void SetOutputFileName(const bpString& aLogFileName);
 
+  /**
+   * While an object of this class exists, everything the calling thread writes
+   * to std::cout through bpOutput is appended to aBuffer instead. Used to print
+   * the output of parallel jobs in the order of the input files.
+   */
+  class cCaptureStdCOut
+  {
+  public:
+    explicit cCaptureStdCOut(bpString& aBuffer);
+    ~cCaptureStdCOut();
+
+  private:
+    bpString* mPreviousBuffer;
+  };
+
 
 private:
   void WriteToStdCout(const bpString aLogMessage);
@@ -0,0 +1,231 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#include "bpResultCache.h"
+#include "bpLogger.h"
+
+#include "../meta/bpFileTools.h"
+#include "../meta/bpHash.h"
+#include "../meta/bpUtils.h"
+
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <random>
+#include <sstream>
+
+#if !defined(_WIN32)
+#include <sys/stat.h>
+#endif
+
+
+// first line of every entry, change it when the layout changes
+static const bpString gEntryHeader = "bpResultCache 1";
+
+
+static bpString ToSingleLine(bpString aText)
+{
+  std::replace(aText.begin(), aText.end(), '\n', ' ');
+  std::replace(aText.begin(), aText.end(), '\r', ' ');
+  return aText;
+}
+
+
+bpResultCache::bpResultCache(const bpString& aDirectory)
+  : mDirectory(aDirectory)
+{
+}
+
+
+bool bpResultCache::Read(const bpString& aKey, bpString& aOutput, std::set<bpString>& aProcessedFileNames) const
+{
+  bpString vEntryFileName = GetEntryFileName(aKey);
+#ifdef BP_UTF8_FILENAMES
+  std::ifstream vEntry(bpFileTools::FromUtf8Path(vEntryFileName).c_str(), std::ios::binary);
+#else
+  std::ifstream vEntry(vEntryFileName.c_str(), std::ios::binary);
+#endif
+  if (!vEntry.is_open()) {
+    return false;
+  }
+
+  bpString vLine;
+  if (!std::getline(vEntry, vLine) || vLine != gEntryHeader) {
+    return false;
+  }
+
+  // the file name is a hash of the key, make sure it is the same key
+  if (!std::getline(vEntry, vLine) || vLine != ToSingleLine(aKey)) {
+    return false;
+  }
+
+  // each used file as "identity<tab>name"
+  if (!std::getline(vEntry, vLine)) {
+    return false;
+  }
+  bpSize vNumberOfFiles = bpFromString<bpSize>(vLine);
+  for (bpSize vIndex = 0; vIndex < vNumberOfFiles; ++vIndex) {
+    if (!std::getline(vEntry, vLine)) {
+      return false;
+    }
+    bpSize vTab = vLine.find('\t');
+    if (vTab == bpString::npos || GetFileIdentity(vLine.substr(vTab + 1)) != vLine.substr(0, vTab)) {
+      bpLogger::LogDebug("Result cache entry " + vEntryFileName + " is out of date");
+      return false;
+    }
+  }
+
+  if (!std::getline(vEntry, vLine)) {
+    return false;
+  }
+  std::set<bpString> vProcessedFileNames;
+  bpSize vNumberOfProcessedFileNames = bpFromString<bpSize>(vLine);
+  for (bpSize vIndex = 0; vIndex < vNumberOfProcessedFileNames; ++vIndex) {
+    if (!std::getline(vEntry, vLine)) {
+      return false;
+    }
+    vProcessedFileNames.insert(vLine);
+  }
+
+  // the output follows unchanged
+  aOutput.assign(std::istreambuf_iterator<char>(vEntry), std::istreambuf_iterator<char>());
+  aProcessedFileNames.insert(vProcessedFileNames.begin(), vProcessedFileNames.end());
+  bpLogger::LogInfo("Using result cache entry " + vEntryFileName);
+  return true;
+}
+
+
+void bpResultCache::Write(const bpString& aKey, const tFileIdentities& aFileIdentities, const std::set<bpString>& aProcessedFileNames, const bpString& aOutput) const
+{
+  std::ostringstream vEntry;
+  vEntry << gEntryHeader << "\n";
+  vEntry << ToSingleLine(aKey) << "\n";
+  vEntry << aFileIdentities.size() << "\n";
+  for (const auto& vFileIdentity : aFileIdentities) {
+    const bpString& vFileName = vFileIdentity.first;
+    const bpString& vIdentity = vFileIdentity.second;
+    if (vIdentity.empty() || vFileName.find_first_of("\n\r") != bpString::npos) {
+      bpLogger::LogDebug("Not caching the result, can not identify " + vFileName);
+      return;
+    }
+    // the output might be read from an older or partial version of the file
+    if (GetFileIdentity(vFileName) != vIdentity) {
+      bpLogger::LogDebug("Not caching the result, " + vFileName + " changed while it was read");
+      return;
+    }
+    vEntry << vIdentity << "\t" << vFileName << "\n";
+  }
+  vEntry << aProcessedFileNames.size() << "\n";
+  for (const auto& vFileName : aProcessedFileNames) {
+    vEntry << ToSingleLine(vFileName) << "\n";
+  }
+  vEntry << aOutput;
+
+  if (!bpFileTools::IsDir(mDirectory) && !bpFileTools::MakePath(mDirectory) && !bpFileTools::IsDir(mDirectory)) {
+    bpLogger::LogWarning("Unable to create result cache directory " + mDirectory);
+    return;
+  }
+
+  // write to a unique file first, readers (other processes or jobs) never see a partial entry
+  bpString vEntryFileName = GetEntryFileName(aKey);
+  bpString vTempFileName = vEntryFileName + "." + bpToString(std::random_device()()) + ".tmp";
+  {
+#ifdef BP_UTF8_FILENAMES
+    std::ofstream vFile(bpFileTools::FromUtf8Path(vTempFileName).c_str(), std::ofstream::trunc | std::ios::binary);
+#else
+    std::ofstream vFile(vTempFileName.c_str(), std::ofstream::trunc | std::ios::binary);
+#endif
+    vFile << vEntry.str();
+    if (!vFile.good()) {
+      vFile.close();
+      bpFileTools::FileRemove(vTempFileName);
+      bpLogger::LogWarning("Unable to write result cache entry " + vTempFileName);
+      return;
+    }
+  }
+  if (!bpFileTools::FileRename(vTempFileName, vEntryFileName)) {
+    bpFileTools::FileRemove(vTempFileName);
+    bpLogger::LogWarning("Unable to write result cache entry " + vEntryFileName);
+  }
+}
+
+
+bpString bpResultCache::GetEntryFileName(const bpString& aKey) const
+{
+  std::ostringstream vName;
+  vName << std::hex << std::setw(16) << std::setfill('0') << bpHash64::GetCode(aKey.data(), aKey.size());
+  return mDirectory + "/" + vName.str() + ".cache";
+}
+
+
+bool bpResultCache::AddFileIdentities(const std::vector<bpString>& aFileNames, std::time_t aReadTime, tFileIdentities& aFileIdentities)
+{
+  for (const auto& vFileName : aFileNames) {
+    boost::system::error_code vError;
+#ifdef BP_UTF8_FILENAMES
+    std::time_t vModificationTime = boost::filesystem::last_write_time(bpFileTools::FromUtf8Path(vFileName), vError);
+#else
+    std::time_t vModificationTime = boost::filesystem::last_write_time(vFileName, vError);
+#endif
+    if (vError || vModificationTime >= aReadTime) {
+      bpLogger::LogDebug("Not caching the result, " + vFileName + " changed while it was read");
+      return false;
+    }
+    aFileIdentities[vFileName] = GetFileIdentity(vFileName);
+  }
+  return true;
+}
+
+
+bpString bpResultCache::GetFileIdentity(const bpString& aFileName)
+{
+  std::ostringstream vIdentity;
+#if defined(_WIN32)
+  namespace fs = boost::filesystem;
+  boost::system::error_code vError;
+#ifdef BP_UTF8_FILENAMES
+  fs::path vPath(bpFileTools::FromUtf8Path(aFileName));
+#else
+  fs::path vPath(aFileName);
+#endif
+  auto vSize = fs::file_size(vPath, vError);
+  if (vError) {
+    return "";
+  }
+  auto vTime = fs::last_write_time(vPath, vError);
+  if (vError) {
+    return "";
+  }
+  vIdentity << vSize << " " << vTime;
+#else
+  struct stat vStat;
+  if (stat(aFileName.c_str(), &vStat) != 0) {
+    return "";
+  }
+#if defined(__APPLE__)
+  const auto& vTime = vStat.st_mtimespec;
+#else
+  const auto& vTime = vStat.st_mtim;
+#endif
+  vIdentity << vStat.st_size << " " << vTime.tv_sec << "." << vTime.tv_nsec << " " << vStat.st_dev << ":" << vStat.st_ino;
+#endif
+  return vIdentity.str();
+}
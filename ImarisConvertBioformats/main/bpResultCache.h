@@ -0,0 +1,76 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#ifndef __BP_RESULT_CACHE__
+#define __BP_RESULT_CACHE__
+
+#include "ImarisWriter/interface/bpConverterTypes.h"
+
+#include <ctime>
+#include <map>
+#include <set>
+
+
+/**
+ * On-disk cache of outputs that only depend on the input files (meta data,
+ * voxel hash, image descriptors). An entry is found by a key describing the
+ * request and is valid as long as every file it was read from keeps its
+ * size, modification time and inode.
+ */
+class bpResultCache
+{
+public:
+  // identity of each file by its name
+  using tFileIdentities = std::map<bpString, bpString>;
+
+  explicit bpResultCache(const bpString& aDirectory);
+
+  /**
+   * Returns true and the stored output if the entry of aKey exists and none of
+   * its files changed. aProcessedFileNames receives the names stored with it.
+   */
+  bool Read(const bpString& aKey, bpString& aOutput, std::set<bpString>& aProcessedFileNames) const;
+
+  /**
+   * Stores aOutput for aKey, to be valid as long as the files of aFileIdentities
+   * do not change. The identities must be taken before the files are read,
+   * nothing is stored if a file changed since.
+   * Failures are logged and otherwise ignored, the cache is optional.
+   */
+  void Write(const bpString& aKey, const tFileIdentities& aFileIdentities, const std::set<bpString>& aProcessedFileNames, const bpString& aOutput) const;
+
+  /**
+   * Size, modification time and inode of aFileName, empty if it can not be read.
+   */
+  static bpString GetFileIdentity(const bpString& aFileName);
+
+  /**
+   * Adds the identities of aFileNames, which were read since aReadTime, to aFileIdentities.
+   * Returns false if a file was modified since aReadTime: its identity might belong to
+   * a newer version than the one that was read.
+   */
+  static bool AddFileIdentities(const std::vector<bpString>& aFileNames, std::time_t aReadTime, tFileIdentities& aFileIdentities);
+
+private:
+  bpString GetEntryFileName(const bpString& aKey) const;
+
+  bpString mDirectory;
+};
+
+#endif // __BP_RESULT_CACHE__
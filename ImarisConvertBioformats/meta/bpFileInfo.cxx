@@ -28,6 +28,11 @@
 
 
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
 
 
 template <typename T>
@@ -540,13 +545,128 @@ bool bpFileInfo::ReadVoxelHash(
 }
 
 
+bool bpFileInfo::ReadBlocksVoxelHash(
+  const std::vector<bpFileReader::tPtr>& aFileReaders,
+  bpSize aNumberOfThreads,
+  bpUInt64& aVoxelHash,
+  bpUInt64& aVoxelBytes,
+  bpString& aExceptionText)
+{
+  try {
+    // every reader serves one block at a time
+    std::vector<bpFileReader::tImplPtr> vFreeReaderImpls;
+    for (const auto& vFileReader : aFileReaders) {
+      if (vFileReader->GetReaderImpl()) {
+        vFreeReaderImpls.push_back(vFileReader->GetReaderImpl());
+      }
+    }
+    if (vFreeReaderImpls.empty()) {
+      return false;
+    }
+
+    auto vReaderImpl = vFreeReaderImpls.front();
+    bpSize vNumberOfDataBlocks = vReaderImpl->GetNumberOfDataBlocks();
+    bpSize vTypeSize = bpGetSizeOfType(vReaderImpl->GetDataType());
+    bpSize vBlockBytes = vReaderImpl->GetDataBlockNumberOfVoxels() * vTypeSize;
+
+    bpVoxelHashBlocks vVoxelHash(vReaderImpl->GetDataSizeV(), vReaderImpl->GetDataBlockSizeV(), vTypeSize);
+    std::atomic<bpSize> vNextBlockNumber(0);
+    std::atomic<bool> vFailed(false);
+    std::mutex vMutex;
+    std::condition_variable vReaderFreed;
+    bpString vExceptionText;
+
+    auto vHashBlocks = [&] {
+      const bpSize vBufferExtraSize = 16;
+      std::vector<bpUInt8> vBuffer(vBlockBytes + vBufferExtraSize, 0xAA);
+      try {
+        for (bpSize vBlockNumber = vNextBlockNumber++; vBlockNumber < vNumberOfDataBlocks && !vFailed; vBlockNumber = vNextBlockNumber++) {
+          bpFileReader::tImplPtr vBlockReaderImpl;
+          {
+            std::unique_lock<std::mutex> vLock(vMutex);
+            vReaderFreed.wait(vLock, [&vFreeReaderImpls] { return !vFreeReaderImpls.empty(); });
+            vBlockReaderImpl = vFreeReaderImpls.back();
+            vFreeReaderImpls.pop_back();
+          }
+          std::exception_ptr vReadException;
+          try {
+            vBlockReaderImpl->GoToDataBlock(vBlockNumber);
+            vBlockReaderImpl->ReadDataBlock(vBuffer.data());
+          }
+          catch (...) {
+            vReadException = std::current_exception();
+          }
+          {
+            std::lock_guard<std::mutex> vLock(vMutex);
+            vFreeReaderImpls.push_back(vBlockReaderImpl);
+          }
+          vReaderFreed.notify_one();
+          if (vReadException) {
+            std::rethrow_exception(vReadException);
+          }
+
+          // check, if extra buffer is still intact
+          for (bpSize vIndex = vBlockBytes; vIndex < vBuffer.size(); vIndex++) {
+            if (vBuffer[vIndex] != 0xAA) {
+              throw std::runtime_error("Nirvana Memory Violation!");
+            }
+          }
+
+          vVoxelHash.AddBlock(vBlockNumber, vBuffer.data());
+        }
+      }
+      catch (std::exception& vException) {
+        std::lock_guard<std::mutex> vLock(vMutex);
+        if (!vFailed.exchange(true)) {
+          vExceptionText = vException.what();
+        }
+      }
+      catch (...) {
+        std::lock_guard<std::mutex> vLock(vMutex);
+        if (!vFailed.exchange(true)) {
+          vExceptionText = "Unknown error while reading block";
+        }
+      }
+    };
+
+    bpSize vNumberOfThreads = std::max<bpSize>(std::min<bpSize>(aNumberOfThreads, vNumberOfDataBlocks), 1);
+    std::vector<std::thread> vThreads;
+    for (bpSize vThread = 1; vThread < vNumberOfThreads; vThread++) {
+      vThreads.emplace_back(vHashBlocks);
+    }
+    vHashBlocks();
+    for (auto& vThread : vThreads) {
+      vThread.join();
+    }
+    if (vFailed) {
+      aExceptionText = vExceptionText;
+      return false;
+    }
+
+    aVoxelHash = vVoxelHash.GetCode();
+    aVoxelBytes = vVoxelHash.GetVoxelBytes();
+    return true;
+  }
+  catch (std::exception& vException) {
+    aExceptionText = vException.what();
+    return false;
+  }
+}
+
+
 bpString bpFileInfo::GetXML_ReadVoxelHash(
   const bpString& aFileName,
   const bpFileReader::tPtr& aFileReader,
   bpSize aImageIndex,
   const bpString& aBlockSort,
+  tVoxelHashVersion aVersion,
+  const std::vector<bpFileReader::tPtr>& aAdditionalFileReaders,
+  bpSize aNumberOfThreads,
   const bpString& aIndent)
 {
+  std::vector<bpFileReader::tPtr> vFileReaders{ aFileReader };
+  vFileReaders.insert(vFileReaders.end(), aAdditionalFileReaders.begin(), aAdditionalFileReaders.end());
+
   // main container for xml
   bpString vXML;
   vXML += aIndent + bpXML::GetStartTag("VoxelHash") + "\n";;
@@ -567,7 +687,9 @@ bpString bpFileInfo::GetXML_ReadVoxelHash(
   bool vHasExceptions = false;
   bpUInt64 vTotalVoxelBytes = 0;
   while (vImageIndex != vImageIndexEnd) {
-    aFileReader->SetActiveDataSetIndex(vImageIndex);
+    for (const auto& vFileReader : vFileReaders) {
+      vFileReader->SetActiveDataSetIndex(vImageIndex);
+    }
     bpString vDummyXML = "";
     bpString vDummyExceptionText = "";
     ReadMetaData(aFileName, aFileReader, "", vDummyXML, vDummyExceptionText);
@@ -575,9 +697,21 @@ bpString bpFileInfo::GetXML_ReadVoxelHash(
     vAttrs.push_back("mIndex");
     vAttrs.push_back(bpToString(vImageIndex));
     bpUInt32 vVoxelHash = 0;
+    bpUInt64 vBlocksVoxelHash = 0;
     bpUInt64 vVoxelBytes = 0;
     bpString vExceptionText = "";
-    if (ReadVoxelHash(aFileName, aFileReader, aBlockSort, vVoxelHash, vVoxelBytes, vExceptionText)) {
+    if (aVersion == eVoxelHashBlocks) {
+      if (ReadBlocksVoxelHash(vFileReaders, aNumberOfThreads, vBlocksVoxelHash, vVoxelBytes, vExceptionText)) {
+        vTotalVoxelBytes += vVoxelBytes;
+        vAttrs.push_back("mVoxelHash");
+        vAttrs.push_back(bpToString(vBlocksVoxelHash));
+        vAttrs.push_back("mVoxelHashVersion");
+        vAttrs.push_back(bpToString(static_cast<bpSize>(aVersion)));
+        vAttrs.push_back("mVoxelBytes");
+        vAttrs.push_back(bpToString(vVoxelBytes));
+      }
+    }
+    else if (ReadVoxelHash(aFileName, aFileReader, aBlockSort, vVoxelHash, vVoxelBytes, vExceptionText)) {
       vTotalVoxelBytes += vVoxelBytes;
       vAttrs.push_back("mVoxelHash");
       vAttrs.push_back(bpToString(vVoxelHash));
@@ -604,3 +738,33 @@ bpString bpFileInfo::GetXML_ReadVoxelHash(
   return vXML;
 }
 
+
+bpString bpFileInfo::GetXML_VoxelHash(
+  const bpFileReader::tPtr& aFileReader,
+  bpSize aImageIndex,
+  const bpVoxelHashBlocks& aVoxelHash,
+  const bpString& aIndent)
+{
+  // same layout as GetXML_ReadVoxelHash for one image, the blocks were hashed while reading them for other outputs
+  bpString vXML;
+  vXML += aIndent + bpXML::GetStartTag("VoxelHash") + "\n";
+  bpString vIndent = aIndent + "  ";
+
+  vXML += vIndent + bpXML::WriteOneLineTag("NumberOfImages", bpToString(aFileReader->GetNumberOfDataSets())) + "\n";
+
+  std::vector<bpString> vAttrs;
+  vAttrs.push_back("mIndex");
+  vAttrs.push_back(bpToString(aImageIndex));
+  vAttrs.push_back("mVoxelHash");
+  vAttrs.push_back(bpToString(aVoxelHash.GetCode()));
+  vAttrs.push_back("mVoxelHashVersion");
+  vAttrs.push_back(bpToString(static_cast<bpSize>(eVoxelHashBlocks)));
+  vAttrs.push_back("mVoxelBytes");
+  vAttrs.push_back(bpToString(aVoxelHash.GetVoxelBytes()));
+  vXML += vIndent + bpXML::WriteOneLineTag("Image", "", vAttrs) + "\n";
+
+  vXML += vIndent + bpXML::WriteOneLineTag("TotalVoxelBytes", bpToString(aVoxelHash.GetVoxelBytes())) + "\n";
+
+  vXML += aIndent + bpXML::GetEndTag("VoxelHash") + "\n";
+  return vXML;
+}
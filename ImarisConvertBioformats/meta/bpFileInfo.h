@@ -23,15 +23,23 @@
 
 #include "bpFileReader.h"
 #include "bpObjectDescriptor.h"
+#include "bpVoxelHashBlocks.h"
 
 
 class bpFileInfo
 {
 public:
+  enum tVoxelHashVersion {
+    eVoxelHashSequential = 1, // 32-bit, all samples in one sequence (default)
+    eVoxelHashBlocks = 2      // 64-bit, blocks hashed independently and combined in a tree
+  };
+
   static bpString GetXML_AllFileNames(const bpString& aFileName, const bpFileReader::tPtr& aFileReader, const bpString& aIndent = "");
   static bpString GetXML_ReadMetaData(const bpString& aFileName, const bpFileReader::tPtr& aFileReader, bpSize aImageIndex, const bpString& aIndent = "");
   static bpString GetXML_ReadMetaDataForArena(const bpString& aFileName, const bpFileReader::tPtr& aFileReader, bpSize aImageIndex, const bpString& aIndent = "", const std::vector<bpObjectDescriptor>& aObjectDescriptors = {});
-  static bpString GetXML_ReadVoxelHash(const bpString& aFileName, const bpFileReader::tPtr& aFileReader, bpSize aImageIndex, const bpString& aBlockSort, const bpString& aIndent = "");
+  static bpString GetXML_ReadVoxelHash(const bpString& aFileName, const bpFileReader::tPtr& aFileReader, bpSize aImageIndex, const bpString& aBlockSort,
+                                       tVoxelHashVersion aVersion, const std::vector<bpFileReader::tPtr>& aAdditionalFileReaders, bpSize aNumberOfThreads, const bpString& aIndent = "");
+  static bpString GetXML_VoxelHash(const bpFileReader::tPtr& aFileReader, bpSize aImageIndex, const bpVoxelHashBlocks& aVoxelHash, const bpString& aIndent = "");
 
 private:
   static bool ReadMetaData(
@@ -55,6 +63,13 @@ private:
     bpUInt32& aVoxelHash,
     bpUInt64& aVoxelBytes,
     bpString& aExceptionText);
+
+  static bool ReadBlocksVoxelHash(
+    const std::vector<bpFileReader::tPtr>& aFileReaders,
+    bpSize aNumberOfThreads,
+    bpUInt64& aVoxelHash,
+    bpUInt64& aVoxelBytes,
+    bpString& aExceptionText);
 };
 
 #endif // __BP_FILE_INFO__
@@ -22,6 +22,9 @@
 #include "bpFileTools.h"
 #include "bpUtils.h"
 
+#include <cstring>
+#include <fstream>
+
 
 bpFileReaderFactory::bpFileReaderFactory()
   : mAllowTimeReaders(true)
@@ -51,6 +54,16 @@ void bpFileReaderFactory::SetPluginsPath(const bpString& aPluginsPath)
 }
 
 
+void bpFileReaderFactory::SetMetadataLevel(bpfFileReaderImplFactoryBase::tMetadataLevel aMetadataLevel)
+{
+}
+
+
+void bpFileReaderFactory::SetReaderStateCache(const bpString& aDirectory, bpSize aMinimumMilliseconds)
+{
+}
+
+
 void bpFileReaderFactory::AddFormat(const bpString& aFormatName,
                                     const bpString& aFormatDescription,
                                     const std::vector<bpString>& aFormatExtension)
@@ -111,68 +124,149 @@ bpString bpFileReaderFactory::GetFormatFromDescription(const bpString& aDescript
  */
 bpString bpFileReaderFactory::GetFileFormat(const bpString& aFileName)
 {
-  std::list<bpString> vUnusedFormats;
+  bpString vFormat;
+  bpFileReader::tPtr vFileReader = CreateFirstFileReader(aFileName, vFormat);
+  if (!vFileReader) {
+    throw std::runtime_error("Format not supported");
+  }
+  return vFormat;
+}
 
-  // try formats with correct extension first
-  Iterator vFormatIt = mFormats.begin();
-  while (vFormatIt != mFormats.end()) {
-    if (ExtensionMatchesFormat(aFileName, *vFormatIt)) {
-      try {
-        bpFileReader::tPtr vFileReader = CreateFileReader(aFileName, *vFormatIt);
-        return *vFormatIt;
-      }
-      catch (...) {
-      }
-    } else {
-      vUnusedFormats.push_back(*vFormatIt);
-    }
-    ++vFormatIt;
+
+bpFileReader::tPtr bpFileReaderFactory::CreateFileReader(const bpString& aFileName)
+{
+  bpString vFormat;
+  bpFileReader::tPtr vFileReader = CreateFirstFileReader(aFileName, vFormat);
+  if (!vFileReader) {
+    throw std::runtime_error("Unknown File Format.");
   }
-  // then try all formats that we have not yet used
-  vFormatIt = vUnusedFormats.begin();
-  while (vFormatIt != vUnusedFormats.end()) {
+  return vFileReader;
+}
+
+
+bpFileReader::tPtr bpFileReaderFactory::CreateFirstFileReader(const bpString& aFileName, bpString& aFormat)
+{
+  // a reader detecting the format itself fails the same way for all its formats
+  bool vDetectingReaderFailed = false;
+  for (const bpString& vFormat : GetCandidateFormats(aFileName)) {
+    bool vDetectedByReader = IsFormatDetectedByReader(vFormat);
+    if (vDetectedByReader && vDetectingReaderFailed) {
+      continue;
+    }
     try {
-      bpFileReader::tPtr vFileReader = CreateFileReader(aFileName, *vFormatIt);
-      return *vFormatIt;
+      bpFileReader::tPtr vFileReader = CreateFileReader(aFileName, vFormat);
+      if (vFileReader) {
+        std::lock_guard<std::mutex> vLock(mMutex);
+        mDirectoryFormats[GetDirectoryFormatKey(aFileName)] = vFormat;
+        aFormat = vFormat;
+        return vFileReader;
+      }
     }
     catch (...) {
     }
-    ++vFormatIt;
+    vDetectingReaderFailed |= vDetectedByReader;
   }
-  throw std::runtime_error("Format not supported");
+  return {};
 }
 
 
-bpFileReader::tPtr bpFileReaderFactory::CreateFileReader(const bpString& aFileName)
+std::list<bpString> bpFileReaderFactory::GetCandidateFormats(const bpString& aFileName) const
 {
+  std::list<bpString> vCandidates;
   std::list<bpString> vUnusedFormats;
-  // try formats with correct extension first
-  Iterator vFormatIt = mFormats.begin();
-  while (vFormatIt != mFormats.end()) {
-    if (ExtensionMatchesFormat(aFileName, *vFormatIt)) {
-      try {
-        bpFileReader::tPtr vFileReader = CreateFileReader(aFileName, *vFormatIt);
-        return vFileReader;
-      }
-      catch (...) {
-      }
-    } else {
-      vUnusedFormats.push_back(*vFormatIt);
+
+  // the format of the previous file in a batch of similar files first
+  bpString vDirectoryFormat;
+  {
+    std::lock_guard<std::mutex> vLock(mMutex);
+    auto vDirectoryFormatIt = mDirectoryFormats.find(GetDirectoryFormatKey(aFileName));
+    if (vDirectoryFormatIt != mDirectoryFormats.end()) {
+      vDirectoryFormat = vDirectoryFormatIt->second;
     }
-    ++vFormatIt;
   }
-  // then try all formats
-  vFormatIt = vUnusedFormats.begin();
-  while (vFormatIt != vUnusedFormats.end()) {
-    try {
-      bpFileReader::tPtr vFileReader = CreateFileReader(aFileName, *vFormatIt);
-      return vFileReader;
+  if (std::find(mFormats.begin(), mFormats.end(), vDirectoryFormat) != mFormats.end()) {
+    vCandidates.push_back(vDirectoryFormat);
+  }
+
+  // then formats with correct extension
+  for (const bpString& vFormat : mFormats) {
+    if (vFormat == vDirectoryFormat) {
+      continue;
     }
-    catch (...) {
+    if (ExtensionMatchesFormat(aFileName, vFormat)) {
+      vCandidates.push_back(vFormat);
+    }
+    else {
+      vUnusedFormats.push_back(vFormat);
+    }
+  }
+
+  // then formats with an extension matching the content, all others only if the content is unknown
+  std::vector<bpString> vSignatureExtensions = GetExtensionsFromSignature(aFileName);
+  if (vSignatureExtensions.empty()) {
+    vCandidates.splice(vCandidates.end(), vUnusedFormats);
+    return vCandidates;
+  }
+  for (const bpString& vFormat : vUnusedFormats) {
+    for (const bpString& vExtension : vSignatureExtensions) {
+      if (ExtensionMatchesFormat(vExtension, vFormat, false)) {
+        vCandidates.push_back(vFormat);
+        break;
+      }
+    }
+  }
+  return vCandidates;
+}
+
+
+bpString bpFileReaderFactory::GetDirectoryFormatKey(const bpString& aFileName)
+{
+  return bpFileTools::GetPath(aFileName) + "|" + bpToUpper(bpFileTools::GetExt(aFileName));
+}
+
+
+/**
+ * Returns the (upper case) extensions of the file types recognized by the first bytes of
+ * the file, empty if not recognized or not a file.
+ */
+std::vector<bpString> bpFileReaderFactory::GetExtensionsFromSignature(const bpString& aFileName)
+{
+  struct cSignature
+  {
+    const char* mBytes;
+    bpSize mSize;
+    std::vector<bpString> mExtensions;
+  };
+
+  static const std::vector<cSignature> vSignatures = {
+    { "II*\0", 4, { "TIF", "TIFF" } },
+    { "MM\0*", 4, { "TIF", "TIFF" } },
+    { "II+\0", 4, { "TIF", "TIFF", "BTF", "TF8" } },
+    { "MM\0+", 4, { "TIF", "TIFF", "BTF", "TF8" } },
+    { "\x89HDF\r\n\x1a\n", 8, { "IMS", "H5", "HDF5" } },
+    { "ZISRAWFILE", 10, { "CZI" } },
+    { "\xda\xce\xbe\x0a", 4, { "ND2" } },
+    { "\x89PNG\r\n\x1a\n", 8, { "PNG" } },
+    { "\xff\xd8\xff", 3, { "JPG", "JPEG" } },
+    { "\0\0\0\x0cjP  ", 8, { "JP2", "J2K", "JPF" } }
+  };
+
+#ifdef BP_UTF8_FILENAMES
+  std::ifstream vFile(bpFileTools::FromUtf8Path(aFileName), std::ifstream::binary);
+#else
+  std::ifstream vFile(aFileName.c_str(), std::ifstream::binary);
+#endif
+
+  char vHeader[16] = { 0 };
+  vFile.read(vHeader, sizeof(vHeader));
+  bpSize vHeaderSize = static_cast<bpSize>(vFile.gcount());
+
+  for (const cSignature& vSignature : vSignatures) {
+    if (vSignature.mSize <= vHeaderSize && std::memcmp(vHeader, vSignature.mBytes, vSignature.mSize) == 0) {
+      return vSignature.mExtensions;
     }
-    ++vFormatIt;
   }
-  throw std::runtime_error("Unknown File Format.");
+  return {};
 }
 
 
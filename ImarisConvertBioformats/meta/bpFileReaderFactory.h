@@ -22,11 +22,11 @@
 
 #include "bpFileReader.h"
 
+#include "fileiobase/application/bpfFileReaderImplFactoryBase.h"
+
 #include <list>
 #include <map>
-
-
-class bpfFileReaderImplFactoryBase;
+#include <mutex>
 
 
 class bpFileReaderFactory
@@ -41,6 +41,8 @@ public:
   Iterator FormatEnd();
   bool ExtensionMatchesFormat(const bpString& aFileName, const bpString& aFormat, bool aIsPath = true) const;
   virtual void SetPluginsPath(const bpString& aPluginsPath);
+  virtual void SetMetadataLevel(bpfFileReaderImplFactoryBase::tMetadataLevel aMetadataLevel);
+  virtual void SetReaderStateCache(const bpString& aDirectory, bpSize aMinimumMilliseconds);
 
   virtual void AddFactoryImpl(const bpSharedPtr<bpfFileReaderImplFactoryBase>& aFactory) = 0;
   virtual bpSharedPtr<bpfFileReaderImplFactoryBase> GetFactoryImpl() const = 0;
@@ -105,7 +107,7 @@ public:
   /**
    * Create a FileReader to open aFileName
    *
-   * tests all formats and returns first reader that fits
+   * tests the candidate formats (see GetCandidateFormats) and returns first reader that fits.
    *
    * @param aFileName
    *
@@ -113,6 +115,13 @@ public:
    */
   bpFileReader::tPtr CreateFileReader(const bpString& aFileName);
 
+  /**
+   * Formats to try for aFileName, in this order: the format that opened the last file with the
+   * same extension in the same directory, formats with a matching extension, formats matching the
+   * first bytes of the file. All other formats follow only if the first bytes are not recognized.
+   */
+  std::list<bpString> GetCandidateFormats(const bpString& aFileName) const;
+
 
   /**
    * Concrete Factories are to overwrite this function
@@ -124,6 +133,12 @@ public:
    */
   virtual bpFileReader::tPtr CreateFileReader(const bpString& aFileName, const bpString& aFormat) = 0;
 
+  /**
+   * True if CreateFileReader(aFileName, aFormat) does not depend on aFormat because the
+   * reader detects the format itself. Once such a format failed, the others are not tried.
+   */
+  virtual bool IsFormatDetectedByReader(const bpString& aFormat) const { return false; }
+
 
   /**
    *
@@ -163,6 +178,17 @@ protected:
 
   std::map<bpString, bpString> mDescriptions;
   std::map<bpString, std::vector<bpString> > mExtensions;
+
+private:
+  bpFileReader::tPtr CreateFirstFileReader(const bpString& aFileName, bpString& aFormat);
+  static bpString GetDirectoryFormatKey(const bpString& aFileName);
+  static std::vector<bpString> GetExtensionsFromSignature(const bpString& aFileName);
+
+  // guards the members below, the factory is shared by parallel jobs
+  mutable std::mutex mMutex;
+
+  // format that opened the last file per directory and extension
+  std::map<bpString, bpString> mDirectoryFormats;
 };
 
 
@@ -59,6 +59,22 @@ void bpFileReaderFactoryFileIO::SetPluginsPath(const bpString& aPluginsPath)
 }
 
 
+void bpFileReaderFactoryFileIO::SetMetadataLevel(bpfFileReaderImplFactoryBase::tMetadataLevel aMetadataLevel)
+{
+  for (const auto& vFactory : mFileReaderImplFactories) {
+    vFactory->SetMetadataLevel(aMetadataLevel);
+  }
+}
+
+
+void bpFileReaderFactoryFileIO::SetReaderStateCache(const bpString& aDirectory, bpSize aMinimumMilliseconds)
+{
+  for (const auto& vFactory : mFileReaderImplFactories) {
+    vFactory->SetReaderStateCache(aDirectory, aMinimumMilliseconds);
+  }
+}
+
+
 void bpFileReaderFactoryFileIO::AddFactoryImpl(const bpSharedPtr<bpfFileReaderImplFactoryBase>& aFactory)
 {
   mFileReaderImplFactories.push_back(aFactory);
@@ -105,6 +121,21 @@ bpFileReader::tPtr bpFileReaderFactoryFileIO::CreateFileReader(const bpString& a
 }
 
 
+bool bpFileReaderFactoryFileIO::IsFormatDetectedByReader(const bpString& aFormat) const
+{
+  // CreateFileReader passes aFormat to every factory, it matters unless all of them ignore it
+  if (aFormat == mImarisScene || mFileReaderImplFactories.empty()) {
+    return false;
+  }
+  for (const auto& vFactory : mFileReaderImplFactories) {
+    if (!vFactory->DetectsFileFormat()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+
 std::list<bpString> bpFileReaderFactoryFileIO::ReadFormats()
 {
   std::list<bpString> vFormats;
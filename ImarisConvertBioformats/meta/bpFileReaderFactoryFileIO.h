@@ -31,10 +31,13 @@ public:
   ~bpFileReaderFactoryFileIO();
 
   void SetPluginsPath(const bpString& aPluginsPath);
+  void SetMetadataLevel(bpfFileReaderImplFactoryBase::tMetadataLevel aMetadataLevel);
+  void SetReaderStateCache(const bpString& aDirectory, bpSize aMinimumMilliseconds);
   void AddFactoryImpl(const bpSharedPtr<bpfFileReaderImplFactoryBase>& aFactory);
   bpSharedPtr<bpfFileReaderImplFactoryBase> GetFactoryImpl() const;
 
   bpFileReader::tPtr CreateFileReader(const bpString& aFileName, const bpString& aFormat);
+  bool IsFormatDetectedByReader(const bpString& aFormat) const;
 
 private:
   void AddFormats();
@@ -292,6 +292,12 @@ bool bpFileReaderImpl::SetDataBlockSize(bpSize aDimension0, bpSize aDimension1,
   return false;
 }
 
+bool bpFileReaderImpl::SetCropLimits(const std::vector<bpSize>& aMin, const std::vector<bpSize>& aMax)
+{
+  // per default the reader cannot crop
+  return false;
+}
+
 bpSize bpFileReaderImpl::GetDataBlockSize(bpSize aDimensionOrder)
 {
   return GetDataBlockSize()[GetDimensionSequence()[aDimensionOrder]];
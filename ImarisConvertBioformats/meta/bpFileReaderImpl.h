@@ -215,6 +215,20 @@ public:
    */
   virtual bool SetDataBlockSize(bpSize aDimension0, bpSize aDimension1, bpSize aDimension2, bpSize aDimension3, bpSize aDimension4, bpSize aResolutionLevel);
 
+  /**
+   * Restrict the image to the box [aMin, aMax) given in XYZCT order and in
+   * voxels of the full resolution level. A max of 0 stands for the full size.
+   * Sizes, blocks and extents then describe the cropped image and blocks
+   * outside the box are never read. If the filereader cannot crop, false is
+   * returned and nothing changes.
+   *
+   * @param aMin
+   * @param aMax
+   *
+   * @return bool true if success
+   */
+  virtual bool SetCropLimits(const std::vector<bpSize>& aMin, const std::vector<bpSize>& aMax);
+
   /**
    * Size of datablock as vector in data coordinates
    */
@@ -411,6 +411,27 @@ public:
     }
   }
 
+  /**
+   * Restrict the image to the box [aMin, aMax) given in XYZCT order and in
+   * voxels of the full resolution level. A max of 0 stands for the full size.
+   * Sizes, blocks and extents then describe the cropped image and blocks
+   * outside the box are never read. If the filereader cannot crop, false is
+   * returned and nothing changes.
+   *
+   * @param aMin
+   * @param aMax
+   *
+   * @return bool true if success
+   */
+  virtual bool SetCropLimits(const std::vector<bpSize>& aMin, const std::vector<bpSize>& aMax) override {
+    try {
+      return mFileReaderImplInterface->SetCropLimits(aMin, aMax);
+    }
+    catch (bpfException& vException) {
+      throw Error(vException);
+    }
+  }
+
   /**
    * Size of datablock as vector in data coordinates
    */
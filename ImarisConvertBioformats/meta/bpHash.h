@@ -20,6 +20,8 @@
 #ifndef __BP_HASH__
 #define __BP_HASH__
 
+#include <cstring>
+
 /**
  * Creates a 32-bit hash code from a sequence of samples
  */
@@ -72,4 +74,110 @@ private:
 
 };
 
+
+/**
+ * Creates a 64-bit hash code of a memory block (xxHash64). Independent blocks
+ * are hashed in parallel and their codes combined with Combine().
+ */
+class bpHash64 {
+
+public:
+
+  static inline bpUInt64 GetCode(const void* aData, bpSize aSize, bpUInt64 aSeed = 0) {
+    const bpUInt8* vData = static_cast<const bpUInt8*>(aData);
+    const bpUInt8* vEnd = vData + aSize;
+    bpUInt64 vCode;
+
+    if (aSize >= 32) {
+      // four independent lanes, the compiler can keep them in parallel
+      bpUInt64 vLane0 = aSeed + mPrime1 + mPrime2;
+      bpUInt64 vLane1 = aSeed + mPrime2;
+      bpUInt64 vLane2 = aSeed;
+      bpUInt64 vLane3 = aSeed - mPrime1;
+      const bpUInt8* vLimit = vEnd - 32;
+      do {
+        vLane0 = Round(vLane0, Read64(vData));
+        vLane1 = Round(vLane1, Read64(vData + 8));
+        vLane2 = Round(vLane2, Read64(vData + 16));
+        vLane3 = Round(vLane3, Read64(vData + 24));
+        vData += 32;
+      } while (vData <= vLimit);
+
+      vCode = RotateLeft(vLane0, 1) + RotateLeft(vLane1, 7) + RotateLeft(vLane2, 12) + RotateLeft(vLane3, 18);
+      vCode = MergeRound(vCode, vLane0);
+      vCode = MergeRound(vCode, vLane1);
+      vCode = MergeRound(vCode, vLane2);
+      vCode = MergeRound(vCode, vLane3);
+    }
+    else {
+      vCode = aSeed + mPrime5;
+    }
+
+    vCode += static_cast<bpUInt64>(aSize);
+
+    for (; vData + 8 <= vEnd; vData += 8) {
+      vCode ^= Round(0, Read64(vData));
+      vCode = RotateLeft(vCode, 27) * mPrime1 + mPrime4;
+    }
+    if (vData + 4 <= vEnd) {
+      vCode ^= static_cast<bpUInt64>(Read32(vData)) * mPrime1;
+      vCode = RotateLeft(vCode, 23) * mPrime2 + mPrime3;
+      vData += 4;
+    }
+    for (; vData < vEnd; ++vData) {
+      vCode ^= static_cast<bpUInt64>(*vData) * mPrime5;
+      vCode = RotateLeft(vCode, 11) * mPrime1;
+    }
+
+    vCode ^= vCode >> 33;
+    vCode *= mPrime2;
+    vCode ^= vCode >> 29;
+    vCode *= mPrime3;
+    vCode ^= vCode >> 32;
+    return vCode;
+  }
+
+  // order dependent combination of two codes
+  static inline bpUInt64 Combine(bpUInt64 aFirst, bpUInt64 aSecond) {
+    bpUInt64 vCodes[2] = { aFirst, aSecond };
+    return GetCode(vCodes, sizeof(vCodes));
+  }
+
+private:
+
+  static inline bpUInt64 RotateLeft(bpUInt64 aValue, int aBits) {
+    return (aValue << aBits) | (aValue >> (64 - aBits));
+  }
+
+  static inline bpUInt64 Round(bpUInt64 aLane, bpUInt64 aInput) {
+    aLane += aInput * mPrime2;
+    aLane = RotateLeft(aLane, 31);
+    return aLane * mPrime1;
+  }
+
+  static inline bpUInt64 MergeRound(bpUInt64 aCode, bpUInt64 aLane) {
+    aCode ^= Round(0, aLane);
+    return aCode * mPrime1 + mPrime4;
+  }
+
+  // little endian reads (the hash is defined on little endian data)
+  static inline bpUInt64 Read64(const bpUInt8* aData) {
+    bpUInt64 vValue;
+    std::memcpy(&vValue, aData, sizeof(vValue));
+    return vValue;
+  }
+
+  static inline bpUInt32 Read32(const bpUInt8* aData) {
+    bpUInt32 vValue;
+    std::memcpy(&vValue, aData, sizeof(vValue));
+    return vValue;
+  }
+
+  static const bpUInt64 mPrime1 = 11400714785074694791ULL;
+  static const bpUInt64 mPrime2 = 14029467366897019727ULL;
+  static const bpUInt64 mPrime3 = 1609587929392839161ULL;
+  static const bpUInt64 mPrime4 = 9650029242287828579ULL;
+  static const bpUInt64 mPrime5 = 2870177450012600261ULL;
+};
+
 #endif // __BP_HASH__
@@ -194,6 +194,44 @@ bpString bpReplace(const bpString& aString, const bpString& aSubStringOld, const
 }
 
 
+bpString bpToJsonString(const bpString& aString)
+{
+  static const char* vHexDigits = "0123456789abcdef";
+
+  bpString vJson = "\"";
+  for (char vChar : aString) {
+    switch (vChar) {
+    case '"':
+      vJson += "\\\"";
+      break;
+    case '\\':
+      vJson += "\\\\";
+      break;
+    case '\n':
+      vJson += "\\n";
+      break;
+    case '\r':
+      vJson += "\\r";
+      break;
+    case '\t':
+      vJson += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(vChar) < 0x20) {
+        vJson += "\\u00";
+        vJson += vHexDigits[(vChar >> 4) & 0xf];
+        vJson += vHexDigits[vChar & 0xf];
+      }
+      else {
+        vJson += vChar;
+      }
+    }
+  }
+  vJson += "\"";
+  return vJson;
+}
+
+
 bool bpStartsWith(const bpString& aString, const bpString& aPrefix)
 {
   if (aString.size() < aPrefix.size()) {
@@ -193,6 +193,10 @@ std::vector<bpInt32> bpSplitNumericInt32(const bpString& aString);
 bpString bpReplace(const bpString& aString, const bpString& aSubStringOld, const bpString& aSubStringNew);
 
 
+// quoted and escaped JSON string value
+bpString bpToJsonString(const bpString& aString);
+
+
 bool bpStartsWith(const bpString& aString, const bpString& aPrefix);
 
 
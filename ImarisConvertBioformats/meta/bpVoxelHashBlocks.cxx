@@ -0,0 +1,150 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#include "bpVoxelHashBlocks.h"
+
+#include "bpHash.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+bpVoxelHashBlocks::bpVoxelHashBlocks(const std::vector<bpSize>& aSizes, const std::vector<bpSize>& aBlockSizes, bpSize aTypeSize)
+  : mSizes(aSizes),
+    mBlockSizes(aBlockSizes),
+    mTypeSize(aTypeSize),
+    mBlockBytes(aTypeSize)
+{
+  if (mSizes.size() != mBlockSizes.size()) {
+    throw std::runtime_error("Block sizes don't match the image sizes");
+  }
+
+  bpSize vNumberOfBlocks = 1;
+  for (bpSize vDimension = 0; vDimension < mSizes.size(); vDimension++) {
+    bpSize vBlockSize = std::max<bpSize>(mBlockSizes[vDimension], 1);
+    mNumberOfBlocksV.push_back((mSizes[vDimension] + vBlockSize - 1) / vBlockSize);
+    vNumberOfBlocks *= mNumberOfBlocksV.back();
+    mBlockBytes *= mBlockSizes[vDimension];
+  }
+  mCodes.resize(vNumberOfBlocks, 0);
+  mHasCode.resize(vNumberOfBlocks, 0);
+}
+
+
+void bpVoxelHashBlocks::AddBlock(bpSize aBlockNumber, const void* aDataBlock)
+{
+  if (aBlockNumber >= mCodes.size()) {
+    throw std::runtime_error("Invalid block number " + bpToString(aBlockNumber));
+  }
+
+  // only voxels inside the image count, border blocks are compacted in a copy
+  std::vector<bpSize> vValidSizes = GetValidBlockSize(aBlockNumber);
+  if (vValidSizes == mBlockSizes) {
+    mCodes[aBlockNumber] = bpHash64::GetCode(aDataBlock, mBlockBytes);
+  }
+  else {
+    const bpUInt8* vDataBlock = static_cast<const bpUInt8*>(aDataBlock);
+    std::vector<bpUInt8> vBuffer(vDataBlock, vDataBlock + mBlockBytes);
+    bpSize vValidBytes = CompactDataBlock(vBuffer.data(), vValidSizes);
+    mCodes[aBlockNumber] = bpHash64::GetCode(vBuffer.data(), vValidBytes);
+  }
+  mHasCode[aBlockNumber] = 1;
+}
+
+
+bpSize bpVoxelHashBlocks::GetNumberOfBlocks() const
+{
+  return mCodes.size();
+}
+
+
+bool bpVoxelHashBlocks::IsComplete() const
+{
+  return std::find(mHasCode.begin(), mHasCode.end(), 0) == mHasCode.end();
+}
+
+
+bpUInt64 bpVoxelHashBlocks::GetCode() const
+{
+  // combine the codes of neighbour blocks until one is left
+  std::vector<bpUInt64> vCodes = mCodes;
+  while (vCodes.size() > 1) {
+    std::vector<bpUInt64> vParentCodes((vCodes.size() + 1) / 2);
+    for (bpSize vIndex = 0; vIndex < vParentCodes.size(); vIndex++) {
+      vParentCodes[vIndex] = 2 * vIndex + 1 < vCodes.size() ? bpHash64::Combine(vCodes[2 * vIndex], vCodes[2 * vIndex + 1]) : vCodes[2 * vIndex];
+    }
+    vCodes.swap(vParentCodes);
+  }
+
+  // images of different size or type have a different hash
+  std::vector<bpUInt64> vImageCode{ vCodes.empty() ? 0 : vCodes[0], mTypeSize };
+  for (bpSize vSize : mSizes) {
+    vImageCode.push_back(vSize);
+  }
+  return bpHash64::GetCode(vImageCode.data(), vImageCode.size() * sizeof(bpUInt64));
+}
+
+
+bpUInt64 bpVoxelHashBlocks::GetVoxelBytes() const
+{
+  bpUInt64 vVoxelBytes = mTypeSize;
+  for (bpSize vSize : mSizes) {
+    vVoxelBytes *= vSize;
+  }
+  return vVoxelBytes;
+}
+
+
+std::vector<bpSize> bpVoxelHashBlocks::GetValidBlockSize(bpSize aBlockNumber) const
+{
+  std::vector<bpSize> vValidSizes(mSizes.size());
+  for (bpSize vDimension = 0; vDimension < mSizes.size(); vDimension++) {
+    bpSize vBlockStart = (aBlockNumber % mNumberOfBlocksV[vDimension]) * mBlockSizes[vDimension];
+    vValidSizes[vDimension] = std::min<bpSize>(mBlockSizes[vDimension], mSizes[vDimension] - vBlockStart);
+    aBlockNumber /= mNumberOfBlocksV[vDimension];
+  }
+  return vValidSizes;
+}
+
+
+// moves the voxels inside the image to the front of a border block, returns their number of bytes
+bpSize bpVoxelHashBlocks::CompactDataBlock(bpUInt8* aDataBlock, const std::vector<bpSize>& aValidSizes) const
+{
+  bpSize vRowBytes = aValidSizes[0] * mTypeSize;
+  bpSize vNumberOfRows = 1;
+  for (bpSize vDimension = 1; vDimension < aValidSizes.size(); vDimension++) {
+    vNumberOfRows *= aValidSizes[vDimension];
+  }
+
+  bpUInt8* vTarget = aDataBlock;
+  for (bpSize vRow = 0; vRow < vNumberOfRows; vRow++) {
+    bpSize vOffset = 0;
+    bpSize vStride = mBlockSizes[0];
+    bpSize vRowIndex = vRow;
+    for (bpSize vDimension = 1; vDimension < aValidSizes.size(); vDimension++) {
+      vOffset += (vRowIndex % aValidSizes[vDimension]) * vStride;
+      vRowIndex /= aValidSizes[vDimension];
+      vStride *= mBlockSizes[vDimension];
+    }
+    std::memmove(vTarget, aDataBlock + vOffset * mTypeSize, vRowBytes);
+    vTarget += vRowBytes;
+  }
+  return vRowBytes * vNumberOfRows;
+}
@@ -0,0 +1,62 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#ifndef __BP_VOXEL_HASH_BLOCKS__
+#define __BP_VOXEL_HASH_BLOCKS__
+
+#include "bpUtils.h"
+
+#include <vector>
+
+
+/**
+ * Creates the 64-bit voxel hash (version 2) of an image from its data blocks.
+ * Every block is hashed independently, the codes are combined in a tree, so
+ * the blocks can be added in any order and from several threads (each block
+ * number from one thread only).
+ */
+class bpVoxelHashBlocks
+{
+public:
+  bpVoxelHashBlocks(const std::vector<bpSize>& aSizes, const std::vector<bpSize>& aBlockSizes, bpSize aTypeSize);
+
+  // aDataBlock holds all voxels of the block, the padding of border blocks is ignored
+  void AddBlock(bpSize aBlockNumber, const void* aDataBlock);
+
+  bpSize GetNumberOfBlocks() const;
+  bool IsComplete() const;
+
+  bpUInt64 GetCode() const;
+  bpUInt64 GetVoxelBytes() const;
+
+private:
+  std::vector<bpSize> GetValidBlockSize(bpSize aBlockNumber) const;
+  bpSize CompactDataBlock(bpUInt8* aDataBlock, const std::vector<bpSize>& aValidSizes) const;
+
+  std::vector<bpSize> mSizes;
+  std::vector<bpSize> mBlockSizes;
+  std::vector<bpSize> mNumberOfBlocksV;
+  bpSize mTypeSize;
+  bpSize mBlockBytes;
+
+  std::vector<bpUInt64> mCodes;
+  std::vector<bpUInt8> mHasCode;
+};
+
+#endif // __BP_VOXEL_HASH_BLOCKS__
@@ -0,0 +1,256 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#include "bpConvertJournal.h"
+#include "../meta/bpFileTools.h"
+#include "../meta/bpUtils.h"
+
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+
+// first line of every journal, change it when the layout changes
+static const bpString gJournalHeader = "bpConvertJournal 1";
+
+
+static bpString ToSingleLine(bpString aText)
+{
+  std::replace(aText.begin(), aText.end(), '\n', ' ');
+  std::replace(aText.begin(), aText.end(), '\r', ' ');
+  return aText;
+}
+
+
+static boost::filesystem::path GetPath(const bpString& aFileName)
+{
+#ifdef BP_UTF8_FILENAMES
+  return boost::filesystem::path(bpFileTools::FromUtf8Path(aFileName));
+#else
+  return boost::filesystem::path(aFileName);
+#endif
+}
+
+
+static FILE* OpenFile(const bpString& aFileName, const char* aMode)
+{
+#if defined(_WIN32) && defined(BP_UTF8_FILENAMES)
+  std::wstring vMode(aMode, aMode + std::char_traits<char>::length(aMode));
+  return _wfopen(bpFileTools::FromUtf8Path(aFileName).c_str(), vMode.c_str());
+#else
+  return std::fopen(aFileName.c_str(), aMode);
+#endif
+}
+
+
+// returns when the data is on the disk, not only in the cache of the operating system
+static bool FlushToDisk(FILE* aFile)
+{
+  if (std::fflush(aFile) != 0) {
+    return false;
+  }
+#if defined(_WIN32)
+  return _commit(_fileno(aFile)) == 0;
+#else
+  return fsync(fileno(aFile)) == 0;
+#endif
+}
+
+
+bpConvertJournal::bpConvertJournal(const bpString& aOutputFile, const bpString& aKey, bpSize aBlockBytes, bpFloat aCheckpointInterval)
+  : mJournalFileName(aOutputFile + ".journal"),
+    mBlocksFileName(aOutputFile + ".journal.blocks"),
+    mKey(ToSingleLine(aKey)),
+    mBlockBytes(aBlockBytes),
+    mCheckpointInterval(aCheckpointInterval)
+{
+}
+
+
+bpConvertJournal::~bpConvertJournal()
+{
+  // also after an error, the blocks added so far are valid
+  try {
+    Checkpoint();
+  }
+  catch (...) {
+  }
+  Close();
+}
+
+
+bpSize bpConvertJournal::Open(bool aResume)
+{
+  Close();
+
+  bpSize vNumberOfBlocks = aResume ? ReadDurableBlocks() : 0;
+  if (vNumberOfBlocks > 0) {
+    // blocks added after the last checkpoint are not durable, they are read again from the input
+    boost::system::error_code vError;
+    boost::filesystem::resize_file(GetPath(mBlocksFileName), static_cast<bpUInt64>(vNumberOfBlocks) * mBlockBytes, vError);
+    if (vError) {
+      vNumberOfBlocks = 0;
+    }
+  }
+
+  if (vNumberOfBlocks > 0) {
+    mJournal = OpenFile(mJournalFileName, "ab");
+    mBlocks = OpenFile(mBlocksFileName, "ab");
+    mReplay = OpenFile(mBlocksFileName, "rb");
+  }
+  else {
+    mJournal = OpenFile(mJournalFileName, "wb");
+    mBlocks = OpenFile(mBlocksFileName, "wb");
+    if (mJournal) {
+      std::ostringstream vHeader;
+      vHeader << gJournalHeader << "\n" << mKey << "\n" << mBlockBytes << "\n";
+      bpString vText = vHeader.str();
+      if (std::fwrite(vText.data(), 1, vText.size(), mJournal) != vText.size() || !FlushToDisk(mJournal)) {
+        Close();
+      }
+    }
+  }
+
+  if (!mJournal || !mBlocks || (vNumberOfBlocks > 0 && !mReplay)) {
+    Close();
+    throw std::runtime_error("Unable to open the journal \"" + mJournalFileName + "\"");
+  }
+
+  mNumberOfBlocks = vNumberOfBlocks;
+  mNumberOfDurableBlocks = vNumberOfBlocks;
+  mLastCheckpoint = std::chrono::steady_clock::now();
+  return vNumberOfBlocks;
+}
+
+
+void bpConvertJournal::ReadBlock(void* aBuffer)
+{
+  if (!mReplay || std::fread(aBuffer, 1, mBlockBytes, mReplay) != mBlockBytes) {
+    throw std::runtime_error("Unable to read the journal \"" + mBlocksFileName + "\"");
+  }
+}
+
+
+void bpConvertJournal::AddBlock(const void* aBuffer)
+{
+  if (!mBlocks) {
+    return;
+  }
+  if (std::fwrite(aBuffer, 1, mBlockBytes, mBlocks) != mBlockBytes) {
+    throw std::runtime_error("Unable to write the journal \"" + mBlocksFileName + "\"");
+  }
+  ++mNumberOfBlocks;
+
+  if (std::chrono::steady_clock::now() - mLastCheckpoint >= mCheckpointInterval) {
+    Checkpoint();
+  }
+}
+
+
+void bpConvertJournal::Checkpoint()
+{
+  if (!mJournal || !mBlocks || mNumberOfBlocks == mNumberOfDurableBlocks) {
+    return;
+  }
+
+  // the blocks must be on the disk before the journal refers to them
+  if (!FlushToDisk(mBlocks)) {
+    throw std::runtime_error("Unable to write the journal \"" + mBlocksFileName + "\"");
+  }
+  bpString vLine = bpToString(mNumberOfBlocks) + "\n";
+  if (std::fwrite(vLine.data(), 1, vLine.size(), mJournal) != vLine.size() || !FlushToDisk(mJournal)) {
+    throw std::runtime_error("Unable to write the journal \"" + mJournalFileName + "\"");
+  }
+  mNumberOfDurableBlocks = mNumberOfBlocks;
+  mLastCheckpoint = std::chrono::steady_clock::now();
+}
+
+
+void bpConvertJournal::Remove()
+{
+  Close();
+  // without the journal, left over blocks are never used
+  bpFileTools::FileRemove(mJournalFileName);
+  bpFileTools::FileRemove(mBlocksFileName);
+}
+
+
+bpSize bpConvertJournal::ReadDurableBlocks() const
+{
+#ifdef BP_UTF8_FILENAMES
+  std::ifstream vFile(bpFileTools::FromUtf8Path(mJournalFileName).c_str(), std::ios::binary);
+#else
+  std::ifstream vFile(mJournalFileName.c_str(), std::ios::binary);
+#endif
+  if (!vFile.is_open()) {
+    return 0;
+  }
+
+  // a line is only complete with its newline, the last one may have been cut by the interruption
+  bpString vText((std::istreambuf_iterator<char>(vFile)), std::istreambuf_iterator<char>());
+  bpSize vEnd = vText.rfind('\n');
+  if (vEnd == bpString::npos) {
+    return 0;
+  }
+  std::istringstream vLines(vText.substr(0, vEnd + 1));
+
+  bpString vLine;
+  if (!std::getline(vLines, vLine) || vLine != gJournalHeader) {
+    return 0;
+  }
+  if (!std::getline(vLines, vLine) || vLine != mKey) {
+    return 0;
+  }
+  if (!std::getline(vLines, vLine) || vLine != bpToString(mBlockBytes)) {
+    return 0;
+  }
+
+  // one line per checkpoint, the last one counts
+  bpSize vNumberOfBlocks = 0;
+  while (std::getline(vLines, vLine)) {
+    vNumberOfBlocks = bpFromString<bpSize>(vLine);
+  }
+
+  boost::system::error_code vError;
+  bpUInt64 vBlocksFileSize = boost::filesystem::file_size(GetPath(mBlocksFileName), vError);
+  if (vError || vBlocksFileSize < static_cast<bpUInt64>(vNumberOfBlocks) * mBlockBytes) {
+    return 0;
+  }
+  return vNumberOfBlocks;
+}
+
+
+void bpConvertJournal::Close()
+{
+  for (FILE** vFile : { &mJournal, &mBlocks, &mReplay }) {
+    if (*vFile) {
+      std::fclose(*vFile);
+      *vFile = nullptr;
+    }
+  }
+}
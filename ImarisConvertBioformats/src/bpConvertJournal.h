@@ -0,0 +1,89 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#ifndef __BP_CONVERT_JOURNAL__
+#define __BP_CONVERT_JOURNAL__
+
+
+#include "ImarisWriter/interface/bpConverterTypes.h"
+
+#include <chrono>
+#include <cstdio>
+
+
+/**
+ * Sidecar journal making a conversion resumable after the process was
+ * killed (timeout, preemption of the node).
+ *
+ * The blocks given to the writers are appended to "<output>.journal.blocks".
+ * After they are flushed to disk, their number is appended to "<output>.journal",
+ * at most every aCheckpointInterval seconds. The last number in the journal is
+ * the count of durable blocks.
+ *
+ * The writer can not reopen a partial imaris file, so a resumed conversion
+ * writes it again from the start: the durable blocks are read back from the
+ * journal, only the remaining ones are read from the input file.
+ *
+ * The journal is only resumed with the same key, which must describe
+ * everything the blocks depend on (input files, reader options, block layout).
+ */
+class bpConvertJournal
+{
+public:
+  bpConvertJournal(const bpString& aOutputFile, const bpString& aKey, bpSize aBlockBytes, bpFloat aCheckpointInterval);
+  ~bpConvertJournal();
+
+  /**
+   * Starts a new journal or, with aResume, continues an existing one of the same key.
+   * Returns the number of durable blocks to be read back with ReadBlock().
+   */
+  bpSize Open(bool aResume);
+
+  // the durable blocks in their original order
+  void ReadBlock(void* aBuffer);
+
+  // appends the next block, a checkpoint is written if the interval passed
+  void AddBlock(const void* aBuffer);
+
+  // makes all added blocks durable
+  void Checkpoint();
+
+  // deletes the journal after the conversion succeeded
+  void Remove();
+
+private:
+  bpSize ReadDurableBlocks() const;
+  void Close();
+
+  bpString mJournalFileName;
+  bpString mBlocksFileName;
+  bpString mKey;
+  bpSize mBlockBytes;
+  std::chrono::duration<bpFloat> mCheckpointInterval;
+
+  FILE* mJournal = nullptr;
+  FILE* mBlocks = nullptr;
+  FILE* mReplay = nullptr;
+  bpSize mNumberOfBlocks = 0;
+  bpSize mNumberOfDurableBlocks = 0;
+  std::chrono::steady_clock::time_point mLastCheckpoint;
+};
+
+
+#endif // __BP_CONVERT_JOURNAL__
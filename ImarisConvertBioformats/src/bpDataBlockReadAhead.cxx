@@ -0,0 +1,217 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#include "bpDataBlockReadAhead.h"
+#include "bpStageMetrics.h"
+#include "bpTraceFile.h"
+#include "ImarisWriter/interface/bpImageConverter.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+
+template<typename TDataType>
+bpDataBlockReadAhead<TDataType>::bpDataBlockReadAhead(std::vector<tReaderImplPtr> aReaders, std::vector<bpSize> aBlockNumbers, bpSize aBlockNumberOfVoxels, bpSize aReadAheadBlocks, bpMemoryBudget* aMemoryBudget)
+  : mReaders(std::move(aReaders)),
+    mBlockNumbers(std::move(aBlockNumbers)),
+    mBlockNumberOfVoxels(aBlockNumberOfVoxels),
+    mMemoryBudget(aMemoryBudget)
+{
+  if (mReaders.empty()) {
+    throw std::runtime_error("No reader to read data blocks from");
+  }
+
+  // one buffer is held by the consumer, the others are filled by the reader threads
+  bpSize vNumberOfBuffers = std::max<bpSize>(aReadAheadBlocks, mReaders.size() > 1 ? mReaders.size() : 0) + 1;
+  if (mMemoryBudget) {
+    // less read ahead (down to synchronous reading) when the other conversions hold the memory
+    bpUInt64 vBufferBytes = mBlockNumberOfVoxels * sizeof(TDataType);
+    mMemoryBudget->Acquire(vBufferBytes);
+    bpSize vNumberOfBudgetBuffers = 1;
+    while (vNumberOfBudgetBuffers < vNumberOfBuffers && mMemoryBudget->TryAcquire(vBufferBytes)) {
+      ++vNumberOfBudgetBuffers;
+    }
+    vNumberOfBuffers = vNumberOfBudgetBuffers;
+  }
+  try {
+    for (bpSize vIndex = 0; vIndex < vNumberOfBuffers; ++vIndex) {
+      mBuffers.emplace_back(new TDataType[mBlockNumberOfVoxels]);
+    }
+  }
+  catch (...) {
+    if (mMemoryBudget) {
+      mMemoryBudget->Release(vNumberOfBuffers * mBlockNumberOfVoxels * sizeof(TDataType));
+    }
+    throw;
+  }
+  mBufferBlockIndices.assign(vNumberOfBuffers, static_cast<bpSize>(-1));
+
+  if (vNumberOfBuffers > 1 && !mBlockNumbers.empty()) {
+    try {
+      for (const tReaderImplPtr& vReader : mReaders) {
+        mThreads.emplace_back([this, vReader] { Run(vReader); });
+      }
+    }
+    catch (...) {
+      // the destructor is not called, the started threads would terminate the process
+      StopThreads();
+      ReleaseBuffers();
+      throw;
+    }
+  }
+}
+
+
+template<typename TDataType>
+bpDataBlockReadAhead<TDataType>::~bpDataBlockReadAhead()
+{
+  StopThreads();
+  ReleaseBuffers();
+}
+
+
+template<typename TDataType>
+void bpDataBlockReadAhead<TDataType>::StopThreads()
+{
+  {
+    std::lock_guard<std::mutex> vLock(mMutex);
+    mStop = true;
+  }
+  mBlockReleased.notify_all();
+  for (std::thread& vThread : mThreads) {
+    vThread.join();
+  }
+  mThreads.clear();
+}
+
+
+template<typename TDataType>
+void bpDataBlockReadAhead<TDataType>::ReleaseBuffers()
+{
+  bpUInt64 vBufferBytes = mBuffers.size() * mBlockNumberOfVoxels * sizeof(TDataType);
+  mBuffers.clear();
+  if (mMemoryBudget) {
+    mMemoryBudget->Release(vBufferBytes);
+  }
+}
+
+
+template<typename TDataType>
+const TDataType* bpDataBlockReadAhead<TDataType>::AcquireBlock()
+{
+  if (mNumberOfAcquiredBlocks >= mBlockNumbers.size()) {
+    throw std::runtime_error("No more data blocks to read");
+  }
+
+  bpSize vIndex = mNumberOfAcquiredBlocks++;
+  bpSize vSlot = GetSlot(vIndex);
+  TDataType* vBuffer = mBuffers[vSlot].get();
+
+  if (mThreads.empty()) {
+    ReadBlock(mReaders.front(), mBlockNumbers[vIndex], vBuffer);
+    return vBuffer;
+  }
+
+  // the synchronous read above is measured as read, only waiting for the threads counts as wait
+  bpStageMetrics::cScope vWait(bpStageMetrics::eStageWait, 0);
+  std::unique_lock<std::mutex> vLock(mMutex);
+  mBlockRead.wait(vLock, [this, vIndex, vSlot] { return mBufferBlockIndices[vSlot] == vIndex || mException; });
+  if (mBufferBlockIndices[vSlot] != vIndex) {
+    std::rethrow_exception(mException);
+  }
+  return vBuffer;
+}
+
+
+template<typename TDataType>
+void bpDataBlockReadAhead<TDataType>::ReleaseBlock()
+{
+  {
+    std::lock_guard<std::mutex> vLock(mMutex);
+    ++mNumberOfReleasedBlocks;
+  }
+  mBlockReleased.notify_all();
+}
+
+
+template<typename TDataType>
+void bpDataBlockReadAhead<TDataType>::Run(const tReaderImplPtr& aReader)
+{
+  try {
+    while (true) {
+      bpSize vIndex;
+      {
+        std::unique_lock<std::mutex> vLock(mMutex);
+        if (mStop || mException || mNumberOfClaimedBlocks >= mBlockNumbers.size()) {
+          return;
+        }
+        vIndex = mNumberOfClaimedBlocks++;
+        mBlockReleased.wait(vLock, [this, vIndex] { return mStop || vIndex < mNumberOfReleasedBlocks + mBuffers.size(); });
+        if (mStop) {
+          return;
+        }
+      }
+
+      bpSize vSlot = GetSlot(vIndex);
+      ReadBlock(aReader, mBlockNumbers[vIndex], mBuffers[vSlot].get());
+
+      {
+        std::lock_guard<std::mutex> vLock(mMutex);
+        mBufferBlockIndices[vSlot] = vIndex;
+      }
+      mBlockRead.notify_one();
+    }
+  }
+  catch (...) {
+    {
+      std::lock_guard<std::mutex> vLock(mMutex);
+      mException = std::current_exception();
+    }
+    mBlockRead.notify_one();
+  }
+}
+
+
+template<typename TDataType>
+void bpDataBlockReadAhead<TDataType>::ReadBlock(const tReaderImplPtr& aReader, bpSize aBlockNumber, TDataType* aBuffer) const
+{
+  aReader->GoToDataBlock(aBlockNumber);
+  auto vStart = bpStageMetrics::tClock::now();
+  try {
+    bpfTraceScope vTrace(bpTraceFile::GetRecorder(), "ReadDataBlock");
+    aReader->ReadDataBlock(aBuffer);
+  }
+  catch (bpException&) {
+    return;
+  }
+  bpStageMetrics::Add(bpStageMetrics::eStageRead, mBlockNumberOfVoxels * sizeof(TDataType), bpStageMetrics::tClock::now() - vStart);
+}
+
+
+template<typename TDataType>
+bpSize bpDataBlockReadAhead<TDataType>::GetSlot(bpSize aIndex) const
+{
+  return aIndex % mBuffers.size();
+}
+
+
+template class bpDataBlockReadAhead<bpUInt8>;
+template class bpDataBlockReadAhead<bpUInt16>;
+template class bpDataBlockReadAhead<bpUInt32>;
+template class bpDataBlockReadAhead<bpFloat>;
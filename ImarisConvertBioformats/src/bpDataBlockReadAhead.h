@@ -0,0 +1,90 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#ifndef __BP_DATA_BLOCK_READ_AHEAD__
+#define __BP_DATA_BLOCK_READ_AHEAD__
+
+
+#include "../meta/bpFileReaderImpl.h"
+#include "bpMemoryBudget.h"
+
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Reads a given sequence of data blocks from one or more file readers in
+ * background threads, keeping up to aReadAheadBlocks blocks ahead of the consumer.
+ *
+ * Each reader is driven by its own thread. The threads pick the next block
+ * to read from a shared counter, so a slow block does not stall the others.
+ * The blocks are returned by AcquireBlock() in the order of aBlockNumbers.
+ * The returned memory stays valid until the matching ReleaseBlock().
+ * With a single reader and aReadAheadBlocks == 0 the blocks are read
+ * synchronously in AcquireBlock().
+ * With a memory budget, the buffers are taken from it: the first one waits
+ * for memory if needed, the others are only allocated if memory is left.
+ *
+ * The readers must all open the same image (same data set, resolution level
+ * and block size) and must not be used by anyone else while this object is alive.
+ */
+template<typename TDataType>
+class bpDataBlockReadAhead
+{
+public:
+  using tReaderImplPtr = bpFileReaderImpl::tPtr;
+
+  bpDataBlockReadAhead(std::vector<tReaderImplPtr> aReaders, std::vector<bpSize> aBlockNumbers, bpSize aBlockNumberOfVoxels, bpSize aReadAheadBlocks, bpMemoryBudget* aMemoryBudget = nullptr);
+  ~bpDataBlockReadAhead();
+
+  const TDataType* AcquireBlock();
+  void ReleaseBlock();
+
+private:
+  void Run(const tReaderImplPtr& aReader);
+  void StopThreads();
+  void ReleaseBuffers();
+  void ReadBlock(const tReaderImplPtr& aReader, bpSize aBlockNumber, TDataType* aBuffer) const;
+  bpSize GetSlot(bpSize aIndex) const;
+
+  std::vector<tReaderImplPtr> mReaders;
+  std::vector<bpSize> mBlockNumbers;
+  bpSize mBlockNumberOfVoxels;
+  bpMemoryBudget* mMemoryBudget;
+  std::vector<std::unique_ptr<TDataType[]>> mBuffers;
+  std::vector<bpSize> mBufferBlockIndices; // index (into mBlockNumbers) of the block read into each buffer
+
+  bpSize mNumberOfClaimedBlocks = 0;
+  bpSize mNumberOfAcquiredBlocks = 0;
+  bpSize mNumberOfReleasedBlocks = 0;
+  bool mStop = false;
+  std::exception_ptr mException;
+
+  std::mutex mMutex;
+  std::condition_variable mBlockRead;
+  std::condition_variable mBlockReleased;
+  std::vector<std::thread> mThreads;
+};
+
+
+#endif // __BP_DATA_BLOCK_READ_AHEAD__
@@ -22,7 +22,10 @@
 #include "bpWriterCommonHeaders.h"
 #include "ImarisWriter/interface/bpImageConverter.h"
 #include "bpConverterProgress.h"
-#include "bpThroughputMeasurementsAggregator.h"
+#include "bpStageMetrics.h"
+#include "bpTraceFile.h"
+#include "bpDataBlockReadAhead.h"
+#include "bpConvertJournal.h"
 #include "bpConverterVersion.h"
 #include "../thumbnailFile/bpWriterFileThumbnail.h"
 #include "../thumbnailFile/bpThumbnailImageConverter.h"
@@ -89,11 +92,12 @@ class bpImageConvertNew::cImpl
 public:
   using tReaderImplPtr = bpFileReaderImpl::tPtr;
 
-  static void Convert(const tReaderPtr& aReader, const bpString& aDestinationFile, const cConvertOptions& aConvertOptions, const cOptions& aWriteOptions);
+  static std::vector<cThumbnailOutput> Convert(const tReaderPtr& aReader, const bpString& aDestinationFile, const cConvertOptions& aConvertOptions, const cOptions& aWriteOptions);
 
 private:
   template<typename TDataType>
-  static void ConvertT(const tReaderImplPtr& aReader, const bpString& aOutputFile, const cConvertOptions& aConvertOptions, cOptions aWriteOptions, const bpVector3Float& aForcedVoxelSize);
+  static std::vector<cThumbnailOutput> ConvertT(const tReaderImplPtr& aReader, const bpString& aOutputFile, const std::vector<cThumbnailOutput>& aThumbnails,
+                       const cConvertOptions& aConvertOptions, cOptions aWriteOptions, const bpVector3Float& aForcedVoxelSize);
   static tDimensionSequence5D GetDimensionSequence(const tReaderImplPtr& aReader);
   static tSize5D GetDataSize(const tReaderImplPtr& aReader);
   static tSize5D GetDataBlockSize(const tReaderImplPtr& aReader);
@@ -104,6 +108,12 @@ private:
   static void MapColor(const bpColor& aSourceColor, cColor& aTargetColor);
   static bpSharedPtr<bpThumbnail> ExtractImarisThumbnail(const tReaderPtr& aReader);
   static bpSize Div(bpSize aNum, bpSize aDiv);
+  static void IncrementBlockIndex(const tDimensionSequence5D& aDimensionSequence, const tSize5D& aBlocksPerDimension, tSize5D& aBlockIndex);
+  static void ApplyCropLimits(const tReaderPtr& aReader);
+  static tSize5D SelectResolutionLevel(const tReaderImplPtr& aReader, bpSize aMinSizeX, bpSize aMinSizeY, bpSize aMinSizeZ);
+  static tSize5D GetThumbnailSample(const tSize5D& aImageSize, bpSize aThumbnailSize);
+
+  static const bpSize mThumbnailSizeZ = 64;
 };
 
 
@@ -313,8 +323,91 @@ bpSize bpImageConvertNew::cImpl::Div(bpSize aNum, bpSize aDiv)
 }
 
 
+void bpImageConvertNew::cImpl::IncrementBlockIndex(const tDimensionSequence5D& aDimensionSequence, const tSize5D& aBlocksPerDimension, tSize5D& aBlockIndex)
+{
+  for (bpSize vDimIndex = 0; vDimIndex < 5; vDimIndex++) {
+    Dimension vDim = aDimensionSequence[vDimIndex];
+    bpSize& vBlockIndex = aBlockIndex[vDim];
+    ++vBlockIndex;
+    if (vBlockIndex == aBlocksPerDimension[vDim]) {
+      vBlockIndex = 0;
+    }
+    else {
+      break;
+    }
+  }
+}
+
+
+void bpImageConvertNew::cImpl::ApplyCropLimits(const tReaderPtr& aReader)
+{
+  const bpFileReader::tConfigPtr& vConfig = aReader->GetConfig();
+  if (!vConfig) {
+    return;
+  }
+
+  std::vector<bpSize> vMin = vConfig->GetCropLimitsMin();
+  std::vector<bpSize> vMax = vConfig->GetCropLimitsMax();
+  bool vIsCropped = false;
+  for (bpSize vIndex = 0; vIndex < 5; vIndex++) {
+    vIsCropped = vIsCropped || vMin[vIndex] != 0 || vMax[vIndex] != 0;
+  }
+  if (!vIsCropped) {
+    return;
+  }
+
+  if (!aReader->GetReaderImpl()->SetCropLimits(vMin, vMax)) {
+    throw std::runtime_error("The reader of \"" + aReader->GetReaderImpl()->GetFileName() + "\" can't crop the image");
+  }
+}
+
+
+tSize5D bpImageConvertNew::cImpl::SelectResolutionLevel(const tReaderImplPtr& aReader, bpSize aMinSizeX, bpSize aMinSizeY, bpSize aMinSizeZ)
+{
+  // use the smallest resolution level stored in the file that is still large enough
+  // (or not smaller than the full resolution in a dimension), instead of downsampling the full resolution
+  aReader->SetActiveResolutionLevel(0);
+  tSize5D vImageSize = GetDataSize(aReader);
+  tSize5D vSelectedSize = vImageSize;
+
+  bpSize vSizeR = aReader->GetNumberOfResolutions();
+  bpSize vSelectedLevel = 0;
+  for (bpSize vIndex = 1; vIndex < vSizeR; ++vIndex) {
+    aReader->SetActiveResolutionLevel(vIndex);
+    tSize5D vImageSizeR = GetDataSize(aReader);
+    bool vGoodX = vImageSizeR[X] >= vImageSize[X] || vImageSizeR[X] >= aMinSizeX;
+    bool vGoodY = vImageSizeR[Y] >= vImageSize[Y] || vImageSizeR[Y] >= aMinSizeY;
+    bool vGoodZ = vImageSizeR[Z] >= vImageSize[Z] || vImageSizeR[Z] >= aMinSizeZ;
+    if (!vGoodX || !vGoodY || !vGoodZ) {
+      break;
+    }
+    vSelectedSize = vImageSizeR;
+    vSelectedLevel = vIndex;
+  }
+
+  aReader->SetActiveResolutionLevel(vSelectedLevel);
+  return vSelectedSize;
+}
+
+
+tSize5D bpImageConvertNew::cImpl::GetThumbnailSample(const tSize5D& aImageSize, bpSize aThumbnailSize)
+{
+  // Limit resolution (set downsampling factors). If the image is larger than the
+  // desired size, the loaded image shouldn't be much larger after resampling. Later
+  // the loaded image will be down-sampled to the desired maximum limit. If the image
+  // is smaller than the desired size, to loaded image should keep its size after loading.
+  bpSize vResampleX = aImageSize[X] / aThumbnailSize > 1 ? aImageSize[X] / aThumbnailSize : 1;
+  bpSize vResampleY = aImageSize[Y] / aThumbnailSize > 1 ? aImageSize[Y] / aThumbnailSize : 1;
+  bpSize vResampleZ = aImageSize[Z] / mThumbnailSizeZ > 1 ? aImageSize[Z] / mThumbnailSizeZ : 1;
+  bpSize vResampleXY = vResampleX > vResampleY ? vResampleX : vResampleY;
+
+  return tSize5D(X, vResampleXY, Y, vResampleXY, Z, vResampleZ, C, 1, T, aImageSize[T]);
+}
+
+
 template<typename TDataType>
-void bpImageConvertNew::cImpl::ConvertT(const tReaderImplPtr& aReader, const bpString& aOutputFile, const cConvertOptions& aConvertOptions, cOptions aWriteOptions, const bpVector3Float& aForcedVoxelSize)
+std::vector<bpImageConvertNew::cThumbnailOutput> bpImageConvertNew::cImpl::ConvertT(const tReaderImplPtr& aReader, const bpString& aOutputFile, const std::vector<cThumbnailOutput>& aThumbnails,
+                                        const cConvertOptions& aConvertOptions, cOptions aWriteOptions, const bpVector3Float& aForcedVoxelSize)
 {
   bpSize vThumbnailSize = aWriteOptions.mThumbnailSizeXY;
 
@@ -326,75 +419,57 @@ void bpImageConvertNew::cImpl::ConvertT(const tReaderImplPtr& aReader, const bpS
   aWriteOptions.mFlipDimensionXYZ[1] = vImageExtent.mExtentMinY > vImageExtent.mExtentMaxY;
   aWriteOptions.mFlipDimensionXYZ[2] = vImageExtent.mExtentMinZ > vImageExtent.mExtentMaxZ;
 
-  tSize5D vSample(X, 1, Y, 1, Z, 1, C, 1, T, 1);
-  tSize5D vImageSize = GetDataSize(aReader);
-
-  if (aConvertOptions.mWriteMode == eWriteThumbnailOnly) {
-    // Limit resolution (set downsampling factors). If the image is larger than the
-    // desired size, the loaded image shouldn't be much larger after resampling. Later
-    // the loaded image will be down-sampled to the desired maximum limit. If the image
-    // is smaller than the desired size, to loaded image should keep its size after loading.
-    bpSize vDesiredSizeX = vThumbnailSize;
-    bpSize vDesiredSizeY = vThumbnailSize;
-    bpSize vDesiredSizeZ = 64;
-
-    bpSize vSizeR = aReader->GetNumberOfResolutions();
-    for (bpSize vIndex = 1; vIndex < vSizeR; ++vIndex) {
-      aReader->SetActiveResolutionLevel(vIndex);
-      tSize5D vImageSizeR = GetDataSize(aReader);
-      bool vGoodX = vImageSizeR[X] >= vImageSize[X] || vImageSizeR[X] >= vDesiredSizeX;
-      bool vGoodY = vImageSizeR[Z] >= vImageSize[Y] || vImageSizeR[Y] >= vDesiredSizeY;
-      bool vGoodZ = vImageSizeR[Z] >= vImageSize[Z] || vImageSizeR[Z] >= vDesiredSizeZ;
-      if (vGoodX && vGoodY && vGoodZ) {
-        vImageSize = vImageSizeR;
-      }
-      else {
-        aReader->SetActiveResolutionLevel(vIndex - 1);
-        break;
-      }
-    }
-
-    bpSize vResampleX = vImageSize[X] / vDesiredSizeX > 1 ? vImageSize[X] / vDesiredSizeX : 1;
-    bpSize vResampleY = vImageSize[Y] / vDesiredSizeY > 1 ? vImageSize[Y] / vDesiredSizeY : 1;
-    bpSize vResampleZ = vImageSize[Z] / vDesiredSizeZ > 1 ? vImageSize[Z] / vDesiredSizeZ : 1;
-    bpSize vResampleXY = vResampleX > vResampleY ? vResampleX : vResampleY;
-
-    vSample[X] = vResampleXY;
-    vSample[Y] = vResampleXY;
-    vSample[Z] = vResampleZ;
-    vSample[T] = vImageSize[T];
+  // the imaris file and the block callback need the full resolution, thumbnails alone can read a smaller level
+  tSize5D vImageSize;
+  if (aOutputFile.empty() && !aConvertOptions.mBlockCallback) {
+    vImageSize = SelectResolutionLevel(aReader, vThumbnailSize, vThumbnailSize, mThumbnailSizeZ);
+  }
+  else {
+    aReader->SetActiveResolutionLevel(0);
+    vImageSize = GetDataSize(aReader);
   }
 
   tDimensionSequence5D vDimensionSequence = GetDimensionSequence(aReader);
   tSize5D vBlockSize = GetDataBlockSize(aReader);
 
-  bpUniquePtr<bpImageConverterInterface<TDataType>> vImageConverter;
-  if (aConvertOptions.mWriteMode == eWriteHDF5) {
+  // all outputs are written from the same blocks, each block is read once
+  std::vector<bpUniquePtr<bpImageConverterInterface<TDataType>>> vImageConverters;
+  if (!aOutputFile.empty()) {
+    tSize5D vSample(X, 1, Y, 1, Z, 1, C, 1, T, 1);
     const bpString vApplicationName = IMARISCONVERT_APPLICATION_NAME_STR;
     const bpString vApplicationVersion = IMARISCONVERT_VERSION_MAJOR_STR "." IMARISCONVERT_VERSION_MINOR_STR "." IMARISCONVERT_VERSION_PATCH_STR IMARISCONVERT_VERSION_BUILD_STR;
-    bpConverterTypes::tProgressCallback vProgressCallback;
+    // the written bytes are counted also without progress output
+    bpSharedPtr<bpConverterProgress> vConverterProgress;
     if (aWriteOptions.mEnableLogProgress) {
-      auto vConverterProgress = std::make_shared<bpConverterProgress>(1, true);
-      auto vTotalBytesWritten = std::make_shared<bpUInt64>(0);
-      vProgressCallback = [vConverterProgress, vTotalBytesWritten](bpFloat aProgress, bpUInt64 aTotalBytesWritten) {
-        vConverterProgress->SetPosition(aProgress);
-        bpUInt64 vBytesWritten = aTotalBytesWritten - *vTotalBytesWritten;
-        bpThroughputMeasurementsAggregator::AddWriterMeasurement(vBytesWritten / (1024.0 * 1024));
-        *vTotalBytesWritten = aTotalBytesWritten;
-      };
+      vConverterProgress = std::make_shared<bpConverterProgress>(1, true);
     }
-    vImageConverter.reset(new bpImageConverter<TDataType>(vDataType, vImageSize, vSample, vDimensionSequence, vBlockSize, aOutputFile, aWriteOptions, vApplicationName, vApplicationVersion, vProgressCallback));
+    auto vTotalBytesWritten = std::make_shared<bpUInt64>(0);
+    bpConverterTypes::tProgressCallback vProgressCallback = [vConverterProgress, vTotalBytesWritten](bpFloat aProgress, bpUInt64 aTotalBytesWritten) {
+      if (vConverterProgress) {
+        vConverterProgress->SetPosition(aProgress);
+      }
+      bpStageMetrics::AddBytes(bpStageMetrics::eStageWrite, aTotalBytesWritten - *vTotalBytesWritten);
+      *vTotalBytesWritten = aTotalBytesWritten;
+    };
+    vImageConverters.emplace_back(new bpImageConverter<TDataType>(vDataType, vImageSize, vSample, vDimensionSequence, vBlockSize, aOutputFile, aWriteOptions, vApplicationName, vApplicationVersion, vProgressCallback));
   }
-  else if (aConvertOptions.mWriteMode == eWriteThumbnailOnly) {
-    vImageConverter.reset(new bpThumbnailImageConverter<TDataType>(vDataType, vImageSize, vSample, vDimensionSequence, vBlockSize, aOutputFile, aWriteOptions, aConvertOptions.mCompressThumbnail));
+
+  if (!aThumbnails.empty()) {
+    tSize5D vSample = GetThumbnailSample(vImageSize, vThumbnailSize);
+    cOptions vThumbnailOptions = aWriteOptions;
+    vThumbnailOptions.mEnableLogProgress = aWriteOptions.mEnableLogProgress && aOutputFile.empty();
+    for (const cThumbnailOutput& vThumbnail : aThumbnails) {
+      vImageConverters.emplace_back(new bpThumbnailImageConverter<TDataType>(vDataType, vImageSize, vSample, vDimensionSequence, vBlockSize, vThumbnail.mOutputFile, vThumbnailOptions, vThumbnail.mCompressThumbnail));
+    }
   }
 
+  // the first output fails the conversion, the thumbnails written along with it are only dropped
+  bpSize vFirstThumbnailOutput = aOutputFile.empty() ? 0 : 1;
+  std::vector<cThumbnailOutput> vFailedThumbnails;
+
   bpSize vNumberOfBlocks = aReader->GetNumberOfDataBlocks();
   bpSize vBufferSize = aReader->GetDataBlockNumberOfVoxels();
 
-  std::unique_ptr<TDataType[]> vBufferPtr(new TDataType[vBufferSize]);
-  TDataType* vBuffer = vBufferPtr.get();
-
   tSize5D vDataBlockIndex(X, 0, Y, 0, Z, 0, C, 0, T, 0);
   tSize5D vBlocksPerDimension(X, 0, Y, 0, Z, 0, C, 0, T, 0);
   bpConverterProgress vProgress(vNumberOfBlocks, false);
@@ -404,62 +479,186 @@ void bpImageConvertNew::cImpl::ConvertT(const tReaderImplPtr& aReader, const bpS
     vBlocksPerDimension[vDim] = Div(vImageSize[vDim], vBlockSize[vDim]);
   }
 
+  // collect the blocks needed by any output, so that they can be read ahead
+  std::vector<tSize5D> vBlockIndices;
+  std::vector<bpSize> vBlockNumbers;
   for (bpSize vIndex = 0; vIndex < vNumberOfBlocks; vIndex++) {
-    if (vImageConverter->NeedCopyBlock(vDataBlockIndex)) {
-      aReader->GoToDataBlock(vIndex);
-      bool vError = false;
-      try {
-        aReader->ReadDataBlock(vBuffer);
-      }
-      catch (bpException&) {
-        vError = true;
-      }
-      if (!vError) {
-        bpThroughputMeasurementsAggregator::AddReaderMeasurement(vBufferSize * sizeof(TDataType) / (1024.0 * 1024));
-      }
-      vImageConverter->CopyBlock(vBuffer, vDataBlockIndex);
+    bool vNeedBlock = static_cast<bool>(aConvertOptions.mBlockCallback);
+    for (const auto& vImageConverter : vImageConverters) {
+      vNeedBlock = vNeedBlock || vImageConverter->NeedCopyBlock(vDataBlockIndex);
     }
-    if (aWriteOptions.mEnableLogProgress) {
-      vProgress.Increment();
+    if (vNeedBlock) {
+      vBlockIndices.push_back(vDataBlockIndex);
+      vBlockNumbers.push_back(vIndex);
     }
+    IncrementBlockIndex(vDimensionSequence, vBlocksPerDimension, vDataBlockIndex);
+  }
+
+  std::vector<tReaderImplPtr> vReaders{ aReader };
+  for (const tReaderPtr& vAdditionalReader : aConvertOptions.mAdditionalReaders) {
+    tReaderImplPtr vReaderImpl = vAdditionalReader ? vAdditionalReader->GetReaderImpl() : tReaderImplPtr();
+    if (vReaderImpl) {
+      ApplyCropLimits(vAdditionalReader);
+      vReaderImpl->SetActiveResolutionLevel(aReader->GetActiveResolutionLevel());
+      vReaders.push_back(vReaderImpl);
+    }
+  }
 
-    for (bpSize vDimIndex = 0; vDimIndex < 5; vDimIndex++) {
+  // the imaris file is written again when resuming, the blocks of the journal are not read from the input
+  bpUniquePtr<bpConvertJournal> vJournal;
+  bpSize vNumberOfJournalBlocks = 0;
+  if (!aOutputFile.empty() && aConvertOptions.mCheckpointInterval > 0) {
+    std::ostringstream vJournalKey;
+    vJournalKey << aConvertOptions.mJournalKey << "|" << static_cast<bpInt32>(vDataType);
+    for (bpSize vDimIndex = 0; vDimIndex < 5; ++vDimIndex) {
       Dimension vDim = vDimensionSequence[vDimIndex];
-      bpSize& vBlockIndex = vDataBlockIndex[vDim];
-      ++vBlockIndex;
-      if (vBlockIndex == vBlocksPerDimension[vDim]) {
-        vBlockIndex = 0;
+      vJournalKey << "|" << static_cast<bpInt32>(vDim) << ":" << vImageSize[vDim] << "/" << vBlockSize[vDim];
+    }
+    vJournal.reset(new bpConvertJournal(aOutputFile, vJournalKey.str(), vBufferSize * sizeof(TDataType), aConvertOptions.mCheckpointInterval));
+    vNumberOfJournalBlocks = std::min(vJournal->Open(aConvertOptions.mResume), vBlockNumbers.size());
+  }
+  std::vector<bpSize> vReadBlockNumbers(vBlockNumbers.begin() + vNumberOfJournalBlocks, vBlockNumbers.end());
+  std::unique_ptr<TDataType[]> vJournalBuffer(vNumberOfJournalBlocks > 0 ? new TDataType[vBufferSize] : nullptr);
+
+  bpDataBlockReadAhead<TDataType> vReadAhead(vReaders, vReadBlockNumbers, vBufferSize, aConvertOptions.mReadAheadBlocks, aConvertOptions.mReadAheadMemory.get());
+
+  bpSize vNextBlock = 0;
+  for (bpSize vIndex = 0; vIndex < vNumberOfBlocks; vIndex++) {
+    if (vNextBlock < vBlockNumbers.size() && vBlockNumbers[vNextBlock] == vIndex) {
+      bool vFromJournal = vNextBlock < vNumberOfJournalBlocks;
+      const TDataType* vBuffer = nullptr;
+      if (vFromJournal) {
+        bpfTraceScope vTrace(bpTraceFile::GetRecorder(), "ReplayBlock");
+        vJournal->ReadBlock(vJournalBuffer.get());
+        vBuffer = vJournalBuffer.get();
       }
       else {
-        break;
+        vBuffer = vReadAhead.AcquireBlock();
+      }
+      const tSize5D& vBlockIndex = vBlockIndices[vNextBlock];
+      {
+        bpStageMetrics::cScope vCopy(bpStageMetrics::eStageCopy, vBufferSize * sizeof(TDataType));
+        bpfTraceScope vTrace(bpTraceFile::GetRecorder(), "CopyBlock");
+        for (bpSize vOutput = 0; vOutput < vImageConverters.size(); ++vOutput) {
+          auto& vImageConverter = vImageConverters[vOutput];
+          if (!vImageConverter || !vImageConverter->NeedCopyBlock(vBlockIndex)) {
+            continue;
+          }
+          try {
+            vImageConverter->CopyBlock(vBuffer, vBlockIndex);
+          }
+          catch (...) {
+            if (vOutput == 0) {
+              throw;
+            }
+            vFailedThumbnails.push_back(aThumbnails[vOutput - vFirstThumbnailOutput]);
+            vImageConverter.reset();
+          }
+        }
+      }
+      if (aConvertOptions.mBlockCallback) {
+        aConvertOptions.mBlockCallback(vIndex, vBuffer);
       }
+      if (!vFromJournal) {
+        if (vJournal) {
+          vJournal->AddBlock(vBuffer);
+        }
+        vReadAhead.ReleaseBlock();
+      }
+      ++vNextBlock;
+    }
+    if (aWriteOptions.mEnableLogProgress) {
+      vProgress.Increment();
     }
   }
 
+  // the metadata is read once and shared by all outputs
   tColorInfoVector vColorInfoPerChannel;
   tTimeInfoVector vTimeInfoPerTimePoint;
   tParameters vParameters;
   GetImageMetadata(aReader, vColorInfoPerChannel, vTimeInfoPerTimePoint, vParameters);
 
-  vImageConverter->Finish(vImageExtent, vParameters, vTimeInfoPerTimePoint, vColorInfoPerChannel, aReader->ShouldColorRangeBeAdjustedToMinMax());
+  bool vAutoAdjustColorRange = aReader->ShouldColorRangeBeAdjustedToMinMax();
+  for (bpSize vOutput = 0; vOutput < vImageConverters.size(); ++vOutput) {
+    auto& vImageConverter = vImageConverters[vOutput];
+    if (!vImageConverter) {
+      continue;
+    }
+    bpStageMetrics::cScope vFinish(bpStageMetrics::eStageFinish, 0);
+    bpfTraceScope vTrace(bpTraceFile::GetRecorder(), "Finish");
+    try {
+      vImageConverter->Finish(vImageExtent, vParameters, vTimeInfoPerTimePoint, vColorInfoPerChannel, vAutoAdjustColorRange);
+    }
+    catch (...) {
+      if (vOutput == 0) {
+        throw;
+      }
+      vFailedThumbnails.push_back(aThumbnails[vOutput - vFirstThumbnailOutput]);
+      vImageConverter.reset();
+    }
+  }
+
+  // the writers flush and close their files when destroyed
+  {
+    bpfTraceScope vTrace(bpTraceFile::GetRecorder(), "HDF5 flush");
+    vImageConverters.clear();
+  }
+
+  if (vJournal) {
+    vJournal->Remove();
+  }
+  return vFailedThumbnails;
 }
 
 
-void bpImageConvertNew::cImpl::Convert(const tReaderPtr& aReader, const bpString& aOutputFile, const cConvertOptions& aConvertOptions, const cOptions& aWriteOptions)
+std::vector<bpImageConvertNew::cThumbnailOutput> bpImageConvertNew::cImpl::Convert(const tReaderPtr& aReader, const bpString& aOutputFile, const cConvertOptions& aConvertOptions, const cOptions& aWriteOptions)
 {
-  if (aConvertOptions.mWriteMode == eWriteThumbnailOnly) {
+  bpString vOutputFile;
+  std::vector<cThumbnailOutput> vThumbnails;
+  if (aConvertOptions.mWriteMode == eWriteHDF5) {
+    vOutputFile = aOutputFile;
+  }
+  else if (aConvertOptions.mWriteMode == eWriteThumbnailOnly) {
+    cThumbnailOutput vThumbnail;
+    vThumbnail.mOutputFile = aOutputFile;
+    vThumbnail.mCompressThumbnail = aConvertOptions.mCompressThumbnail;
+    vThumbnails.push_back(vThumbnail);
+  }
+  vThumbnails.insert(vThumbnails.end(), aConvertOptions.mThumbnails.begin(), aConvertOptions.mThumbnails.end());
+
+  // as in ConvertT, only the first output fails the conversion
+  std::vector<cThumbnailOutput> vFailedThumbnails;
+  if (!vThumbnails.empty()) {
     bpSharedPtr<bpThumbnail> vThumbnail = ExtractImarisThumbnail(aReader);
     if (vThumbnail) {
-      bpWriterFileThumbnail vWriter(aOutputFile, aConvertOptions.mCompressThumbnail ? bpWriterFileThumbnail::tFormat::eJPEG : bpWriterFileThumbnail::tFormat::ePNG);
-      vWriter.WriteThumbnail(*vThumbnail);
-      return;
+      for (bpSize vIndex = 0; vIndex < vThumbnails.size(); ++vIndex) {
+        const cThumbnailOutput& vThumbnailOutput = vThumbnails[vIndex];
+        try {
+          bpWriterFileThumbnail vWriter(vThumbnailOutput.mOutputFile, vThumbnailOutput.mCompressThumbnail ? bpWriterFileThumbnail::tFormat::eJPEG : bpWriterFileThumbnail::tFormat::ePNG);
+          vWriter.WriteThumbnail(*vThumbnail);
+        }
+        catch (...) {
+          if (vIndex == 0 && vOutputFile.empty()) {
+            throw;
+          }
+          vFailedThumbnails.push_back(vThumbnailOutput);
+        }
+      }
+      vThumbnails.clear();
     }
   }
 
+  if (vOutputFile.empty() && vThumbnails.empty() && !aConvertOptions.mBlockCallback) {
+    return vFailedThumbnails;
+  }
+
   if (!aReader->GetReaderImpl()) {
     throw std::runtime_error("Invalid reader for conversion");
   }
 
+  // blocks outside the crop box are never read, the output has the size of the box
+  ApplyCropLimits(aReader);
+
   bpVector3Float vForcedVoxelSize;
   if (aReader->GetConfig()) {
     vForcedVoxelSize = aReader->GetConfig()->GetForcedVoxelSize();
@@ -467,26 +666,29 @@ void bpImageConvertNew::cImpl::Convert(const tReaderPtr& aReader, const bpString
 
   const auto& vReaderImpl = aReader->GetReaderImpl();
   auto vType = vReaderImpl->GetDataType();
+  std::vector<cThumbnailOutput> vFailedConvertThumbnails;
   switch (vType) {
   case bpConverterTypes::bpUInt8Type:
-    ConvertT<bpUInt8>(vReaderImpl, aOutputFile, aConvertOptions, aWriteOptions, vForcedVoxelSize);
+    vFailedConvertThumbnails = ConvertT<bpUInt8>(vReaderImpl, vOutputFile, vThumbnails, aConvertOptions, aWriteOptions, vForcedVoxelSize);
     break;
   case bpConverterTypes::bpUInt16Type:
-    ConvertT<bpUInt16>(vReaderImpl, aOutputFile, aConvertOptions, aWriteOptions, vForcedVoxelSize);
+    vFailedConvertThumbnails = ConvertT<bpUInt16>(vReaderImpl, vOutputFile, vThumbnails, aConvertOptions, aWriteOptions, vForcedVoxelSize);
     break;
   case bpConverterTypes::bpUInt32Type:
-    ConvertT<bpUInt32>(vReaderImpl, aOutputFile, aConvertOptions, aWriteOptions, vForcedVoxelSize);
+    vFailedConvertThumbnails = ConvertT<bpUInt32>(vReaderImpl, vOutputFile, vThumbnails, aConvertOptions, aWriteOptions, vForcedVoxelSize);
     break;
   case bpConverterTypes::bpFloatType:
-    ConvertT<bpFloat>(vReaderImpl, aOutputFile, aConvertOptions, aWriteOptions, vForcedVoxelSize);
+    vFailedConvertThumbnails = ConvertT<bpFloat>(vReaderImpl, vOutputFile, vThumbnails, aConvertOptions, aWriteOptions, vForcedVoxelSize);
     break;
   default:
     throw std::runtime_error("Invalid reader type");
     break;
   }
+  vFailedThumbnails.insert(vFailedThumbnails.end(), vFailedConvertThumbnails.begin(), vFailedConvertThumbnails.end());
+  return vFailedThumbnails;
 }
 
-void bpImageConvertNew::Convert(const tReaderPtr& aReader, const bpString& aOutputFile, const cConvertOptions& aConvertOptions, const cOptions& aWriteOptions)
+std::vector<bpImageConvertNew::cThumbnailOutput> bpImageConvertNew::Convert(const tReaderPtr& aReader, const bpString& aOutputFile, const cConvertOptions& aConvertOptions, const cOptions& aWriteOptions)
 {
-  cImpl::Convert(aReader, aOutputFile, aConvertOptions, aWriteOptions);
+  return cImpl::Convert(aReader, aOutputFile, aConvertOptions, aWriteOptions);
 }
@@ -22,6 +22,9 @@
 
 #include "ImarisWriter/interface/bpConverterTypes.h"
 #include "../meta/bpFileReader.h"
+#include "bpMemoryBudget.h"
+
+#include <functional>
 
 
 class bpImageConvertNew
@@ -35,13 +38,35 @@ public:
     eWriteThumbnailOnly
   };
 
+  // called with every data block of the image (in the reader's block numbering)
+  using tBlockCallback = std::function<void(bpSize aBlockNumber, const void* aDataBlock)>;
+
+  struct cThumbnailOutput
+  {
+    bpString mOutputFile;
+    bool mCompressThumbnail = false;
+  };
+
   struct cConvertOptions
   {
     tWriteMode mWriteMode = eWriteHDF5;
     bool mCompressThumbnail = false;
+    bpSize mReadAheadBlocks = 2;
+    bpSharedPtr<bpMemoryBudget> mReadAheadMemory; // shared with concurrent conversions, unlimited if not set
+    std::vector<tReaderPtr> mAdditionalReaders; // opened on the same image, used to read blocks in parallel
+    std::vector<cThumbnailOutput> mThumbnails; // written from the same blocks as the output file
+    tBlockCallback mBlockCallback; // if set, all blocks of the full resolution are read
+    bpFloat mCheckpointInterval = 0; // seconds between checkpoints of the journal next to the output file, no journal if 0
+    bool mResume = false; // continue from the journal of an interrupted conversion
+    bpString mJournalKey; // the journal is only resumed with the same key
   };
 
-  static void Convert(const tReaderPtr& aReader, const bpString& aOutputFile, const cConvertOptions& aConvertOptions, const bpConverterTypes::cOptions& aWriteOptions);
+  /**
+   * Throws if the output file (or the first thumbnail without output file) can not be written.
+   * The thumbnails of aConvertOptions.mThumbnails that failed are returned instead, they can
+   * be written separately.
+   */
+  static std::vector<cThumbnailOutput> Convert(const tReaderPtr& aReader, const bpString& aOutputFile, const cConvertOptions& aConvertOptions, const bpConverterTypes::cOptions& aWriteOptions);
 
 private:
   class cImpl;
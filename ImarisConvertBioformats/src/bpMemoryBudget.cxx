@@ -0,0 +1,81 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#include "bpMemoryBudget.h"
+
+
+bpMemoryBudget::bpMemoryBudget(bpUInt64 aLimit)
+  : mLimit(aLimit),
+    mAcquired(0)
+{
+}
+
+
+bpUInt64 bpMemoryBudget::GetJavaHeapShare(bpUInt64 aMemoryLimit)
+{
+  // Bio-Formats allocates whole planes, also for the blocks it returns
+  return aMemoryLimit / 10 * 4;
+}
+
+
+bpUInt64 bpMemoryBudget::GetReadAheadShare(bpUInt64 aMemoryLimit)
+{
+  return aMemoryLimit / 10 * 3;
+}
+
+
+bpUInt64 bpMemoryBudget::GetLimit() const
+{
+  return mLimit;
+}
+
+
+void bpMemoryBudget::Acquire(bpUInt64 aBytes)
+{
+  std::unique_lock<std::mutex> vLock(mMutex);
+  mReleased.wait(vLock, [this, aBytes] { return CanAcquire(aBytes); });
+  mAcquired += aBytes;
+}
+
+
+bool bpMemoryBudget::TryAcquire(bpUInt64 aBytes)
+{
+  std::lock_guard<std::mutex> vLock(mMutex);
+  if (!CanAcquire(aBytes)) {
+    return false;
+  }
+  mAcquired += aBytes;
+  return true;
+}
+
+
+void bpMemoryBudget::Release(bpUInt64 aBytes)
+{
+  {
+    std::lock_guard<std::mutex> vLock(mMutex);
+    mAcquired -= aBytes;
+  }
+  mReleased.notify_all();
+}
+
+
+bool bpMemoryBudget::CanAcquire(bpUInt64 aBytes) const
+{
+  return mAcquired == 0 || mAcquired + aBytes <= mLimit;
+}
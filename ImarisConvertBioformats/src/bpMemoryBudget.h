@@ -17,25 +17,49 @@
  ***************************************************************************/
 
 
-#ifndef __BP_THROUGHPUT_MEASUREMENTS_AGGREGATOR_H__
-#define __BP_THROUGHPUT_MEASUREMENTS_AGGREGATOR_H__
+#ifndef __BP_MEMORY_BUDGET__
+#define __BP_MEMORY_BUDGET__
 
-#include "bpThroughputMeasurements.h"
 
+#include "ImarisWriter/interface/bpConverterTypes.h"
 
-class bpThroughputMeasurementsAggregator
+#include <condition_variable>
+#include <mutex>
+
+
+/**
+ * Memory shared by concurrent conversions (e.g. the jobs of -mi).
+ *
+ * Acquire() blocks until enough memory is released by the others, so that
+ * the conversions are throttled instead of running out of memory. A request
+ * larger than the whole budget is granted once nothing else is held.
+ *
+ * A total memory limit is partitioned into the heap of the JVM, the read
+ * ahead buffers and the rest, which is left to the writer.
+ */
+class bpMemoryBudget
 {
 public:
-  static void AddReaderMeasurement(bpDouble aBlockSize);
-  static void AddWriterMeasurement(bpDouble aBlockSize);
+  explicit bpMemoryBudget(bpUInt64 aLimit);
+
+  static bpUInt64 GetJavaHeapShare(bpUInt64 aMemoryLimit);
+  static bpUInt64 GetReadAheadShare(bpUInt64 aMemoryLimit);
 
-  static void RestartReferenceTime();
+  bpUInt64 GetLimit() const;
 
-  static bpDouble GetThroughputInWindow(bpDouble aTimeWindow);
+  void Acquire(bpUInt64 aBytes);
+  bool TryAcquire(bpUInt64 aBytes);
+  void Release(bpUInt64 aBytes);
 
 private:
-  class cImpl;
+  bool CanAcquire(bpUInt64 aBytes) const;
+
+  bpUInt64 mLimit;
+  bpUInt64 mAcquired;
+
+  std::mutex mMutex;
+  std::condition_variable mReleased;
 };
 
 
-#endif // __BP_THROUGHPUT_MEASUREMENTS_AGGREGATOR_H__
+#endif // __BP_MEMORY_BUDGET__
@@ -0,0 +1,254 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#include "bpStageMetrics.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+class bpStageMetrics::cImpl
+{
+public:
+  // written by one thread only, read by the snapshots
+  class cCounters
+  {
+  public:
+    cCounters()
+    {
+      for (auto& vStage : mStages) {
+        vStage.mBytes = 0;
+        vStage.mBlocks = 0;
+        vStage.mMicroseconds = 0;
+        for (auto& vLatency : vStage.mLatencies) {
+          vLatency = 0;
+        }
+      }
+    }
+
+    class cStageCounters
+    {
+    public:
+      std::atomic<bpUInt64> mBytes;
+      std::atomic<bpUInt64> mBlocks;
+      std::atomic<bpUInt64> mMicroseconds;
+      std::array<std::atomic<bpUInt64>, mNumberOfLatencyBuckets> mLatencies;
+    };
+
+    std::array<cStageCounters, eNumberOfStages> mStages;
+  };
+
+  static cCounters& GetThreadCounters()
+  {
+    cThreadSlot& vSlot = mThreadSlot;
+    if (!vSlot.mCounters) {
+      vSlot.mCounters = Acquire();
+    }
+    return *vSlot.mCounters;
+  }
+
+  static void Add(tStage aStage, bpUInt64 aBytes, tClock::duration aLatency)
+  {
+    auto& vStage = GetThreadCounters().mStages[aStage];
+    vStage.mBytes.fetch_add(aBytes, std::memory_order_relaxed);
+    vStage.mBlocks.fetch_add(1, std::memory_order_relaxed);
+    vStage.mMicroseconds.fetch_add(std::chrono::duration_cast<std::chrono::microseconds>(aLatency).count(), std::memory_order_relaxed);
+    vStage.mLatencies[GetLatencyBucket(aLatency)].fetch_add(1, std::memory_order_relaxed);
+  }
+
+  static void AddBytes(tStage aStage, bpUInt64 aBytes)
+  {
+    GetThreadCounters().mStages[aStage].mBytes.fetch_add(aBytes, std::memory_order_relaxed);
+  }
+
+  static cSnapshot GetSnapshot()
+  {
+    cSnapshot vSnapshot;
+    vSnapshot.mTime = tClock::now();
+    std::lock_guard<std::mutex> vLock(mMutex);
+    for (const auto& vCounters : mAllCounters) {
+      for (bpSize vStage = 0; vStage < eNumberOfStages; ++vStage) {
+        const auto& vFrom = vCounters->mStages[vStage];
+        cStage& vTo = vSnapshot.mStages[vStage];
+        vTo.mBytes += vFrom.mBytes.load(std::memory_order_relaxed);
+        vTo.mBlocks += vFrom.mBlocks.load(std::memory_order_relaxed);
+        vTo.mMicroseconds += vFrom.mMicroseconds.load(std::memory_order_relaxed);
+        for (bpSize vBucket = 0; vBucket < mNumberOfLatencyBuckets; ++vBucket) {
+          vTo.mLatencies[vBucket] += vFrom.mLatencies[vBucket].load(std::memory_order_relaxed);
+        }
+      }
+    }
+    return vSnapshot;
+  }
+
+private:
+  // the counters of an ended thread are kept (they are part of the totals) and reused by the next thread
+  class cThreadSlot
+  {
+  public:
+    ~cThreadSlot()
+    {
+      if (mCounters) {
+        Release(mCounters);
+      }
+    }
+
+    cCounters* mCounters = nullptr;
+  };
+
+  static cCounters* Acquire()
+  {
+    std::lock_guard<std::mutex> vLock(mMutex);
+    if (!mFreeCounters.empty()) {
+      cCounters* vCounters = mFreeCounters.back();
+      mFreeCounters.pop_back();
+      return vCounters;
+    }
+    mAllCounters.emplace_back(new cCounters);
+    return mAllCounters.back().get();
+  }
+
+  static void Release(cCounters* aCounters)
+  {
+    std::lock_guard<std::mutex> vLock(mMutex);
+    mFreeCounters.push_back(aCounters);
+  }
+
+  static bpSize GetLatencyBucket(tClock::duration aLatency)
+  {
+    auto vMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(aLatency).count();
+    bpSize vBucket = 0;
+    while (vMicroseconds > 0 && vBucket + 1 < mNumberOfLatencyBuckets) {
+      vMicroseconds >>= 1;
+      ++vBucket;
+    }
+    return vBucket;
+  }
+
+  static std::mutex mMutex;
+  static std::vector<std::unique_ptr<cCounters>> mAllCounters;
+  static std::vector<cCounters*> mFreeCounters;
+  static thread_local cThreadSlot mThreadSlot;
+};
+
+
+std::mutex bpStageMetrics::cImpl::mMutex;
+std::vector<std::unique_ptr<bpStageMetrics::cImpl::cCounters>> bpStageMetrics::cImpl::mAllCounters;
+std::vector<bpStageMetrics::cImpl::cCounters*> bpStageMetrics::cImpl::mFreeCounters;
+thread_local bpStageMetrics::cImpl::cThreadSlot bpStageMetrics::cImpl::mThreadSlot;
+
+
+bpStageMetrics::cSnapshot bpStageMetrics::cSnapshot::operator-(const cSnapshot& aEarlier) const
+{
+  cSnapshot vDifference;
+  vDifference.mTime = mTime;
+  vDifference.mDuration = mTime - aEarlier.mTime;
+  for (bpSize vStage = 0; vStage < eNumberOfStages; ++vStage) {
+    const cStage& vLater = mStages[vStage];
+    const cStage& vEarlier = aEarlier.mStages[vStage];
+    cStage& vTo = vDifference.mStages[vStage];
+    vTo.mBytes = vLater.mBytes - vEarlier.mBytes;
+    vTo.mBlocks = vLater.mBlocks - vEarlier.mBlocks;
+    vTo.mMicroseconds = vLater.mMicroseconds - vEarlier.mMicroseconds;
+    for (bpSize vBucket = 0; vBucket < mNumberOfLatencyBuckets; ++vBucket) {
+      vTo.mLatencies[vBucket] = vLater.mLatencies[vBucket] - vEarlier.mLatencies[vBucket];
+    }
+  }
+  return vDifference;
+}
+
+
+bpDouble bpStageMetrics::cSnapshot::GetSeconds() const
+{
+  return std::chrono::duration<bpDouble>(mDuration).count();
+}
+
+
+bpDouble bpStageMetrics::cSnapshot::GetMegaBytesPerSecond(tStage aStage) const
+{
+  bpDouble vSeconds = GetSeconds();
+  return vSeconds > 0 ? mStages[aStage].mBytes / (1024.0 * 1024) / vSeconds : 0.0;
+}
+
+
+bpDouble bpStageMetrics::cSnapshot::GetBusyShare(tStage aStage) const
+{
+  bpDouble vSeconds = GetSeconds();
+  return vSeconds > 0 ? mStages[aStage].mMicroseconds / 1e6 / vSeconds : 0.0;
+}
+
+
+bpDouble bpStageMetrics::cSnapshot::GetLatencyPercentileMs(tStage aStage, bpDouble aPercentile) const
+{
+  const cStage& vStage = mStages[aStage];
+  if (vStage.mBlocks == 0) {
+    return 0.0;
+  }
+  bpUInt64 vRank = std::min(static_cast<bpUInt64>(vStage.mBlocks * aPercentile / 100.0), vStage.mBlocks - 1);
+  bpUInt64 vCount = 0;
+  for (bpSize vBucket = 0; vBucket < mNumberOfLatencyBuckets; ++vBucket) {
+    vCount += vStage.mLatencies[vBucket];
+    if (vCount > vRank) {
+      return static_cast<bpDouble>(bpUInt64(1) << vBucket) / 1000.0;
+    }
+  }
+  return static_cast<bpDouble>(bpUInt64(1) << (mNumberOfLatencyBuckets - 1)) / 1000.0;
+}
+
+
+bpStageMetrics::cScope::cScope(tStage aStage, bpUInt64 aBytes)
+  : mStage(aStage),
+    mBytes(aBytes),
+    mStart(tClock::now())
+{
+}
+
+
+bpStageMetrics::cScope::~cScope()
+{
+  Add(mStage, mBytes, tClock::now() - mStart);
+}
+
+
+void bpStageMetrics::Add(tStage aStage, bpUInt64 aBytes, tClock::duration aLatency)
+{
+  cImpl::Add(aStage, aBytes, aLatency);
+}
+
+
+void bpStageMetrics::AddBytes(tStage aStage, bpUInt64 aBytes)
+{
+  cImpl::AddBytes(aStage, aBytes);
+}
+
+
+bpStageMetrics::cSnapshot bpStageMetrics::GetSnapshot()
+{
+  return cImpl::GetSnapshot();
+}
+
+
+const char* bpStageMetrics::GetStageName(tStage aStage)
+{
+  static const char* vNames[eNumberOfStages] = { "read", "wait", "copy", "write", "finish" };
+  return vNames[aStage];
+}
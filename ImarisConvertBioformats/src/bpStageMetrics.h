@@ -0,0 +1,105 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#ifndef __BP_STAGE_METRICS_H__
+#define __BP_STAGE_METRICS_H__
+
+
+#include "ImarisWriter/interface/bpConverterTypes.h"
+
+#include <array>
+#include <chrono>
+
+
+/**
+ * Bytes, blocks and latencies of the stages of the conversions in this process.
+ *
+ * Each thread counts into its own counters, adding a measurement never locks.
+ * A snapshot sums the counters of all threads, the difference of two snapshots
+ * describes the time in between. Latencies are kept in a histogram of power of
+ * two microseconds, percentiles are the upper bound of their bucket.
+ */
+class bpStageMetrics
+{
+public:
+  enum tStage {
+    eStageRead,   // ReadDataBlock of the file reader (JNI read and normalization of the voxels)
+    eStageWait,   // wait of the writer for a block not read ahead yet
+    eStageCopy,   // copy of a block into the writers (waits if the compression is behind)
+    eStageWrite,  // bytes written into the file, reported by the writer
+    eStageFinish, // completion of an output (pyramid, metadata, flush of the file)
+    eNumberOfStages
+  };
+
+  using tClock = std::chrono::steady_clock;
+  static const bpSize mNumberOfLatencyBuckets = 32;
+
+  class cStage
+  {
+  public:
+    bpUInt64 mBytes = 0;
+    bpUInt64 mBlocks = 0;
+    bpUInt64 mMicroseconds = 0; // sum of the latencies
+    std::array<bpUInt64, mNumberOfLatencyBuckets> mLatencies{}; // number of blocks per bucket
+  };
+
+  class cSnapshot
+  {
+  public:
+    cSnapshot operator-(const cSnapshot& aEarlier) const;
+
+    bpDouble GetSeconds() const;
+    bpDouble GetMegaBytesPerSecond(tStage aStage) const;
+    bpDouble GetLatencyPercentileMs(tStage aStage, bpDouble aPercentile) const;
+    // time spent in the stage relative to the duration, above 1 if threads overlap in the stage
+    bpDouble GetBusyShare(tStage aStage) const;
+
+    tClock::time_point mTime;
+    tClock::duration mDuration = tClock::duration::zero(); // of a difference
+    std::array<cStage, eNumberOfStages> mStages;
+  };
+
+  // measures the latency of a stage while it is in scope
+  class cScope
+  {
+  public:
+    cScope(tStage aStage, bpUInt64 aBytes);
+    ~cScope();
+
+  private:
+    cScope(const cScope&) = delete;
+    cScope& operator=(const cScope&) = delete;
+
+    tStage mStage;
+    bpUInt64 mBytes;
+    tClock::time_point mStart;
+  };
+
+  static void Add(tStage aStage, bpUInt64 aBytes, tClock::duration aLatency);
+  static void AddBytes(tStage aStage, bpUInt64 aBytes);
+
+  static cSnapshot GetSnapshot();
+  static const char* GetStageName(tStage aStage);
+
+private:
+  class cImpl;
+};
+
+
+#endif // __BP_STAGE_METRICS_H__
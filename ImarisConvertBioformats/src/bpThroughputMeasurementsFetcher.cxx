@@ -18,51 +18,131 @@
 
 
 #include "bpThroughputMeasurementsFetcher.h"
-#include "bpThroughputMeasurementsAggregator.h"
+#include "bpStageMetrics.h"
+#include "../meta/bpUtils.h"
 
-#include <thread>
-#include <atomic>
+#include "fileiobase/utils/bpfSysInfo.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <fstream>
 #include <iostream>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 
 class bpThroughputMeasurementsFetcher::cImpl
 {
 public:
-  cImpl(bpUInt32 aRepeatTimeMs)
-    : mThread([this, aRepeatTimeMs] { Run(aRepeatTimeMs); })
+  cImpl(bpUInt32 aRepeatTimeMs, const bpString& aJsonFileName, const bpString& aInputFileName)
+    : mInputFileName(aInputFileName),
+      mStart(bpStageMetrics::GetSnapshot())
   {
-    bpThroughputMeasurementsAggregator::RestartReferenceTime();
+    if (!aJsonFileName.empty()) {
+      // appended, concurrent jobs write into the same file
+      mJson.open(aJsonFileName, std::ios::out | std::ios::app);
+    }
+    if (aRepeatTimeMs > 0) {
+      mThread = std::thread([this, aRepeatTimeMs] { Run(aRepeatTimeMs); });
+    }
   }
 
   ~cImpl()
   {
-    mStop = true;
-    mThread.join();
+    {
+      std::lock_guard<std::mutex> vLock(mMutex);
+      mStop = true;
+    }
+    mStopped.notify_all();
+    if (mThread.joinable()) {
+      mThread.join();
+    }
+
+    // the totals of the whole conversion
+    WriteJson(bpStageMetrics::GetSnapshot() - mStart, true);
   }
 
 private:
   void Run(bpUInt32 aRepeatTimeMs)
   {
-    while (aRepeatTimeMs > 0 && !mStop) {
-      for (bpSize vStopCheckIdx = 0; vStopCheckIdx < 10; ++vStopCheckIdx) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(aRepeatTimeMs / 10));
-        if (mStop) {
-          break;
-        }
+    bpStageMetrics::cSnapshot vPrevious = mStart;
+    std::unique_lock<std::mutex> vLock(mMutex);
+    while (!mStopped.wait_for(vLock, std::chrono::milliseconds(aRepeatTimeMs), [this] { return mStop; })) {
+      bpStageMetrics::cSnapshot vCurrent = bpStageMetrics::GetSnapshot();
+      bpStageMetrics::cSnapshot vInterval = vCurrent - vPrevious;
+      vPrevious = vCurrent;
+
+      WriteText(vInterval);
+      WriteJson(vInterval, false);
+    }
+  }
+
+  void WriteText(const bpStageMetrics::cSnapshot& aInterval) const
+  {
+    // the first line is what callers have always parsed: the faster of reading and writing in MB/s
+    std::ostringstream vText;
+    vText << "Throughput: " << std::max(aInterval.GetMegaBytesPerSecond(bpStageMetrics::eStageRead), aInterval.GetMegaBytesPerSecond(bpStageMetrics::eStageWrite)) << std::endl;
+    for (bpSize vIndex = 0; vIndex < bpStageMetrics::eNumberOfStages; ++vIndex) {
+      auto vStage = static_cast<bpStageMetrics::tStage>(vIndex);
+      const bpStageMetrics::cStage& vCounters = aInterval.mStages[vStage];
+      if (vCounters.mBlocks == 0 && vCounters.mBytes == 0) {
+        continue;
+      }
+      vText << "  " << bpStageMetrics::GetStageName(vStage) << ": " << aInterval.GetMegaBytesPerSecond(vStage) << " MB/s";
+      if (vCounters.mBlocks > 0) {
+        vText << ", " << vCounters.mBlocks << " blocks, latency p50 " << aInterval.GetLatencyPercentileMs(vStage, 50)
+              << " ms, p90 " << aInterval.GetLatencyPercentileMs(vStage, 90) << " ms, p99 " << aInterval.GetLatencyPercentileMs(vStage, 99) << " ms";
       }
-      bpDouble vData = bpThroughputMeasurementsAggregator::GetThroughputInWindow(2);
-      std::cout << "Throughput: " << vData << std::endl;
+      vText << std::endl;
+    }
+    std::cout << vText.str() << std::flush;
+  }
+
+  void WriteJson(const bpStageMetrics::cSnapshot& aInterval, bool aFinal)
+  {
+    if (!mJson.is_open()) {
+      return;
+    }
+    std::ostringstream vLine;
+    vLine << "{\"input\":" << bpToJsonString(mInputFileName)
+          << ",\"final\":" << (aFinal ? "true" : "false")
+          << ",\"seconds\":" << aInterval.GetSeconds()
+          << ",\"stages\":{";
+    for (bpSize vIndex = 0; vIndex < bpStageMetrics::eNumberOfStages; ++vIndex) {
+      auto vStage = static_cast<bpStageMetrics::tStage>(vIndex);
+      const bpStageMetrics::cStage& vCounters = aInterval.mStages[vStage];
+      vLine << (vIndex > 0 ? "," : "") << "\"" << bpStageMetrics::GetStageName(vStage) << "\":{"
+            << "\"bytes\":" << vCounters.mBytes
+            << ",\"blocks\":" << vCounters.mBlocks
+            << ",\"mbps\":" << aInterval.GetMegaBytesPerSecond(vStage)
+            << ",\"busy\":" << aInterval.GetBusyShare(vStage)
+            << ",\"p50ms\":" << aInterval.GetLatencyPercentileMs(vStage, 50)
+            << ",\"p90ms\":" << aInterval.GetLatencyPercentileMs(vStage, 90)
+            << ",\"p99ms\":" << aInterval.GetLatencyPercentileMs(vStage, 99) << "}";
     }
+    vLine << "}";
+    if (aFinal) {
+      vLine << ",\"peakmb\":" << bpfSysInfo::GetPeakMemoryUsage() / (1024.0 * 1024);
+    }
+    vLine << "}\n";
+    mJson << vLine.str() << std::flush;
   }
 
-  std::atomic_bool mStop {false};
+  bpString mInputFileName;
+  bpStageMetrics::cSnapshot mStart;
+  std::ofstream mJson;
+
+  bool mStop = false;
+  std::mutex mMutex;
+  std::condition_variable mStopped;
   std::thread mThread;
 };
 
 
-void bpThroughputMeasurementsFetcher::Start(bpUInt32 aRepeatTimeMs)
+void bpThroughputMeasurementsFetcher::Start(bpUInt32 aRepeatTimeMs, const bpString& aJsonFileName, const bpString& aInputFileName)
 {
-  mImpl = std::make_shared<cImpl>(aRepeatTimeMs);
+  mImpl = std::make_shared<cImpl>(aRepeatTimeMs, aJsonFileName, aInputFileName);
 }
 
 
@@ -24,10 +24,11 @@
 #include "ImarisWriter/interface/bpConverterTypes.h"
 
 
+// prints the stage metrics every aRepeatTimeMs, and appends them as JSON lines to aJsonFileName (if not empty)
 class bpThroughputMeasurementsFetcher
 {
 public:
-  void Start(bpUInt32 aRepeatTimeMs);
+  void Start(bpUInt32 aRepeatTimeMs, const bpString& aJsonFileName = "", const bpString& aInputFileName = "");
   void Stop();
 
 private:
@@ -0,0 +1,122 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#include "bpTraceFile.h"
+#include "../meta/bpUtils.h"
+#include "fileiobase/utils/bpfSysInfo.h"
+
+#include <stdexcept>
+
+
+bpSharedPtr<bpfTraceRecorder> bpTraceFile::mRecorder;
+
+// events kept in memory before they are appended to the file
+static const bpSize mEventsPerWrite = 4096;
+
+
+bpTraceFile::bpTraceFile(const bpString& aFileName)
+  : mFileName(aFileName),
+    mStart(tClock::now()),
+    mProcessId(bpToString(bpfSysInfo::GetProcessId())),
+    mFileOpened(false),
+    mNumberOfWrittenEvents(0),
+    mWriteFailed(false)
+{
+  mEvents.reserve(mEventsPerWrite);
+}
+
+
+void bpTraceFile::Begin(const char* aName)
+{
+  Add(aName, 'B');
+}
+
+
+void bpTraceFile::End(const char* aName)
+{
+  Add(aName, 'E');
+}
+
+
+void bpTraceFile::Add(const char* aName, char aPhase)
+{
+  tClock::duration vTime = tClock::now() - mStart;
+  std::lock_guard<std::mutex> vLock(mMutex);
+  auto vThread = mThreads.emplace(std::this_thread::get_id(), mThreads.size()).first->second;
+  mEvents.push_back({ aName, aPhase, vTime, vThread });
+  if (mEvents.size() >= mEventsPerWrite) {
+    WriteEvents();
+  }
+}
+
+
+void bpTraceFile::WriteEvents()
+{
+  // called with mMutex locked, the recorder must not throw into the traced code
+  if (!mFileOpened) {
+    mFileOpened = true;
+    mFile.open(mFileName);
+    mFile << "[";
+  }
+  mWriteFailed = mWriteFailed || !mFile;
+  if (mWriteFailed) {
+    mEvents.clear();
+    return;
+  }
+
+  for (const cEvent& vEvent : mEvents) {
+    auto vMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(vEvent.mTime).count();
+    mFile << (mNumberOfWrittenEvents > 0 ? ",\n" : "\n")
+          << "{\"name\":" << bpToJsonString(vEvent.mName)
+          << ",\"ph\":\"" << vEvent.mPhase
+          << "\",\"ts\":" << vMicroseconds
+          << ",\"pid\":" << mProcessId
+          << ",\"tid\":" << vEvent.mThread << "}";
+    ++mNumberOfWrittenEvents;
+  }
+  mFile.flush();
+  mEvents.clear();
+}
+
+
+void bpTraceFile::Write()
+{
+  std::lock_guard<std::mutex> vLock(mMutex);
+  WriteEvents();
+  if (!mWriteFailed) {
+    mFile << "\n]\n";
+    mFile.close();
+    mWriteFailed = !mFile;
+  }
+  if (mWriteFailed) {
+    throw std::runtime_error("Unable to write the trace into \"" + mFileName + "\"");
+  }
+}
+
+
+bpfTraceRecorder* bpTraceFile::GetRecorder()
+{
+  return mRecorder.get();
+}
+
+
+void bpTraceFile::SetRecorder(const bpSharedPtr<bpfTraceRecorder>& aRecorder)
+{
+  mRecorder = aRecorder;
+}
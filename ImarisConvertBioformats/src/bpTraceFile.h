@@ -0,0 +1,87 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#ifndef __BP_TRACE_FILE__
+#define __BP_TRACE_FILE__
+
+
+#include "ImarisWriter/interface/bpConverterTypes.h"
+#include "fileiobase/utils/bpfTraceRecorder.h"
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+ * Collects the begin and end events of all threads and writes them in the
+ * Chrome trace event format (chrome://tracing, https://ui.perfetto.dev).
+ * The events are appended to the file in batches, the array format stays
+ * readable without the closing bracket if the process is killed.
+ */
+class bpTraceFile : public bpfTraceRecorder
+{
+public:
+  explicit bpTraceFile(const bpString& aFileName);
+
+  void Begin(const char* aName) override;
+  void End(const char* aName) override;
+
+  // writes the remaining events and closes the array, throws if the file could not be written
+  void Write();
+
+  // recorder of the stages of the converter, null if not tracing
+  static bpfTraceRecorder* GetRecorder();
+  static void SetRecorder(const bpSharedPtr<bpfTraceRecorder>& aRecorder);
+
+private:
+  using tClock = std::chrono::steady_clock;
+
+  class cEvent
+  {
+  public:
+    const char* mName;
+    char mPhase;
+    tClock::duration mTime;
+    bpSize mThread;
+  };
+
+  void Add(const char* aName, char aPhase);
+  void WriteEvents();
+
+  bpString mFileName;
+  tClock::time_point mStart;
+  bpString mProcessId;
+
+  std::mutex mMutex;
+  std::vector<cEvent> mEvents;
+  std::map<std::thread::id, bpSize> mThreads;
+  std::ofstream mFile;
+  bool mFileOpened;
+  bpSize mNumberOfWrittenEvents;
+  bool mWriteFailed;
+
+  static bpSharedPtr<bpfTraceRecorder> mRecorder;
+};
+
+
+#endif // __BP_TRACE_FILE__
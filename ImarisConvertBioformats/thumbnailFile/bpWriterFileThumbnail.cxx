@@ -20,6 +20,7 @@
 #include "bpWriterFileThumbnail.h"
 
 #include "../meta/bpUtils.h"
+#include "../src/bpTraceFile.h"
 
 
 #include <FreeImage.h>
@@ -39,6 +40,8 @@ bpWriterFileThumbnail::~bpWriterFileThumbnail()
 
 void bpWriterFileThumbnail::WriteThumbnail(const bpThumbnail& aThumbnail)
 {
+  bpfTraceScope vTrace(bpTraceFile::GetRecorder(), "thumbnail encode");
+
   bpSize vSizeX = aThumbnail.GetSizeX();
   bpSize vSizeY = aThumbnail.GetSizeY();
 
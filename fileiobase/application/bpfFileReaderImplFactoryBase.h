@@ -22,6 +22,8 @@
 
 
 #include "fileiobase/application/bpfFileReaderImplInterface.h"
+#include "fileiobase/types/bpfSmartPtr.h"
+#include "fileiobase/utils/bpfTraceRecorder.h"
 
 
 class bpfFileReaderImplFactoryBase
@@ -29,6 +31,13 @@ class bpfFileReaderImplFactoryBase
 public:
   using Iterator = std::list<bpfString>::iterator;
 
+  // how much metadata the readers collect when opening a file, less is faster for big files
+  enum tMetadataLevel {
+    eMetadataLevelMinimum,
+    eMetadataLevelNoOverlays,
+    eMetadataLevelAll
+  };
+
   virtual ~bpfFileReaderImplFactoryBase() {}
 
   virtual bpfFileReaderImplInterface* CreateFileReader(const bpfString& aFileName) = 0;
@@ -40,6 +49,22 @@ public:
   virtual bpfString GetFileFormat(const bpfString& aFileName) = 0;
   virtual void AddPluginsFormats(const bpfString& aPluginsPath) = 0;
   virtual bpfString GetVersion() const = 0;
+
+  // true if CreateFileReader ignores aFormatName because the readers find the format of the file themselves
+  virtual bool DetectsFileFormat() const { return false; }
+
+  // apply to the readers created afterwards, factories without such options ignore them
+  virtual void SetMetadataLevel(tMetadataLevel aMetadataLevel) {}
+  // readers taking at least aMinimumMilliseconds to open keep their initialized state in aDirectory (empty: no cache)
+  virtual void SetReaderStateCache(const bpfString& aDirectory, bpfSize aMinimumMilliseconds) {}
+
+  // options of the virtual machine hosting the readers, only effective before the first reader or format query
+  virtual void AddVirtualMachineOptions(const std::vector<bpfString>& aOptions) {}
+  // class data archive shared by the runs, it is created by the first run if it does not exist
+  virtual void SetVirtualMachineClassArchive(const bpfString& aArchiveFile) {}
+
+  // receives the stages of the virtual machine and of the readers created afterwards (null: no trace)
+  virtual void SetTraceRecorder(const bpfSharedPtr<bpfTraceRecorder>& aRecorder) {}
 };
 
 
@@ -0,0 +1,108 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#include "fileiobase/application/bpfFileReaderSyntheticImplFactory.h"
+
+#include "fileiobase/readers/bpfFileReaderSynthetic.h"
+#include "fileiobase/readers/bpfFileReaderImplToImplInterface.h"
+#include "fileiobase/utils/bpfFileTools.h"
+
+
+bpfFileReaderSyntheticImplFactory::bpfFileReaderSyntheticImplFactory()
+  : mFormats({ bpfFileReaderSynthetic::GetDescription() })
+{
+}
+
+
+bpfFileReaderSyntheticImplFactory::~bpfFileReaderSyntheticImplFactory()
+{
+}
+
+
+bpfFileReaderImplInterface* bpfFileReaderSyntheticImplFactory::CreateFileReader(const bpfString& aFileName)
+{
+  return CreateFileReader(aFileName, GetFileFormat(aFileName));
+}
+
+
+bpfFileReaderImplInterface* bpfFileReaderSyntheticImplFactory::CreateFileReader(const bpfString& aFileName, const bpfString& aFormatName)
+{
+  if (aFormatName != bpfFileReaderSynthetic::GetDescription()) {
+    return nullptr;
+  }
+
+  bpfFileReaderImpl* vReaderImpl = nullptr;
+  try {
+    vReaderImpl = new bpfFileReaderSynthetic(aFileName);
+  }
+  catch (...) {
+    return nullptr;
+  }
+  return new bpfFileReaderImplToImplInterface(vReaderImpl);
+}
+
+
+bpfFileReaderSyntheticImplFactory::Iterator bpfFileReaderSyntheticImplFactory::FormatBegin()
+{
+  return mFormats.begin();
+}
+
+
+bpfFileReaderSyntheticImplFactory::Iterator bpfFileReaderSyntheticImplFactory::FormatEnd()
+{
+  return mFormats.end();
+}
+
+
+bpfString bpfFileReaderSyntheticImplFactory::GetFormatDescription(const bpfString& aFormat) const
+{
+  if (aFormat != bpfFileReaderSynthetic::GetDescription()) {
+    return "";
+  }
+  return "Synthetic image (generated, no file)";
+}
+
+
+std::vector<bpfString> bpfFileReaderSyntheticImplFactory::GetFormatExtensions(const bpfString& aFormat) const
+{
+  if (aFormat != bpfFileReaderSynthetic::GetDescription()) {
+    return {};
+  }
+  return { bpfToUpper(bpfFileReaderSynthetic::GetExtension()) };
+}
+
+
+bpfString bpfFileReaderSyntheticImplFactory::GetFileFormat(const bpfString& aFileName)
+{
+  if (bpfToLower(bpfFileTools::GetExt(aFileName)) != bpfFileReaderSynthetic::GetExtension()) {
+    return "";
+  }
+  return bpfFileReaderSynthetic::GetDescription();
+}
+
+
+void bpfFileReaderSyntheticImplFactory::AddPluginsFormats(const bpfString& aPluginsPath)
+{
+}
+
+
+bpfString bpfFileReaderSyntheticImplFactory::GetVersion() const
+{
+  return "Synthetic Reader";
+}
@@ -0,0 +1,49 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#ifndef __BPF_FILE_READER_SYNTHETIC_IMPL_FACTORY__
+#define __BPF_FILE_READER_SYNTHETIC_IMPL_FACTORY__
+
+#include "fileiobase/application/bpfFileReaderImplFactoryBase.h"
+
+
+// creates the readers of generated images (bpfFileReaderSynthetic), named *.synthetic
+class bpfFileReaderSyntheticImplFactory : public bpfFileReaderImplFactoryBase
+{
+public:
+  bpfFileReaderSyntheticImplFactory();
+  virtual ~bpfFileReaderSyntheticImplFactory();
+
+  virtual bpfFileReaderImplInterface* CreateFileReader(const bpfString& aFileName) override;
+  virtual bpfFileReaderImplInterface* CreateFileReader(const bpfString& aFileName, const bpfString& aFormatName) override;
+  virtual Iterator FormatBegin() override;
+  virtual Iterator FormatEnd() override;
+  virtual bpfString GetFormatDescription(const bpfString& aFormat) const override;
+  virtual std::vector<bpfString> GetFormatExtensions(const bpfString& aFormat) const override;
+  virtual bpfString GetFileFormat(const bpfString& aFileName) override;
+  virtual void AddPluginsFormats(const bpfString& aPluginsPath) override;
+
+  virtual bpfString GetVersion() const override;
+
+private:
+  std::list<bpfString> mFormats;
+};
+
+
+#endif
@@ -266,6 +266,12 @@ bool bpfFileReaderImpl::SetDataBlockSize(bpfSize aDimension0, bpfSize aDimension
   return false;
 }
 
+bool bpfFileReaderImpl::SetCropLimits(const std::vector<bpfSize>& aMin, const std::vector<bpfSize>& aMax)
+{
+  // per default the reader cannot crop
+  return false;
+}
+
 bpfFileReaderImpl::ImageIndex bpfFileReaderImpl::GetDataBlockSize()
 {
   return ImageIndex(GetDimensionSequence(), GetDataBlockSizeV());
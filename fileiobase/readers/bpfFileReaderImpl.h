@@ -208,6 +208,20 @@ public:
    */
   virtual bool SetDataBlockSize(bpfSize aDimension0, bpfSize aDimension1, bpfSize aDimension2, bpfSize aDimension3, bpfSize aDimension4, bpfSize aResolutionLevel);
 
+  /**
+   * Restrict the image to the box [aMin, aMax) given in XYZCT order and in
+   * voxels of the full resolution level. A max of 0 stands for the full size.
+   * Sizes, blocks and extents then describe the cropped image and blocks
+   * outside the box are never read. If the filereader cannot crop, false is
+   * returned and nothing changes.
+   *
+   * @param aMin
+   * @param aMax
+   *
+   * @return bool true if success
+   */
+  virtual bool SetCropLimits(const std::vector<bpfSize>& aMin, const std::vector<bpfSize>& aMax);
+
   /**
    * Size of datablock as vector in data coordinates
    */
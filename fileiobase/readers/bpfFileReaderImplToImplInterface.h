@@ -279,6 +279,22 @@ public:
     return mFileReaderImpl->SetDataBlockSize(aDimension0,aDimension1,aDimension2,aDimension3,aDimension4,aResolutionLevel);
   }
 
+  /**
+   * Restrict the image to the box [aMin, aMax) given in XYZCT order and in
+   * voxels of the full resolution level. A max of 0 stands for the full size.
+   * Sizes, blocks and extents then describe the cropped image and blocks
+   * outside the box are never read. If the filereader cannot crop, false is
+   * returned and nothing changes.
+   *
+   * @param aMin
+   * @param aMax
+   *
+   * @return bool true if success
+   */
+  virtual bool SetCropLimits(const std::vector<bpfSize>& aMin, const std::vector<bpfSize>& aMax) override {
+    return mFileReaderImpl->SetCropLimits(aMin, aMax);
+  }
+
 
 
   virtual ImageIndex GetDataBlockSize() override {
@@ -0,0 +1,357 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#include "fileiobase/readers/bpfFileReaderSynthetic.h"
+
+#include "fileiobase/exceptions/bpfFileFormatException.h"
+#include "fileiobase/types/bpfParameterSection.h"
+#include "fileiobase/utils/bpfFileTools.h"
+
+#include <algorithm>
+
+
+bpfFileReaderSynthetic::bpfFileReaderSynthetic(const bpfString& aFileName)
+  : bpfFileReaderImpl(aFileName),
+    mDataType(bpfUInt8Type),
+    mDimensionSequence({ X, Y, Z, C, T }),
+    mInterleaved(false),
+    mSize({ 512, 512, 1, 1, 1 }),
+    mBlockNumber(0)
+{
+  ParseFileName(aFileName);
+}
+
+
+bpfFileReaderSynthetic::~bpfFileReaderSynthetic()
+{
+}
+
+
+bpfString bpfFileReaderSynthetic::GetDescription()
+{
+  return "Synthetic";
+}
+
+
+bpfString bpfFileReaderSynthetic::GetExtension()
+{
+  return "synthetic";
+}
+
+
+void bpfFileReaderSynthetic::ParseFileName(const bpfString& aFileName)
+{
+  std::vector<bpfString> vTokens = bpfSplit(bpfFileTools::GetFile(aFileName), "&");
+  if (vTokens.empty()) {
+    throw bpfFileFormatException("Invalid synthetic image name: " + aFileName);
+  }
+  mName = vTokens.front();
+
+  static const bpfString vSizeKeys[5] = { "sizeX", "sizeY", "sizeZ", "sizeC", "sizeT" };
+  static const bpfString vBlockKeys[5] = { "blockX", "blockY", "blockZ", "blockC", "blockT" };
+  std::vector<bpfSize> vBlockSize(5, 0);
+  bpfString vDimensionOrder = "XYZCT";
+
+  for (bpfSize vIndex = 1; vIndex < vTokens.size(); ++vIndex) {
+    bpfSize vSeparator = vTokens[vIndex].find('=');
+    if (vSeparator == bpfString::npos) {
+      throw bpfFileFormatException("Invalid synthetic image option: " + vTokens[vIndex]);
+    }
+    bpfString vKey = vTokens[vIndex].substr(0, vSeparator);
+    bpfString vValue = vTokens[vIndex].substr(vSeparator + 1);
+
+    auto vSizeKey = std::find(vSizeKeys, vSizeKeys + 5, vKey);
+    auto vBlockKey = std::find(vBlockKeys, vBlockKeys + 5, vKey);
+    if (vSizeKey != vSizeKeys + 5 || vBlockKey != vBlockKeys + 5) {
+      bpfSize vSize = 0;
+      bpfFromString(vValue, vSize);
+      if (vSize == 0) {
+        throw bpfFileFormatException("Invalid synthetic image size: " + vTokens[vIndex]);
+      }
+      if (vSizeKey != vSizeKeys + 5) {
+        mSize[vSizeKey - vSizeKeys] = vSize;
+      }
+      else {
+        vBlockSize[vBlockKey - vBlockKeys] = vSize;
+      }
+    }
+    else if (vKey == "pixelType") {
+      if (vValue == "uint8") {
+        mDataType = bpfUInt8Type;
+      }
+      else if (vValue == "uint16") {
+        mDataType = bpfUInt16Type;
+      }
+      else if (vValue == "uint32") {
+        mDataType = bpfUInt32Type;
+      }
+      else if (vValue == "float") {
+        mDataType = bpfFloatType;
+      }
+      else {
+        throw bpfFileFormatException("Invalid synthetic pixel type: " + vValue);
+      }
+    }
+    else if (vKey == "dimOrder") {
+      vDimensionOrder = bpfToUpper(vValue);
+    }
+    else if (vKey == "interleaved") {
+      mInterleaved = vValue == "true" || vValue == "1";
+    }
+    else {
+      throw bpfFileFormatException("Unknown synthetic image option: " + vKey);
+    }
+  }
+
+  SetDimensionOrder(vDimensionOrder);
+
+  // by default a block is one plane, like the planes of Bio-Formats
+  mBlockSize = { mSize[X], mSize[Y], 1, mInterleaved ? mSize[C] : 1, 1 };
+  for (bpfSize vDim = 0; vDim < 5; ++vDim) {
+    if (vBlockSize[vDim] > 0) {
+      mBlockSize[vDim] = std::min(vBlockSize[vDim], mSize[vDim]);
+    }
+  }
+}
+
+
+void bpfFileReaderSynthetic::SetDimensionOrder(const bpfString& aDimensionOrder)
+{
+  static const bpfString vNames = "XYZCT";
+  std::vector<Dimension> vSequence;
+  for (char vName : aDimensionOrder) {
+    bpfSize vDim = vNames.find(vName);
+    if (vDim == bpfString::npos || std::find(vSequence.begin(), vSequence.end(), static_cast<Dimension>(vDim)) != vSequence.end()) {
+      throw bpfFileFormatException("Invalid synthetic dimension order: " + aDimensionOrder);
+    }
+    vSequence.push_back(static_cast<Dimension>(vDim));
+  }
+  if (vSequence.size() != 5) {
+    throw bpfFileFormatException("Invalid synthetic dimension order: " + aDimensionOrder);
+  }
+
+  // interleaved channels are the fastest dimension of a block
+  if (mInterleaved) {
+    vSequence.erase(std::find(vSequence.begin(), vSequence.end(), C));
+    vSequence.insert(vSequence.begin(), C);
+  }
+  mDimensionSequence = vSequence;
+}
+
+
+std::vector<bpfSize> bpfFileReaderSynthetic::ToDataOrder(const std::vector<bpfSize>& aXYZCT) const
+{
+  std::vector<bpfSize> vData(5);
+  for (bpfSize vIndex = 0; vIndex < 5; ++vIndex) {
+    vData[vIndex] = aXYZCT[mDimensionSequence[vIndex]];
+  }
+  return vData;
+}
+
+
+// Methods from interface
+
+std::vector<bpfString> bpfFileReaderSynthetic::GetAllFileNames() const
+{
+  return {};
+}
+
+
+std::vector<bpfString> bpfFileReaderSynthetic::GetAllFileNamesOfDataSet(const bpfString& aFileName) const
+{
+  return {};
+}
+
+
+bpfString bpfFileReaderSynthetic::GetReaderDescription() const
+{
+  return GetDescription();
+}
+
+
+std::vector<bpfString> bpfFileReaderSynthetic::GetReaderExtension() const
+{
+  return { GetExtension() };
+}
+
+
+bpfNumberType bpfFileReaderSynthetic::GetDataType()
+{
+  return mDataType;
+}
+
+
+std::vector<bpfFileReaderSynthetic::Dimension> bpfFileReaderSynthetic::GetDimensionSequence()
+{
+  return mDimensionSequence;
+}
+
+
+std::vector<bpfSize> bpfFileReaderSynthetic::GetDataSizeV()
+{
+  return ToDataOrder(mSize);
+}
+
+
+std::vector<bpfSize> bpfFileReaderSynthetic::GetDataBlockSizeV()
+{
+  return ToDataOrder(mBlockSize);
+}
+
+
+bool bpfFileReaderSynthetic::SetDataBlockSize(bpfSize aDimension0, bpfSize aDimension1, bpfSize aDimension2, bpfSize aDimension3, bpfSize aDimension4, bpfSize aResolutionLevel)
+{
+  bpfSize vBlockSize[5] = { aDimension0, aDimension1, aDimension2, aDimension3, aDimension4 };
+  if (aResolutionLevel != 0 || std::find(vBlockSize, vBlockSize + 5, 0) != vBlockSize + 5) {
+    return false;
+  }
+
+  for (bpfSize vIndex = 0; vIndex < 5; ++vIndex) {
+    mBlockSize[mDimensionSequence[vIndex]] = vBlockSize[vIndex];
+  }
+  return true;
+}
+
+
+void bpfFileReaderSynthetic::ReadDataBlock(void* aDataBlockMemory)
+{
+  // position of the first voxel of the block, in data order
+  std::vector<bpfSize> vDataSize = GetDataSizeV();
+  std::vector<bpfSize> vBlockSize = GetDataBlockSizeV();
+  std::vector<bpfSize> vBlockStart(5);
+  bpfSize vBlockNumber = mBlockNumber;
+  for (bpfSize vIndex = 0; vIndex < 5; ++vIndex) {
+    bpfSize vNumberOfBlocks = (vDataSize[vIndex] + vBlockSize[vIndex] - 1) / vBlockSize[vIndex];
+    vBlockStart[vIndex] = (vBlockNumber % vNumberOfBlocks) * vBlockSize[vIndex];
+    vBlockNumber /= vNumberOfBlocks;
+  }
+
+  switch (mDataType) {
+  case bpfUInt8Type:
+    FillBlock(static_cast<bpfUInt8*>(aDataBlockMemory), vBlockStart);
+    break;
+  case bpfUInt16Type:
+    FillBlock(static_cast<bpfUInt16*>(aDataBlockMemory), vBlockStart);
+    break;
+  case bpfUInt32Type:
+    FillBlock(static_cast<bpfUInt32*>(aDataBlockMemory), vBlockStart);
+    break;
+  case bpfFloatType:
+    FillBlock(static_cast<bpfFloat*>(aDataBlockMemory), vBlockStart);
+    break;
+  default:
+    throw bpfFileFormatException("Unsupported synthetic pixel type");
+  }
+
+  GoToNextDataBlock();
+}
+
+
+template<typename TDataType>
+void bpfFileReaderSynthetic::FillBlock(TDataType* aBlock, const std::vector<bpfSize>& aBlockStart) const
+{
+  std::vector<bpfSize> vDataSize = ToDataOrder(mSize);
+  std::vector<bpfSize> vBlockSize = ToDataOrder(mBlockSize);
+  const Dimension* vSequence = mDimensionSequence.data();
+
+  // voxels beyond the border of the image are 0, like the padding of the other readers
+  bpfSize vPosition[5]; // XYZCT
+  bpfSize vIndex[5];    // in the block, data order
+  TDataType* vVoxel = aBlock;
+  for (vIndex[4] = 0; vIndex[4] < vBlockSize[4]; ++vIndex[4]) {
+    for (vIndex[3] = 0; vIndex[3] < vBlockSize[3]; ++vIndex[3]) {
+      for (vIndex[2] = 0; vIndex[2] < vBlockSize[2]; ++vIndex[2]) {
+        for (vIndex[1] = 0; vIndex[1] < vBlockSize[1]; ++vIndex[1]) {
+          bool vInside = true;
+          for (bpfSize vDim = 1; vDim < 5; ++vDim) {
+            vPosition[vSequence[vDim]] = aBlockStart[vDim] + vIndex[vDim];
+            vInside = vInside && vPosition[vSequence[vDim]] < vDataSize[vDim];
+          }
+          bpfSize vEnd = vInside ? std::min(vBlockSize[0], vDataSize[0] - aBlockStart[0]) : 0;
+          for (vIndex[0] = 0; vIndex[0] < vEnd; ++vIndex[0]) {
+            vPosition[vSequence[0]] = aBlockStart[0] + vIndex[0];
+            *vVoxel++ = static_cast<TDataType>(GetVoxelValue(vPosition));
+          }
+          std::fill(vVoxel, vVoxel + (vBlockSize[0] - vEnd), TDataType(0));
+          vVoxel += vBlockSize[0] - vEnd;
+        }
+      }
+    }
+  }
+}
+
+
+bpfUInt32 bpfFileReaderSynthetic::GetVoxelValue(const bpfSize* aPositionXYZCT)
+{
+  // ramps over the image with some noise, compression and histograms see
+  // neither constant nor random data
+  bpfUInt32 vHash = static_cast<bpfUInt32>(aPositionXYZCT[X] * 73856093u ^ aPositionXYZCT[Y] * 19349663u ^
+    aPositionXYZCT[Z] * 83492791u ^ aPositionXYZCT[C] * 2654435761u ^ aPositionXYZCT[T] * 40503u);
+  vHash ^= vHash >> 13;
+  vHash *= 0x5bd1e995u;
+  vHash ^= vHash >> 15;
+
+  bpfUInt32 vRamp = static_cast<bpfUInt32>(aPositionXYZCT[X] + aPositionXYZCT[Y] + 4 * aPositionXYZCT[Z] + 64 * aPositionXYZCT[C] + 16 * aPositionXYZCT[T]);
+  return vRamp + (vHash & 0xf);
+}
+
+
+void bpfFileReaderSynthetic::GoToDataBlock(bpfSize aBlockNumber)
+{
+  mBlockNumber = aBlockNumber;
+}
+
+
+void bpfFileReaderSynthetic::GoToNextDataBlock()
+{
+  mBlockNumber++;
+}
+
+
+void bpfFileReaderSynthetic::GetExtents(bpfVector3Float& aMin, bpfVector3Float& aMax)
+{
+  // voxels of 1 um
+  aMin[0] = 0;
+  aMin[1] = 0;
+  aMin[2] = 0;
+
+  aMax[0] = static_cast<bpfFloat>(mSize[X]);
+  aMax[1] = static_cast<bpfFloat>(mSize[Y]);
+  aMax[2] = static_cast<bpfFloat>(mSize[Z]);
+}
+
+
+bpfSectionContainer bpfFileReaderSynthetic::ReadParametersImpl()
+{
+  static const char vNames[] = "XYZCT";
+  bpfString vDimensionOrder;
+  for (Dimension vDim : mDimensionSequence) {
+    vDimensionOrder += vNames[vDim];
+  }
+
+  bpfSectionContainer vSectionContainer;
+  bpfParameterSection* vImageSection = vSectionContainer.CreateSection("Image");
+  vImageSection->SetParameter("Name", mName);
+
+  bpfParameterSection* vSyntheticSection = vSectionContainer.CreateSection("Synthetic");
+  vSyntheticSection->SetParameter("PixelType", bpfToString(mDataType));
+  vSyntheticSection->SetParameter("DimensionOrder", vDimensionOrder);
+  vSyntheticSection->SetParameter("IsInterleaved", bpfToString(mInterleaved));
+  return vSectionContainer;
+}
@@ -0,0 +1,112 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#ifndef __BPF_FILE_READER_SYNTHETIC__
+#define __BPF_FILE_READER_SYNTHETIC__
+
+#include "fileiobase/readers/bpfFileReaderImpl.h"
+
+#include <vector>
+
+
+/**
+ * Reader of a generated image, no file is opened and no virtual machine is
+ * needed. It serves to measure the conversion without the costs of a format.
+ *
+ * The image is described by its file name, in the manner of the Bio-Formats
+ * .fake files, e.g.
+ *
+ *   name&sizeX=1024&sizeY=1024&sizeZ=64&sizeC=3&pixelType=uint16&dimOrder=XYZCT&interleaved=true.synthetic
+ *
+ * Keys (all optional):
+ *   sizeX, sizeY, sizeZ, sizeC, sizeT  image size (default 512, 512, 1, 1, 1)
+ *   pixelType                          uint8, uint16, uint32 or float (default uint8)
+ *   dimOrder                           order of the dimensions in a block (default XYZCT)
+ *   interleaved                        true moves C to the front of dimOrder (default false)
+ *   blockX, blockY, blockZ, blockC, blockT
+ *                                      block size (default one plane of one channel,
+ *                                      all channels if interleaved)
+ *
+ * The voxel values only depend on the XYZCT position of the voxel, the same
+ * image with other block sizes or dimension orders has the same voxels.
+ */
+class bpfFileReaderSynthetic : public bpfFileReaderImpl
+{
+
+public:
+
+  bpfFileReaderSynthetic(const bpfString& aFileName);
+  ~bpfFileReaderSynthetic();
+
+  static bpfString GetDescription();
+  static bpfString GetExtension();
+
+
+  // methods from interface
+
+  std::vector<bpfString> GetAllFileNames() const override;
+  std::vector<bpfString> GetAllFileNamesOfDataSet(const bpfString& aFileName) const override;
+
+  bpfString GetReaderDescription() const override;
+  std::vector<bpfString> GetReaderExtension() const override;
+
+  bpfNumberType GetDataType() override;
+
+  std::vector<Dimension> GetDimensionSequence() override;
+
+  std::vector<bpfSize> GetDataSizeV() override;
+  std::vector<bpfSize> GetDataBlockSizeV() override;
+
+  bool SetDataBlockSize(bpfSize aDimension0, bpfSize aDimension1, bpfSize aDimension2, bpfSize aDimension3, bpfSize aDimension4, bpfSize aResolutionLevel) override;
+
+  void ReadDataBlock(void* aDataBlockMemory) override;
+  void GoToDataBlock(bpfSize aBlockNumber) override;
+  void GoToNextDataBlock() override;
+
+  void GetExtents(bpfVector3Float& aMin, bpfVector3Float& aMax) override;
+
+
+protected:
+  bpfSectionContainer ReadParametersImpl() override;
+
+
+private:
+  void ParseFileName(const bpfString& aFileName);
+  void SetDimensionOrder(const bpfString& aDimensionOrder);
+  std::vector<bpfSize> ToDataOrder(const std::vector<bpfSize>& aXYZCT) const;
+
+  template<typename TDataType>
+  void FillBlock(TDataType* aBlock, const std::vector<bpfSize>& aBlockStart) const;
+
+  static bpfUInt32 GetVoxelValue(const bpfSize* aPositionXYZCT);
+
+
+  bpfString mName;
+  bpfNumberType mDataType;
+  std::vector<Dimension> mDimensionSequence;
+  bool mInterleaved;
+
+  // in XYZCT
+  std::vector<bpfSize> mSize;
+  std::vector<bpfSize> mBlockSize;
+
+  bpfSize mBlockNumber;
+};
+
+#endif
@@ -22,8 +22,10 @@
 #if defined(_WIN32)
 #include <windows.h>
 #include <process.h>
+#include <psapi.h>
 #else
 #include <unistd.h>
+#include <sys/resource.h>
 #endif
 
 #include <boost/filesystem.hpp>
@@ -43,3 +45,26 @@ bpfUInt32 bpfSysInfo::GetProcessId()
   return getpid();
 #endif
 }
+
+
+bpfUInt64 bpfSysInfo::GetPeakMemoryUsage()
+{
+#if defined(_WIN32)
+  PROCESS_MEMORY_COUNTERS vCounters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &vCounters, sizeof(vCounters))) {
+    return 0;
+  }
+  return vCounters.PeakWorkingSetSize;
+#else
+  struct rusage vUsage;
+  if (getrusage(RUSAGE_SELF, &vUsage) != 0) {
+    return 0;
+  }
+#if defined(__APPLE__)
+  return static_cast<bpfUInt64>(vUsage.ru_maxrss);
+#else
+  // kilobytes on Linux
+  return static_cast<bpfUInt64>(vUsage.ru_maxrss) * 1024;
+#endif
+#endif
+}
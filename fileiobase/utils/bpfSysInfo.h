@@ -27,6 +27,8 @@ class bpfSysInfo {
 public:
   static bpfString GetTemporaryPath();
   static bpfUInt32 GetProcessId();
+  // largest resident memory of this process so far, in bytes
+  static bpfUInt64 GetPeakMemoryUsage();
 };
 
 
@@ -0,0 +1,71 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#ifndef __BPF_TRACE_RECORDER__
+#define __BPF_TRACE_RECORDER__
+
+
+/**
+ * Receives the begin and end of the stages of a conversion, e.g. to write a
+ * timeline of all threads. Called from any thread, aName has to be a string
+ * literal (it is kept, not copied).
+ *
+ * Implemented by the application and handed to the reader factories, the
+ * recorder is only called through its virtual methods, also across libraries.
+ */
+class bpfTraceRecorder
+{
+public:
+  virtual ~bpfTraceRecorder() {}
+
+  virtual void Begin(const char* aName) = 0;
+  virtual void End(const char* aName) = 0;
+};
+
+
+// records a stage while in scope, does nothing without a recorder
+class bpfTraceScope
+{
+public:
+  bpfTraceScope(bpfTraceRecorder* aRecorder, const char* aName)
+    : mRecorder(aRecorder),
+      mName(aName)
+  {
+    if (mRecorder) {
+      mRecorder->Begin(mName);
+    }
+  }
+
+  ~bpfTraceScope()
+  {
+    if (mRecorder) {
+      mRecorder->End(mName);
+    }
+  }
+
+private:
+  bpfTraceScope(const bpfTraceScope&) = delete;
+  bpfTraceScope& operator=(const bpfTraceScope&) = delete;
+
+  bpfTraceRecorder* mRecorder;
+  const char* mName;
+};
+
+
+#endif
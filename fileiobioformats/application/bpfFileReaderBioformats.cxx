@@ -21,11 +21,112 @@
 
 //#include "fileiobioformats/java/bpJavaHandle.h"
 #include <limits>
+#include <algorithm>
+#include <cstring>
 #include "bpfTypesUtils.h"
+#include "bpfPixelConversion.h"
 
 
-bpfFileReaderBioformats::bpfFileReaderBioformats(const bpfString& aFilename)
-  : bpfFileReaderImpl(aFilename), mBlockNumber(0)
+// planes with more voxels are read in tiles, so that a block never needs a huge java array
+static const bpfSize gMaxPlaneSizeWithoutTiles = 4096 * 4096;
+// preferred tile size in X and Y, the tiles of the file are used as long as they are not larger than gMaxTileSize
+static const bpfSize gPreferredTileSize = 1024;
+static const bpfSize gMaxTileSize = 4096;
+
+
+/**
+ * Restores the active resolution level of a reader when leaving the scope,
+ * also if an exception is thrown.
+ */
+class cRestoreResolutionLevel
+{
+public:
+  explicit cRestoreResolutionLevel(bpfFileReaderImpl* aReader)
+    : mReader(aReader),
+      mResolutionLevel(aReader->GetActiveResolutionLevel())
+  {
+  }
+
+  ~cRestoreResolutionLevel()
+  {
+    try {
+      if (mReader->GetActiveResolutionLevel() != mResolutionLevel) {
+        mReader->SetActiveResolutionLevel(mResolutionLevel);
+      }
+    }
+    catch (...) {
+    }
+  }
+
+  bpfSize GetResolutionLevel() const
+  {
+    return mResolutionLevel;
+  }
+
+private:
+  bpfFileReaderImpl* mReader;
+  bpfSize mResolutionLevel;
+};
+
+
+/**
+ * Moves the voxels of a tile, that are packed at the start of aData, to their
+ * position in a block of size aBlockSize. The tile covers the block except in
+ * X and Y, where it has the size aSizeX and aSizeY. Voxels outside the tile are
+ * set to 0.
+ */
+static void ExpandTileToBlock(bpfUInt8* aData, const std::vector<bpfFileReaderImpl::Dimension>& aDimensionSequence,
+                              const std::vector<bpfSize>& aBlockSize, bpfSize aSizeX, bpfSize aSizeY, bpfSize aBytesPerPixel)
+{
+  std::vector<bpfSize> vTileSize = aBlockSize;
+  bpfSize vNumberOfRows = 1;
+  for (bpfSize vIndex = 0; vIndex < aDimensionSequence.size(); vIndex++) {
+    if (aDimensionSequence[vIndex] == bpfFileReaderImpl::X) {
+      vTileSize[vIndex] = aSizeX;
+    }
+    else if (aDimensionSequence[vIndex] == bpfFileReaderImpl::Y) {
+      vTileSize[vIndex] = aSizeY;
+    }
+    if (vIndex > 0) {
+      vNumberOfRows *= vTileSize[vIndex];
+    }
+  }
+
+  bpfSize vBlockBytes = aBytesPerPixel;
+  for (bpfSize vSize : aBlockSize) {
+    vBlockBytes *= vSize;
+  }
+
+  // a row never moves towards the start, so going backwards never overwrites a row not yet moved
+  bpfSize vRowBytes = vTileSize[0] * aBytesPerPixel;
+  bpfSize vEndOfNextRow = vBlockBytes;
+  for (bpfSize vRow = vNumberOfRows; vRow-- > 0;) {
+    bpfSize vBlockOffset = 0;
+    bpfSize vRemainder = vRow;
+    bpfSize vStride = aBlockSize[0];
+    for (bpfSize vIndex = 1; vIndex < vTileSize.size(); vIndex++) {
+      vBlockOffset += (vRemainder % vTileSize[vIndex]) * vStride;
+      vRemainder /= vTileSize[vIndex];
+      vStride *= aBlockSize[vIndex];
+    }
+    vBlockOffset *= aBytesPerPixel;
+
+    std::memmove(aData + vBlockOffset, aData + vRow * vRowBytes, vRowBytes);
+    std::memset(aData + vBlockOffset + vRowBytes, 0, vEndOfNextRow - vBlockOffset - vRowBytes);
+    vEndOfNextRow = vBlockOffset;
+  }
+  std::memset(aData, 0, vEndOfNextRow);
+}
+
+
+bpfFileReaderBioformats::bpfFileReaderBioformats(const bpfString& aFilename,
+                                                 bpfFileReaderImplFactoryBase::tMetadataLevel aMetadataLevel,
+                                                 const bpfString& aMemoDirectory,
+                                                 bpfSize aMemoMinimumElapsed,
+                                                 const bpfSharedPtr<bpfTraceRecorder>& aTraceRecorder)
+  : bpfFileReaderImpl(aFilename), mBlockNumber(0), mMetadataLevel(aMetadataLevel),
+    mMemoDirectory(aMemoDirectory), mMemoMinimumElapsed(aMemoMinimumElapsed), mTraceRecorder(aTraceRecorder),
+    mBlockBytes(nullptr), mBlockBytesSize(0)
 {
   // TODO: probably ConvertSeparators not needed after testing
   mFileName = bpfFileTools::ConvertSeparators(aFilename);
@@ -45,7 +146,10 @@ bpfFileReaderBioformats::~bpfFileReaderBioformats()
   //bpfJNISanityCheck(vClose, "vClose");
   //vEnv->CallObjectMethod(mImageReaderObject, vClose);
   //bpfJNISanityCheck();
-  
+
+  ResetMethodIds(vEnv);
+  ResetBlockBytes(vEnv);
+
   // DeleteGlobalRef
   vEnv->DeleteGlobalRef(mImageReaderObject);
   bpfJNISanityCheck();
@@ -59,6 +163,19 @@ bpfFileReaderBioformats::~bpfFileReaderBioformats()
 
 void bpfFileReaderBioformats::HandleMetadataOptions(JNIEnv* aEnv)
 {
+  // bioformats collects all metadata by default, the lower levels skip what the caller doesn't need
+  const char* vLevelName = nullptr;
+  switch (mMetadataLevel) {
+    case bpfFileReaderImplFactoryBase::eMetadataLevelMinimum:
+      vLevelName = "MINIMUM";
+      break;
+    case bpfFileReaderImplFactoryBase::eMetadataLevelNoOverlays:
+      vLevelName = "NO_OVERLAYS";
+      break;
+    case bpfFileReaderImplFactoryBase::eMetadataLevelAll:
+      return;
+  }
+
   jclass vDynamicMetadataOptionsClass(aEnv->FindClass("loci/formats/in/DynamicMetadataOptions"));
   bpfJNISanityCheck(vDynamicMetadataOptionsClass, "vDynamicMetadataOptionsClass");
 
@@ -66,37 +183,106 @@ void bpfFileReaderBioformats::HandleMetadataOptions(JNIEnv* aEnv)
   bpfJNISanityCheck(vDynamicMetadataOptionsConstructor, "vDynamicMetadataOptionsConstructor");
   jobject vDynamicMetadataOptionsObject(aEnv->NewObject(vDynamicMetadataOptionsClass, vDynamicMetadataOptionsConstructor));
   bpfJNISanityCheck(vDynamicMetadataOptionsObject, "vDynamicMetadataOptionsObject");
-  //mImageReaderObject = vEnv->NewGlobalRef(vImageReaderObject);
 
   jclass vMetadataLevelClass(aEnv->FindClass("loci/formats/in/MetadataLevel"));
   bpfJNISanityCheck(vMetadataLevelClass, "vMetadataLevelClass");
 
-  jfieldID vLevelField = aEnv->GetStaticFieldID(vMetadataLevelClass, "MINIMUM", "Lloci/formats/in/MetadataLevel;");
+  jfieldID vLevelField = aEnv->GetStaticFieldID(vMetadataLevelClass, vLevelName, "Lloci/formats/in/MetadataLevel;");
   bpfJNISanityCheck(vLevelField, "vLevelField");
   jobject vLevelObject = aEnv->GetStaticObjectField(vMetadataLevelClass, vLevelField);
   bpfJNISanityCheck(vLevelObject, "vLevelObject");
 
+  // call DynamicMetadataOptions.setMetadataLevel(MetadataLevel level), returns void
   jmethodID vSetMetadataLevel = aEnv->GetMethodID(vDynamicMetadataOptionsClass, "setMetadataLevel", "(Lloci/formats/in/MetadataLevel;)V");
   bpfJNISanityCheck(vSetMetadataLevel, "vSetMetadataLevel");
   aEnv->CallVoidMethod(vDynamicMetadataOptionsObject, vSetMetadataLevel, vLevelObject);
-  //bpfJNISanityCheck(vLevelField, "vLevelField");
-
-  /* jmethodID public void setMetadataLevel
-  public void setMetadataLevel(MetadataLevel level
-  */
+  bpfJNISanityCheck();
 
+  // call ImageReader.setMetadataOptions(MetadataOptions options), returns void
   jmethodID vSetMetadataOptions = aEnv->GetMethodID(mImageReaderClass, "setMetadataOptions", "(Lloci/formats/in/MetadataOptions;)V");
   bpfJNISanityCheck(vSetMetadataOptions, "vSetMetadataOptions");
   aEnv->CallVoidMethod(mImageReaderObject, vSetMetadataOptions, vDynamicMetadataOptionsObject);
+  bpfJNISanityCheck();
 
-
-  //setOriginalMetadataPopulated(boolean populate) {
+  // the original metadata is read from the hashtables, never from the OME annotations
+  // call ImageReader.setOriginalMetadataPopulated(boolean populate), returns void
   jmethodID vSetOriginalMetadataPopulated = aEnv->GetMethodID(mImageReaderClass, "setOriginalMetadataPopulated", "(Z)V");
   bpfJNISanityCheck(vSetOriginalMetadataPopulated, "vSetOriginalMetadataPopulated");
   aEnv->CallVoidMethod(mImageReaderObject, vSetOriginalMetadataPopulated, 0);
   bpfJNISanityCheck();
+
+  aEnv->DeleteLocalRef(vLevelObject);
+  aEnv->DeleteLocalRef(vMetadataLevelClass);
+  aEnv->DeleteLocalRef(vDynamicMetadataOptionsObject);
+  aEnv->DeleteLocalRef(vDynamicMetadataOptionsClass);
+  bpfJNISanityCheck();
+}
+
+void bpfFileReaderBioformats::UseMemoizer(JNIEnv* aEnv)
+{
+  // the memo keeps the metadata read with the options of the first open, each level has its own directory
+  bpfString vLevelName = "all";
+  switch (mMetadataLevel) {
+    case bpfFileReaderImplFactoryBase::eMetadataLevelMinimum:
+      vLevelName = "minimum";
+      break;
+    case bpfFileReaderImplFactoryBase::eMetadataLevelNoOverlays:
+      vLevelName = "no_overlays";
+      break;
+    case bpfFileReaderImplFactoryBase::eMetadataLevelAll:
+      break;
+  }
+
+  // use class java.io.File
+  jclass vFileClass(aEnv->FindClass("java/io/File"));
+  bpfJNISanityCheck(vFileClass, "vFileClass");
+  jmethodID vFileConstructor = aEnv->GetMethodID(vFileClass, "<init>", "(Ljava/lang/String;)V");
+  bpfJNISanityCheck(vFileConstructor, "vFileConstructor");
+  jstring vDirectoryName = aEnv->NewStringUTF((mMemoDirectory + "/" + vLevelName).c_str());
+  bpfJNISanityCheck(vDirectoryName, "vDirectoryName");
+  jobject vDirectoryObject(aEnv->NewObject(vFileClass, vFileConstructor, vDirectoryName));
+  bpfJNISanityCheck(vDirectoryObject, "vDirectoryObject");
+
+  // create new instance of Memoizer(IFormatReader r, long minimumElapsed, File directory) around the ImageReader,
+  // setId then reads the state of the reader from the memo file, if the file didn't change since
+  jclass vMemoizerClass(aEnv->FindClass("loci/formats/Memoizer"));
+  bpfJNISanityCheck(vMemoizerClass, "vMemoizerClass");
+  jmethodID vMemoizerConstructor = aEnv->GetMethodID(vMemoizerClass, "<init>", "(Lloci/formats/IFormatReader;JLjava/io/File;)V");
+  bpfJNISanityCheck(vMemoizerConstructor, "vMemoizerConstructor");
+  jobject vMemoizerObject(aEnv->NewObject(vMemoizerClass, vMemoizerConstructor, mImageReaderObject, static_cast<jlong>(mMemoMinimumElapsed), vDirectoryObject));
+  bpfJNISanityCheck(vMemoizerObject, "vMemoizerObject");
+
+  aEnv->DeleteGlobalRef(mImageReaderObject);
+  aEnv->DeleteGlobalRef(mImageReaderClass);
+  bpfJNISanityCheck();
+  mImageReaderClass = (jclass)aEnv->NewGlobalRef(vMemoizerClass);
+  mImageReaderObject = aEnv->NewGlobalRef(vMemoizerObject);
+
+  aEnv->DeleteLocalRef(vMemoizerObject);
+  aEnv->DeleteLocalRef(vMemoizerClass);
+  aEnv->DeleteLocalRef(vDirectoryObject);
+  aEnv->DeleteLocalRef(vDirectoryName);
+  aEnv->DeleteLocalRef(vFileClass);
+  bpfJNISanityCheck();
+}
+
+
+jobject bpfFileReaderBioformats::GetImageReader(JNIEnv* aEnv) const
+{
+  // returns a new local reference to the ImageReader, also if it is wrapped by the memoizer
+  if (mMemoDirectory.empty()) {
+    return aEnv->NewLocalRef(mImageReaderObject);
+  }
+
+  // call ReaderWrapper.getReader(), returns IFormatReader
+  jmethodID vGetReader = aEnv->GetMethodID(mImageReaderClass, "getReader", "()Lloci/formats/IFormatReader;");
+  bpfJNISanityCheck(vGetReader, "vGetReader");
+  jobject vImageReaderObject(aEnv->CallObjectMethod(mImageReaderObject, vGetReader));
+  bpfJNISanityCheck(vImageReaderObject, "vImageReaderObject");
+  return vImageReaderObject;
 }
 
+
 void bpfFileReaderBioformats::TryOpenAsSeries()
 {
   auto vEnv = bpfJNI::GetEnv();
@@ -154,6 +340,9 @@ void bpfFileReaderBioformats::TryOpenAsSeries()
     bpfJNISanityCheck();
 
   if (vNumberFiles > 1) {
+    // the ids of a file pattern are not memoized (the memoizer doesn't check their files for changes)
+    jobject vImageReaderObject = GetImageReader(vEnv);
+
     //loci.formats.FileStitcher
     jclass vFileStitcherClass(vEnv->FindClass("loci/formats/FileStitcher"));
     bpfJNISanityCheck(vFileStitcherClass, "vFileStitcherClass");
@@ -161,20 +350,30 @@ void bpfFileReaderBioformats::TryOpenAsSeries()
     bpfJNISanityCheck();
     mImageReaderClass = (jclass)vEnv->NewGlobalRef(vFileStitcherClass);
 
-    // create new instance of ImageReader
+    // create new instance of FileStitcher
     jmethodID vFileStitcherConstructor = vEnv->GetMethodID(vFileStitcherClass, "<init>", "(Lloci/formats/IFormatReader;Z)V");
     bpfJNISanityCheck(vFileStitcherConstructor, "vFileStitcherConstructor");
-    jobject vFileStitcherObject(vEnv->NewObject(vFileStitcherClass, vFileStitcherConstructor, mImageReaderObject, JNI_TRUE));
+    jobject vFileStitcherObject(vEnv->NewObject(vFileStitcherClass, vFileStitcherConstructor, vImageReaderObject, JNI_TRUE));
     bpfJNISanityCheck(vFileStitcherObject, "vFileStitcherObject");
+    vEnv->DeleteLocalRef(vImageReaderObject);
+    bpfJNISanityCheck();
+    mMemoDirectory.clear();
     vEnv->DeleteGlobalRef(mImageReaderObject);
     bpfJNISanityCheck();
     mImageReaderObject = vEnv->NewGlobalRef(vFileStitcherObject);
     jmethodID vSetId = vEnv->GetMethodID(mImageReaderClass, "setId", "(Ljava/lang/String;)V");
     bpfJNISanityCheck(vSetId, "vSetId");
-    vEnv->CallVoidMethod(mImageReaderObject, vSetId, vPattern);
+    {
+      bpfTraceScope vTrace(mTraceRecorder.get(), "setId file series");
+      vEnv->CallVoidMethod(mImageReaderObject, vSetId, vPattern);
+    }
     bpfJNISanityCheck();
     vEnv->DeleteLocalRef(vFileStitcherObject);
     bpfJNISanityCheck();
+
+    // method ids resolved on the previous reader class are no longer valid
+    ResetMethodIds(vEnv);
+    ResetSeriesInfo();
   }
 }
 
@@ -213,6 +412,10 @@ void bpfFileReaderBioformats::InitializeFileReader()
   vEnv->DeleteLocalRef(vImageReaderObject);
   bpfJNISanityCheck();
 
+  if (!mMemoDirectory.empty()) {
+    UseMemoizer(vEnv);
+  }
+
   // Set metadata store
 
   // use class loci.formats.MetadataTools
@@ -243,7 +446,7 @@ void bpfFileReaderBioformats::InitializeFileReader()
   vEnv->CallVoidMethod(mImageReaderObject, vSetMetadataStore, mMetadataObject);
   bpfJNISanityCheck();
 
-  //HandleMetadataOptions(vEnv);
+  HandleMetadataOptions(vEnv);
 
   // set flattened resolution to false, such that resolution levels are not interpreted as datasets
   // call ImageReader.setFlattenedResolutions(boolean flattened), return void
@@ -258,7 +461,10 @@ void bpfFileReaderBioformats::InitializeFileReader()
   jmethodID vSetId = vEnv->GetMethodID(mImageReaderClass, "setId", "(Ljava/lang/String;)V");
   bpfJNISanityCheck(vSetId, "vSetId");
   //jstring vFilename = vEnv->NewStringUTF(mFileName.c_str());
-  vEnv->CallVoidMethod(mImageReaderObject, vSetId, vFilename);
+  {
+    bpfTraceScope vTrace(mTraceRecorder.get(), "setId");
+    vEnv->CallVoidMethod(mImageReaderObject, vSetId, vFilename);
+  }
   bpfJNISanityCheck();
   vEnv->DeleteLocalRef(vFilename);
   bpfJNISanityCheck();
@@ -331,10 +537,10 @@ void bpfFileReaderBioformats::SetActiveDataSetIndex(bpfSize aDataSetIndex)
   LockImageReaderObject(vEnv);
 
   // call ImageReader.setSeries(int no), return void
-  jmethodID vSetSeries = vEnv->GetMethodID(mImageReaderClass, "setSeries", "(I)V");
-  bpfJNISanityCheck(vSetSeries, "vSetSeries");
-  vEnv->CallVoidMethod(mImageReaderObject, vSetSeries, aDataSetIndex);
+  vEnv->CallVoidMethod(mImageReaderObject, GetMethodIds(vEnv).mSetSeries, static_cast<jint>(aDataSetIndex));
   bpfJNISanityCheck();
+  ResetSeriesInfo();
+  mTileSizes.clear();
 
   UnlockImageReaderObject(vEnv);
 }
@@ -345,9 +551,7 @@ bpfSize bpfFileReaderBioformats::GetActiveDataSetIndex() const
   LockImageReaderObject(vEnv);
 
   // public ImageReader.getSeries(), returns int
-  jmethodID vGetSeries = vEnv->GetMethodID(mImageReaderClass, "getSeries", "()I");
-  bpfJNISanityCheck(vGetSeries, "vGetSeries");
-  jint vSeriesIndex(vEnv->CallIntMethod(mImageReaderObject, vGetSeries));
+  jint vSeriesIndex(vEnv->CallIntMethod(mImageReaderObject, GetMethodIds(vEnv).mGetSeries));
   bpfJNISanityCheck();
 
   UnlockImageReaderObject(vEnv);
@@ -376,9 +580,7 @@ bpfSize bpfFileReaderBioformats::GetActiveResolutionLevel() const
   LockImageReaderObject(vEnv);
 
   // call ImageReader.getResolution(), returns int
-  jmethodID vGetResolution = vEnv->GetMethodID(mImageReaderClass, "getResolution", "()I");
-  bpfJNISanityCheck(vGetResolution, "vGetResolution");
-  jint vResolutionIndex(vEnv->CallIntMethod(mImageReaderObject, vGetResolution));
+  jint vResolutionIndex(vEnv->CallIntMethod(mImageReaderObject, GetMethodIds(vEnv).mGetResolution));
   bpfJNISanityCheck();
 
   UnlockImageReaderObject(vEnv);
@@ -391,10 +593,9 @@ void bpfFileReaderBioformats::SetActiveResolutionLevel(bpfSize aResolutionLevel)
   LockImageReaderObject(vEnv);
 
   // call ImageReader.setResolution(int no), returns void
-  jmethodID vSetResolution = vEnv->GetMethodID(mImageReaderClass, "setResolution", "(I)V");
-  bpfJNISanityCheck(vSetResolution, "vSetResolution");
-  vEnv->CallVoidMethod(mImageReaderObject, vSetResolution, (jint) aResolutionLevel);
+  vEnv->CallVoidMethod(mImageReaderObject, GetMethodIds(vEnv).mSetResolution, (jint) aResolutionLevel);
   bpfJNISanityCheck();
+  ResetSeriesInfo();
 
   UnlockImageReaderObject(vEnv);
 }
@@ -427,10 +628,15 @@ std::vector<bpfString> bpfFileReaderBioformats::GetReaderExtension() const
 
   // get specific reader for current file format
   // call ImageReader.getReader()
-  jmethodID vGetReader = vEnv->GetMethodID(mImageReaderClass, "getReader", "()Lloci/formats/IFormatReader;");
+  jobject vImageReaderObject = GetImageReader(vEnv);
+  jclass vImageReaderClass = vEnv->GetObjectClass(vImageReaderObject);
+  jmethodID vGetReader = vEnv->GetMethodID(vImageReaderClass, "getReader", "()Lloci/formats/IFormatReader;");
   bpfJNISanityCheck(vGetReader, "vGetReader");
-  jobject vSpecificReader(vEnv->CallObjectMethod(mImageReaderObject, vGetReader));
+  jobject vSpecificReader(vEnv->CallObjectMethod(vImageReaderObject, vGetReader));
   bpfJNISanityCheck(vSpecificReader, "vSpecificReader");
+  vEnv->DeleteLocalRef(vImageReaderClass);
+  vEnv->DeleteLocalRef(vImageReaderObject);
+  bpfJNISanityCheck();
 
   // use the IFormatReader class to get the methodId, because specific reader is of type IFormatReader
   jclass vIFormatReader(vEnv->FindClass("loci/formats/IFormatReader"));
@@ -460,265 +666,84 @@ std::vector<bpfString> bpfFileReaderBioformats::GetReaderExtension() const
 bpfNumberType bpfFileReaderBioformats::GetDataType()
 {
   auto vEnv = bpfJNI::GetEnv();
-  LockImageReaderObject(vEnv);
-
-  bpfString vPixelTypeString = GetPixelTypeString(vEnv);
-  bpfNumberType vDataType = ConvertPixelType(vPixelTypeString, vEnv);
-
-  UnlockImageReaderObject(vEnv);
-  return vDataType;
+  return GetSeriesInfo(vEnv).mDataType;
 }
 
 
 std::vector<bpfFileReaderBioformats::Dimension> bpfFileReaderBioformats::GetDimensionSequence()
 {
   auto vEnv = bpfJNI::GetEnv();
-  LockImageReaderObject(vEnv);
-
-  // call ImageReader.getDimensionOrder(), returns e.g. XYCTZ (XY always first), always all 5 dimensions are included
-  jmethodID vGetDimensionOrder = vEnv->GetMethodID(mImageReaderClass, "getDimensionOrder", "()Ljava/lang/String;");
-  bpfJNISanityCheck(vGetDimensionOrder, "vGetDimensionOrder");
-  jstring vDimensionOrder((jstring)vEnv->CallObjectMethod(mImageReaderObject, vGetDimensionOrder));
-  bpfJNISanityCheck(vDimensionOrder, "vDimensionOrder");
-
-  bpfString vDimensions = ConvertString(vDimensionOrder, vEnv);
-  vEnv->DeleteLocalRef(vDimensionOrder);
-  bpfJNISanityCheck();
-
-  bool vIsInterleaved = IsInterleaved(vEnv);
-
-  std::vector<Dimension> vDimensionVector;
-
-  if (vIsInterleaved) {
-    vDimensionVector.push_back(C);
-  }
-
-  for (char& vDimension : vDimensions) {
-    if (vDimension == 'X') {
-      vDimensionVector.push_back(X);
-    }
-    else if (vDimension == 'Y') {
-      vDimensionVector.push_back(Y);
-    }
-    else if (vDimension == 'Z') {
-      vDimensionVector.push_back(Z);
-    }
-    else if (vDimension == 'C' && !vIsInterleaved) {
-      vDimensionVector.push_back(C);
-    }
-    else if (vDimension == 'T') {
-      vDimensionVector.push_back(T);
-    }
-  }
-
-  UnlockImageReaderObject(vEnv);
-  return vDimensionVector;
+  return GetSeriesInfo(vEnv).mDimensionSequence;
 }
 
 
 std::vector<bpfSize> bpfFileReaderBioformats::GetDataSizeV()
 {
   auto vEnv = bpfJNI::GetEnv();
-  LockImageReaderObject(vEnv);
-
-  auto vSeq = GetDimensionSequence();
-  std::vector<bpfSize> vSize;
-
-  for (Dimension vDimension : vSeq) {
-    if (vDimension == X) {
-      bpfSize vSizeX = GetSizeOfDimension("getSizeX", vEnv);
-      vSize.push_back(vSizeX);
-    }
-    else if (vDimension == Y) {
-      bpfSize vSizeY = GetSizeOfDimension("getSizeY", vEnv);
-      vSize.push_back(vSizeY);
-    }
-    else if (vDimension == Z) {
-      bpfSize vSizeZ = GetSizeOfDimension("getSizeZ", vEnv);
-      vSize.push_back(vSizeZ);
-    }
-    else if (vDimension == T) {
-      bpfSize vSizeT = GetSizeOfDimension("getSizeT", vEnv);
-      vSize.push_back(vSizeT);
-    }
-    else if (vDimension == C) {
-      bpfSize vSizeC = GetSizeOfDimension("getSizeC", vEnv);
-      vSize.push_back(vSizeC);
-    }
-  }
-
-  UnlockImageReaderObject(vEnv);
-  return vSize;
+  return GetSeriesInfo(vEnv).mDataSizeV;
 }
 
 
 std::vector<bpfSize> bpfFileReaderBioformats::GetDataBlockSizeV()
 {
-  // bioformats blocks are in general XY planes, except if image is interleaved or
-  // if RGBChannelCount > 1
-
   auto vEnv = bpfJNI::GetEnv();
-  LockImageReaderObject(vEnv);
-
-  auto vSeq = GetDimensionSequence();
-  std::vector<bpfSize> vSize;
-  for (Dimension vDim : vSeq) {
-    if (vDim == X) {
-      bpfSize vSizeX = GetSizeOfDimension("getSizeX", vEnv);
-      vSize.push_back(vSizeX);
-    }
-    else if (vDim == Y) {
-      bpfSize vSizeY = GetSizeOfDimension("getSizeY", vEnv);
-      vSize.push_back(vSizeY);
-    }
-    else if (vDim == C) {
-      bpfSize vRGBChannelCount = GetRGBChannelCount(vEnv);
-
-      if (IsInterleaved(vEnv) || vRGBChannelCount > 1) {
-        vSize.push_back(vRGBChannelCount);
-      }
-      else {
-        vSize.push_back(1);
-      }
-
-    }
-    else {
-      vSize.push_back(1);
-    }
-  }
-
-  UnlockImageReaderObject(vEnv);
-  return vSize;
+  return GetSeriesInfo(vEnv).mDataBlockSizeV;
 }
 
 
 void bpfFileReaderBioformats::ReadDataBlock(void* aDataBlockMemory)
 {
   auto vEnv = bpfJNI::GetEnv();
+  bpfJNILocalFrame vFrame(vEnv);
   LockImageReaderObject(vEnv);
 
-  // call ImageReader.getPixelType()
-  jmethodID vGetPixelType = vEnv->GetMethodID(mImageReaderClass, "getPixelType", "()I");
-  bpfJNISanityCheck(vGetPixelType, "vGetPixelType");
-  jint vPixelType(vEnv->CallIntMethod(mImageReaderObject, vGetPixelType));
-  bpfJNISanityCheck();
-
-  // use class loci.formats.FormatTools
-  jclass vFormatTools(vEnv->FindClass("loci/formats/FormatTools"));
-  bpfJNISanityCheck(vFormatTools, "vFormatTools");
-
-  // call FormatTools.getBytesPerPixel(int pixelType), returns int, is static
-  jmethodID vGetBytesPerPixel = vEnv->GetStaticMethodID(vFormatTools, "getBytesPerPixel", "(I)I");
-  bpfJNISanityCheck(vGetBytesPerPixel, "vGetBytesPerPixel");
-  jint vJBytesPerPixel(vEnv->CallStaticIntMethod(vFormatTools, vGetBytesPerPixel, vPixelType));
-  bpfJNISanityCheck();
-  vEnv->DeleteLocalRef(vFormatTools);
-  bpfJNISanityCheck();
-  bpfSize vBytesPerPixel = static_cast<bpfSize>(vJBytesPerPixel);
-
-  
-  jsize vBufferSize = static_cast<jsize>(GetDataBlockNumberOfVoxels() * vBytesPerPixel);
-  jint vBlockNumber = static_cast<jint>(mBlockNumber);
+  const cSeriesInfo& vInfo = GetSeriesInfo(vEnv);
+  bpfSize vNumberOfVoxels = 1;
+  for (bpfSize vSize : vInfo.mDataBlockSizeV) {
+    vNumberOfVoxels *= vSize;
+  }
 
-  // call ImageReader.openBytes(int no), returns byte[]
-  jmethodID vOpenBytes = vEnv->GetMethodID(mImageReaderClass, "openBytes", "(I)[B");
-  bpfJNISanityCheck(vOpenBytes, "vOpenBytes");
-  jbyteArray vJBlockBytes((jbyteArray)vEnv->CallObjectMethod(mImageReaderObject, vOpenBytes, vBlockNumber));
+  jsize vBufferSize = static_cast<jsize>(vNumberOfVoxels * vInfo.mBytesPerPixel);
+  bpfSize vStartX = 0;
+  bpfSize vStartY = 0;
+  jint vPlane = static_cast<jint>(GetPlaneOfBlock(vInfo, mBlockNumber, vStartX, vStartY));
+
+  // tiles at the right and bottom border of the image are smaller than the block
+  bpfSize vBlockSizeX = GetDataBlockSize(X);
+  bpfSize vBlockSizeY = GetDataBlockSize(Y);
+  bpfSize vSizeX = std::min(vBlockSizeX, vInfo.mCropMax[X] - vStartX);
+  bpfSize vSizeY = std::min(vBlockSizeY, vInfo.mCropMax[Y] - vStartY);
+  jsize vTileBufferSize = static_cast<jsize>(vNumberOfVoxels / (vBlockSizeX * vBlockSizeY) * vSizeX * vSizeY * vInfo.mBytesPerPixel);
+
+  // call ImageReader.openBytes(int no, byte[] buf, int x, int y, int w, int h), returns buf
+  // the decoder fills the array owned by this reader, no new byte[] per block,
+  // and only decodes the requested tile of the plane
+  jbyteArray vBlockBytes = GetBlockBytes(vEnv, vBufferSize);
+  jbyteArray vJBlockBytes = nullptr;
+  {
+    bpfTraceScope vTrace(mTraceRecorder.get(), "openBytes");
+    vJBlockBytes = (jbyteArray)vEnv->CallObjectMethod(mImageReaderObject, GetMethodIds(vEnv).mOpenBytes, vPlane, vBlockBytes,
+      static_cast<jint>(vStartX), static_cast<jint>(vStartY), static_cast<jint>(vSizeX), static_cast<jint>(vSizeY));
+  }
   bpfJNISanityCheck(vJBlockBytes, "vJBlockBytes");
 
   // copy bytes from vJBlockBytes array into buffer
-  vEnv->GetByteArrayRegion(vJBlockBytes, 0, vBufferSize, (jbyte*) aDataBlockMemory);
+  vEnv->GetByteArrayRegion(vJBlockBytes, 0, vTileBufferSize, (jbyte*) aDataBlockMemory);
   bpfJNISanityCheck();
 
   vEnv->DeleteLocalRef(vJBlockBytes);
   bpfJNISanityCheck();
-  // check big endian
-  // call ImageReader.isLittleEndian(), return bool
-  jmethodID vIsLittleEndian = vEnv->GetMethodID(mImageReaderClass, "isLittleEndian", "()Z");
-  bpfJNISanityCheck(vIsLittleEndian, "vIsLittleEndian");
-  jboolean vJLittleEndian(vEnv->CallBooleanMethod(mImageReaderObject, vIsLittleEndian));
-  bpfJNISanityCheck();
 
-  bool vLittleEndian = static_cast<bool>(vJLittleEndian);
-
-  bpfNumberType vDataType = GetDataType();
-  if (!vLittleEndian) {
-    if (vDataType == bpfUInt16Type) {
-      bpfSize vNumberOfVoxels = GetDataBlockNumberOfVoxels();
-      bpfInt16* vDataBlockMemory = static_cast<bpfInt16*>(aDataBlockMemory);
-      for (bpfSize vIndex = 0; vIndex < vNumberOfVoxels; vIndex++) {
-        bpfSwapVal(vDataBlockMemory++);
-      }
-    }
-    else if (vDataType == bpfFloatType) {
-      bpfSize vNumberOfVoxels = GetDataBlockNumberOfVoxels();
-      bpfFloat* vDataBlockMemory = static_cast<bpfFloat*>(aDataBlockMemory);
-      for (bpfSize vIndex = 0; vIndex < vNumberOfVoxels; vIndex++) {
-        bpfSwapVal(vDataBlockMemory++);
-      }
-    }
+  if (vSizeX < vBlockSizeX || vSizeY < vBlockSizeY) {
+    ExpandTileToBlock(static_cast<bpfUInt8*>(aDataBlockMemory), vInfo.mDimensionSequence, vInfo.mDataBlockSizeV, vSizeX, vSizeY, vInfo.mBytesPerPixel);
   }
 
-
-  // adjust values to our data types
-  // if the original format is signed, we set all negative values to 0
-  // get original pixel type 
-  bpfString vPixelTypeString = GetPixelTypeString(vEnv);
-  
-  if (vPixelTypeString == "int8") {
-    //BP_TRACE_MSG(1, "bpfFileReaderICS: Converting data from signed 8bit int");
-    bpfInt8* dataSigned = (bpfInt8*)aDataBlockMemory;
-    bpfInt8* dataEnd = dataSigned + GetDataBlockNumberOfVoxels();
-    while (dataSigned != dataEnd) {
-      if (*dataSigned < 0) {
-        *dataSigned = 0;
-      }
-      ++dataSigned;
-    }
-  } 
-  else if (vPixelTypeString == "int16") {
-    //BP_TRACE_MSG(1, "bpfFileReaderICS: Converting data from signed 16bit int");
-    bpfInt16* dataSigned = (bpfInt16*)aDataBlockMemory;
-    bpfInt16* dataEnd = dataSigned + GetDataBlockNumberOfVoxels();
-    while (dataSigned != dataEnd) {
-      if (*dataSigned < 0) {
-        *dataSigned = 0;
-      }
-      ++dataSigned;
-    }
-  }
-  else if (vPixelTypeString == "int32") {
-    //BP_TRACE_MSG(1, "bpfFileReaderICS: Converting data from signed 32bit int to float");
-    const bpfInt32* dataInt = (bpfInt32*)aDataBlockMemory;
-    const bpfInt32* dataEnd = dataInt + GetDataBlockNumberOfVoxels();
-    bpfFloat* dataFloat = (bpfFloat*)aDataBlockMemory;
-    while (dataInt != dataEnd) {
-      *dataFloat = static_cast<bpfFloat>(*dataInt);
-      ++dataFloat;
-      ++dataInt;
-    }
-  }
-  else if (vPixelTypeString == "uint32") {
-    //BP_TRACE_MSG(1, "bpfFileReaderICS: Converting data from signed 32bit int to float");
-    const bpfUInt32* dataInt = (bpfUInt32*)aDataBlockMemory;
-    const bpfUInt32* dataEnd = dataInt + GetDataBlockNumberOfVoxels();
-    bpfFloat* dataFloat = (bpfFloat*)aDataBlockMemory;
-    while (dataInt != dataEnd) {
-      *dataFloat = static_cast<bpfFloat>(*dataInt);
-      ++dataFloat;
-      ++dataInt;
-    }
-  } 
-  else if (vPixelTypeString == "double") {
-    //BP_TRACE_MSG(1, "bpfFileReaderICS: Converting data from signed 32bit int to float");
-    const bpfDouble* dataDouble = (bpfDouble*)aDataBlockMemory;
-    const bpfDouble* dataEnd = dataDouble + GetDataBlockNumberOfVoxels();
-    bpfFloat* dataFloat = (bpfFloat*)aDataBlockMemory;
-    while (dataDouble != dataEnd) {
-      *dataFloat = static_cast<bpfFloat>(*dataDouble);
-      ++dataFloat;
-      ++dataDouble;
-    }
+  // swap big endian data and adjust values to our data types in one pass:
+  // if the original format is signed, we set all negative values to 0,
+  // 32 bit integers and doubles are converted to float
+  {
+    bpfTraceScope vTrace(mTraceRecorder.get(), "normalize");
+    bpfNormalizePixels(aDataBlockMemory, vNumberOfVoxels, vInfo.mSourceType, !vInfo.mLittleEndian);
   }
 
   GoToNextDataBlock();
@@ -747,9 +772,12 @@ void bpfFileReaderBioformats::GetExtents(bpfVector3Float& aMin, bpfVector3Float&
 
   std::vector<bpfFloat> vScales = GetPixelScales(vEnv);
 
-  aMin[0] = 0 - vScales[0] / 2.0f;
-  aMin[1] = 0 - vScales[1] / 2.0f;
-  aMin[2] = 0 - vScales[2] / 2.0f;
+  // a cropped image starts at its first voxel
+  const std::vector<bpfSize>& vCropMin = GetSeriesInfo(vEnv).mCropMin;
+
+  aMin[0] = vCropMin[X] * vScales[0] - vScales[0] / 2.0f;
+  aMin[1] = vCropMin[Y] * vScales[1] - vScales[1] / 2.0f;
+  aMin[2] = vCropMin[Z] * vScales[2] - vScales[2] / 2.0f;
 
   aMax[0] = aMin[0] + GetDataSize(X) * vScales[0];
   aMax[1] = aMin[1] + GetDataSize(Y) * vScales[1];
@@ -765,33 +793,38 @@ bool bpfFileReaderBioformats::ReadThumbnail(std::vector<bpfPackedRGBA>& aThumbna
   // call ImageReader.getThumbSizeX(), returns int
   jmethodID vGetThumbSizeX = vEnv->GetMethodID(mImageReaderClass, "getThumbSizeX", "()I");
   bpfJNISanityCheck(vGetThumbSizeX, "vGetThumbSizeX");
-  jint vThumbSizeX(vEnv->CallIntMethod(mImageReaderObject, vGetThumbSizeX));
-  bpfJNISanityCheck();
-  aSizeX = static_cast<bpfSize>(vThumbSizeX);
-
   // call ImageReader.getThumbSizeY(), returns int
   jmethodID vGetThumbSizeY = vEnv->GetMethodID(mImageReaderClass, "getThumbSizeY", "()I");
   bpfJNISanityCheck(vGetThumbSizeY, "vGetThumbSizeY");
+
+  // openThumbBytes decodes the whole plane of the active resolution level, for pyramidal
+  // files use the smallest level that is still at least as large as the thumbnail
+  cRestoreResolutionLevel vRestoreResolutionLevel(this);
+  bpfSize vResolutionLevel = vRestoreResolutionLevel.GetResolutionLevel();
+  bpfSize vThumbnailLevel = vResolutionLevel;
+  jint vThumbSizeX(vEnv->CallIntMethod(mImageReaderObject, vGetThumbSizeX));
+  bpfJNISanityCheck();
   jint vThumbSizeY(vEnv->CallIntMethod(mImageReaderObject, vGetThumbSizeY));
   bpfJNISanityCheck();
-  aSizeY = static_cast<bpfSize>(vThumbSizeY);
+  for (bpfSize vLevel = vResolutionLevel + 1; vLevel < GetNumberOfResolutions(); vLevel++) {
+    SetActiveResolutionLevel(vLevel);
+    if (GetDataSize(X) < static_cast<bpfSize>(vThumbSizeX) || GetDataSize(Y) < static_cast<bpfSize>(vThumbSizeY)) {
+      break;
+    }
+    vThumbnailLevel = vLevel;
+  }
+  if (GetActiveResolutionLevel() != vThumbnailLevel) {
+    SetActiveResolutionLevel(vThumbnailLevel);
+  }
 
-  // call ImageReader.getPixelType()
-  jmethodID vGetPixelType = vEnv->GetMethodID(mImageReaderClass, "getPixelType", "()I");
-  bpfJNISanityCheck(vGetPixelType, "vGetPixelType");
-  jint vPixelType(vEnv->CallIntMethod(mImageReaderObject, vGetPixelType));
+  vThumbSizeX = vEnv->CallIntMethod(mImageReaderObject, vGetThumbSizeX);
   bpfJNISanityCheck();
-
-  // use class loci.formats.FormatTools
-  jclass vFormatTools(vEnv->FindClass("loci/formats/FormatTools"));
-  bpfJNISanityCheck(vFormatTools, "vFormatTools");
-
-  // call FormatTools.getBytesPerPixel(int pixelType), returns int, is static
-  jmethodID vGetBytesPerPixel = vEnv->GetStaticMethodID(vFormatTools, "getBytesPerPixel", "(I)I");
-  bpfJNISanityCheck(vGetBytesPerPixel, "vGetBytesPerPixel");
-  jint vJBytesPerPixel(vEnv->CallStaticIntMethod(vFormatTools, vGetBytesPerPixel, vPixelType));
+  aSizeX = static_cast<bpfSize>(vThumbSizeX);
+  vThumbSizeY = vEnv->CallIntMethod(mImageReaderObject, vGetThumbSizeY);
   bpfJNISanityCheck();
-  bpfSize vBytesPerPixel = static_cast<bpfSize>(vJBytesPerPixel);
+  aSizeY = static_cast<bpfSize>(vThumbSizeY);
+
+  bpfSize vBytesPerPixel = GetSeriesInfo(vEnv).mBytesPerPixel;
 
   bpfSize vNumberOfChannels = GetDataSize(C);
   bpfSize vNumberOfChannelsInBlock = GetDataBlockSize(C);
@@ -809,7 +842,9 @@ bool bpfFileReaderBioformats::ReadThumbnail(std::vector<bpfPackedRGBA>& aThumbna
 
   for (bpfSize vChannelBlockIndex = 0; vChannelBlockIndex < vNumberOfChannelBlocks; vChannelBlockIndex++) {
   
-    jint vBlockNumber = GetDataBlockNumber(0, 0, vMiddleSlice, vChannelBlockIndex * vNumberOfChannelsInBlock, 0);
+    bpfSize vStartX = 0;
+    bpfSize vStartY = 0;
+    jint vBlockNumber = static_cast<jint>(GetPlaneOfBlock(GetSeriesInfo(vEnv), GetDataBlockNumber(0, 0, vMiddleSlice, vChannelBlockIndex * vNumberOfChannelsInBlock, 0), vStartX, vStartY));
 
     // call ImageReader.openThumbBytes(int no), returns byte[]
     jmethodID vOpenThumbBytes = vEnv->GetMethodID(mImageReaderClass, "openThumbBytes", "(I)[B");
@@ -862,12 +897,13 @@ bool bpfFileReaderBioformats::ReadThumbnail(std::vector<bpfPackedRGBA>& aThumbna
 bpfColorInfo bpfFileReaderBioformats::ReadColorInfo(bpfSize aChannel)
 {
   auto vEnv = bpfJNI::GetEnv();
+  bpfJNILocalFrame vFrame(vEnv);
   LockImageReaderObject(vEnv);
   LockMetadataObject(vEnv);
 
   // Get channel base color
 
-  tOptionalColor vChannelColor = GetChannelColor(aChannel, vEnv);
+  tOptionalColor vChannelColor = GetChannelColor(aChannel + GetSeriesInfo(vEnv).mCropMin[C], vEnv);
   if (vChannelColor) {
     UnlockImageReaderObject(vEnv);
     UnlockMetadataObject(vEnv);
@@ -911,6 +947,50 @@ bpfColorInfo bpfFileReaderBioformats::ReadColorInfo(bpfSize aChannel)
 }
 
 
+bool bpfFileReaderBioformats::SetDataBlockSize(bpfSize aDimension0, bpfSize aDimension1, bpfSize aDimension2, bpfSize aDimension3, bpfSize aDimension4, bpfSize aResolutionLevel)
+{
+  // bioformats delivers (parts of) single planes, only the tiling in X and Y can be chosen
+  if (aDimension0 == 0 || aDimension1 == 0 || aDimension2 != 1 || aDimension3 != GetDataBlockSize(C) || aDimension4 != 1) {
+    return false;
+  }
+  if (aResolutionLevel >= GetNumberOfResolutions()) {
+    return false;
+  }
+
+  mTileSizes[aResolutionLevel] = std::make_pair(aDimension0, aDimension1);
+  ResetSeriesInfo();
+  return true;
+}
+
+
+bool bpfFileReaderBioformats::SetCropLimits(const std::vector<bpfSize>& aMin, const std::vector<bpfSize>& aMax)
+{
+  if (aMin.size() != 5 || aMax.size() != 5) {
+    return false;
+  }
+
+  auto vEnv = bpfJNI::GetEnv();
+
+  // remember the uncropped size of the full resolution, the limits refer to it
+  mCropMin.clear();
+  mCropMax.clear();
+  bpfSize vResolutionLevel = GetActiveResolutionLevel();
+  if (vResolutionLevel != 0) {
+    SetActiveResolutionLevel(0);
+  }
+  ResetSeriesInfo();
+  mCropReferenceSize = GetSeriesInfo(vEnv).mCropMax;
+  if (vResolutionLevel != 0) {
+    SetActiveResolutionLevel(vResolutionLevel);
+  }
+
+  mCropMin = aMin;
+  mCropMax = aMax;
+  ResetSeriesInfo();
+  return true;
+}
+
+
 bool bpfFileReaderBioformats::ShouldColorRangeBeAdjustedToMinMax()
 {
   bpfNumberType vDataType = GetDataType();
@@ -923,7 +1003,9 @@ bool bpfFileReaderBioformats::ShouldColorRangeBeAdjustedToMinMax()
 
 bpfSectionContainer bpfFileReaderBioformats::ReadParametersImpl()
 {
+  bpfTraceScope vTrace(mTraceRecorder.get(), "metadata mapping");
   auto vEnv = bpfJNI::GetEnv();
+  bpfJNILocalFrame vFrame(vEnv);
   LockImageReaderObject(vEnv);
   LockMetadataObject(vEnv);
 
@@ -958,6 +1040,7 @@ bpfSectionContainer bpfFileReaderBioformats::ReadParametersImpl()
   bpfSize vChannelSize = GetEffectiveSizeC(vEnv);
 
   for (bpfSize vChannel = 0; vChannel < vChannelSize; vChannel++) {
+    bpfJNILocalFrame vChannelFrame(vEnv);
     bpfParameterSection* channelSection = vSectionContainer.CreateSection("Channel " + bpfToString(vChannel));
 
     // call getChannelPinholeSize(int imageIndex, int channelIndex), returns Length
@@ -1071,6 +1154,300 @@ bpfFloat bpfFileReaderBioformats::GetFloatFromLength(jobject aLength, JNIEnv* aE
 }
 
 
+const bpfFileReaderBioformats::cMethodIds& bpfFileReaderBioformats::GetMethodIds(JNIEnv* aEnv) const
+{
+  if (mMethodIds) {
+    return *mMethodIds;
+  }
+
+  auto vMethodIds = bpfMakeUniquePtr<cMethodIds>();
+
+  // use class loci.formats.FormatTools, kept as global reference for the static calls
+  jclass vFormatTools(aEnv->FindClass("loci/formats/FormatTools"));
+  bpfJNISanityCheck(vFormatTools, "vFormatTools");
+  vMethodIds->mFormatToolsClass = (jclass)aEnv->NewGlobalRef(vFormatTools);
+  aEnv->DeleteLocalRef(vFormatTools);
+  bpfJNISanityCheck();
+
+  vMethodIds->mGetBytesPerPixel = aEnv->GetStaticMethodID(vMethodIds->mFormatToolsClass, "getBytesPerPixel", "(I)I");
+  bpfJNISanityCheck(vMethodIds->mGetBytesPerPixel, "getBytesPerPixel");
+  vMethodIds->mGetPixelTypeString = aEnv->GetStaticMethodID(vMethodIds->mFormatToolsClass, "getPixelTypeString", "(I)Ljava/lang/String;");
+  bpfJNISanityCheck(vMethodIds->mGetPixelTypeString, "getPixelTypeString");
+
+  auto vGetMethodId = [this, aEnv](const char* aName, const char* aSignature) {
+    jmethodID vMethodId = aEnv->GetMethodID(mImageReaderClass, aName, aSignature);
+    bpfJNISanityCheck(vMethodId, aName);
+    return vMethodId;
+  };
+
+  vMethodIds->mGetPixelType = vGetMethodId("getPixelType", "()I");
+  vMethodIds->mIsLittleEndian = vGetMethodId("isLittleEndian", "()Z");
+  vMethodIds->mIsInterleaved = vGetMethodId("isInterleaved", "()Z");
+  vMethodIds->mGetRGBChannelCount = vGetMethodId("getRGBChannelCount", "()I");
+  vMethodIds->mGetDimensionOrder = vGetMethodId("getDimensionOrder", "()Ljava/lang/String;");
+  vMethodIds->mGetSizeX = vGetMethodId("getSizeX", "()I");
+  vMethodIds->mGetSizeY = vGetMethodId("getSizeY", "()I");
+  vMethodIds->mGetSizeZ = vGetMethodId("getSizeZ", "()I");
+  vMethodIds->mGetSizeC = vGetMethodId("getSizeC", "()I");
+  vMethodIds->mGetSizeT = vGetMethodId("getSizeT", "()I");
+  vMethodIds->mOpenBytes = vGetMethodId("openBytes", "(I[BIIII)[B");
+  vMethodIds->mGetOptimalTileWidth = vGetMethodId("getOptimalTileWidth", "()I");
+  vMethodIds->mGetOptimalTileHeight = vGetMethodId("getOptimalTileHeight", "()I");
+  vMethodIds->mGetSeries = vGetMethodId("getSeries", "()I");
+  vMethodIds->mSetSeries = vGetMethodId("setSeries", "(I)V");
+  vMethodIds->mGetResolution = vGetMethodId("getResolution", "()I");
+  vMethodIds->mSetResolution = vGetMethodId("setResolution", "(I)V");
+
+  mMethodIds = std::move(vMethodIds);
+  return *mMethodIds;
+}
+
+
+void bpfFileReaderBioformats::ResetMethodIds(JNIEnv* aEnv)
+{
+  if (mMethodIds) {
+    aEnv->DeleteGlobalRef(mMethodIds->mFormatToolsClass);
+    bpfJNISanityCheck();
+    mMethodIds.reset();
+  }
+}
+
+
+const bpfFileReaderBioformats::cSeriesInfo& bpfFileReaderBioformats::GetSeriesInfo(JNIEnv* aEnv)
+{
+  if (mSeriesInfo) {
+    return *mSeriesInfo;
+  }
+
+  const cMethodIds& vIds = GetMethodIds(aEnv);
+  auto vInfo = bpfMakeUniquePtr<cSeriesInfo>();
+
+  // call ImageReader.getPixelType()
+  jint vPixelType(aEnv->CallIntMethod(mImageReaderObject, vIds.mGetPixelType));
+  bpfJNISanityCheck();
+
+  // call FormatTools.getPixelTypeString(int pixelType)
+  jstring vPixelTypeString((jstring)aEnv->CallStaticObjectMethod(vIds.mFormatToolsClass, vIds.mGetPixelTypeString, vPixelType));
+  bpfJNISanityCheck(vPixelTypeString, "vPixelTypeString");
+  vInfo->mPixelType = ConvertString(vPixelTypeString, aEnv);
+  aEnv->DeleteLocalRef(vPixelTypeString);
+  bpfJNISanityCheck();
+  vInfo->mDataType = ConvertPixelType(vInfo->mPixelType, aEnv);
+  vInfo->mSourceType = ConvertPixelTypeToSourceType(vInfo->mPixelType);
+
+  // call FormatTools.getBytesPerPixel(int pixelType), returns int, is static
+  jint vBytesPerPixel(aEnv->CallStaticIntMethod(vIds.mFormatToolsClass, vIds.mGetBytesPerPixel, vPixelType));
+  bpfJNISanityCheck();
+  vInfo->mBytesPerPixel = static_cast<bpfSize>(vBytesPerPixel);
+
+  vInfo->mLittleEndian = aEnv->CallBooleanMethod(mImageReaderObject, vIds.mIsLittleEndian) != JNI_FALSE;
+  bpfJNISanityCheck();
+  vInfo->mInterleaved = aEnv->CallBooleanMethod(mImageReaderObject, vIds.mIsInterleaved) != JNI_FALSE;
+  bpfJNISanityCheck();
+
+  jint vRGBChannelCount(aEnv->CallIntMethod(mImageReaderObject, vIds.mGetRGBChannelCount));
+  bpfJNISanityCheck();
+
+  // call ImageReader.getDimensionOrder(), returns e.g. XYCTZ (XY always first), always all 5 dimensions are included
+  jstring vDimensionOrder((jstring)aEnv->CallObjectMethod(mImageReaderObject, vIds.mGetDimensionOrder));
+  bpfJNISanityCheck(vDimensionOrder, "vDimensionOrder");
+  bpfString vDimensions = ConvertString(vDimensionOrder, aEnv);
+  aEnv->DeleteLocalRef(vDimensionOrder);
+  bpfJNISanityCheck();
+
+  // interleaved channels are stored next to each other, i.e. C is the fastest dimension
+  if (vInfo->mInterleaved) {
+    vDimensions.erase(std::remove(vDimensions.begin(), vDimensions.end(), 'C'), vDimensions.end());
+    vDimensions.insert(vDimensions.begin(), 'C');
+  }
+
+  std::vector<bpfSize> vSize(5, 1);
+  std::vector<bpfSize> vBlockSize(5, 1);
+  for (char vDimension : vDimensions) {
+    Dimension vDim;
+    jmethodID vGetSize;
+    if (vDimension == 'X') {
+      vDim = X;
+      vGetSize = vIds.mGetSizeX;
+    }
+    else if (vDimension == 'Y') {
+      vDim = Y;
+      vGetSize = vIds.mGetSizeY;
+    }
+    else if (vDimension == 'Z') {
+      vDim = Z;
+      vGetSize = vIds.mGetSizeZ;
+    }
+    else if (vDimension == 'C') {
+      vDim = C;
+      vGetSize = vIds.mGetSizeC;
+    }
+    else if (vDimension == 'T') {
+      vDim = T;
+      vGetSize = vIds.mGetSizeT;
+    }
+    else {
+      continue;
+    }
+
+    jint vJSize(aEnv->CallIntMethod(mImageReaderObject, vGetSize));
+    bpfJNISanityCheck();
+    vSize[vDim] = static_cast<bpfSize>(vJSize);
+
+    // bioformats blocks are in general XY planes, except if image is interleaved or
+    // if RGBChannelCount > 1
+    if (vDim == X || vDim == Y) {
+      vBlockSize[vDim] = vSize[vDim];
+    }
+    else if (vDim == C && (vInfo->mInterleaved || vRGBChannelCount > 1)) {
+      vBlockSize[vDim] = static_cast<bpfSize>(vRGBChannelCount);
+    }
+
+    vInfo->mDimensionSequence.push_back(vDim);
+  }
+
+  vInfo->mCropMin.assign(5, 0);
+  vInfo->mCropMax = vSize;
+  if (!mCropMin.empty()) {
+    for (bpfSize vDim = 0; vDim < 5; vDim++) {
+      bpfSize vReference = mCropReferenceSize[vDim];
+      bpfSize vMin = mCropMin[vDim];
+      bpfSize vMax = mCropMax[vDim] == 0 ? vReference : mCropMax[vDim];
+      // the limits refer to the full resolution, scale them to the active level
+      if (vDim <= Z && vReference > 0 && vReference != vSize[vDim]) {
+        vMin = vMin * vSize[vDim] / vReference;
+        vMax = (vMax * vSize[vDim] + vReference - 1) / vReference;
+      }
+      // channels delivered together in one block (rgb) are kept together
+      bpfSize vAlign = (vDim == X || vDim == Y) ? 1 : vBlockSize[vDim];
+      vMin = vMin / vAlign * vAlign;
+      vMax = (vMax + vAlign - 1) / vAlign * vAlign;
+      vMax = std::min(vMax, vSize[vDim]);
+      if (vMin >= vMax) {
+        vMin = vMax >= vAlign ? vMax - vAlign : 0;
+      }
+      vInfo->mCropMin[vDim] = vMin;
+      vInfo->mCropMax[vDim] = vMax;
+    }
+  }
+  GetTileSize(aEnv, vInfo->mCropMax[X] - vInfo->mCropMin[X], vInfo->mCropMax[Y] - vInfo->mCropMin[Y], vBlockSize[X], vBlockSize[Y]);
+
+  // bioformats numbers the planes in dimension order over the full (uncropped) image
+  vInfo->mPlaneStride.assign(5, 0);
+  bpfSize vPlaneStride = 1;
+  for (Dimension vDim : vInfo->mDimensionSequence) {
+    vInfo->mDataSizeV.push_back(vInfo->mCropMax[vDim] - vInfo->mCropMin[vDim]);
+    vInfo->mDataBlockSizeV.push_back(vBlockSize[vDim]);
+    if (vDim != X && vDim != Y) {
+      vInfo->mPlaneStride[vDim] = vPlaneStride;
+      vPlaneStride *= vSize[vDim] / vBlockSize[vDim];
+    }
+  }
+
+  mSeriesInfo = std::move(vInfo);
+  return *mSeriesInfo;
+}
+
+
+void bpfFileReaderBioformats::ResetSeriesInfo()
+{
+  mSeriesInfo.reset();
+}
+
+
+bpfSize bpfFileReaderBioformats::GetPlaneOfBlock(const cSeriesInfo& aInfo, bpfSize aBlockNumber, bpfSize& aStartX, bpfSize& aStartY) const
+{
+  // blocks are numbered in dimension order over the cropped image
+  bpfSize vPlane = 0;
+  bpfSize vRemainder = aBlockNumber;
+  for (bpfSize vIndex = 0; vIndex < aInfo.mDimensionSequence.size(); vIndex++) {
+    Dimension vDim = aInfo.mDimensionSequence[vIndex];
+    bpfSize vBlockSize = aInfo.mDataBlockSizeV[vIndex];
+    bpfSize vNumberOfBlocks = (aInfo.mDataSizeV[vIndex] + vBlockSize - 1) / vBlockSize;
+    bpfSize vStart = aInfo.mCropMin[vDim] + (vRemainder % vNumberOfBlocks) * vBlockSize;
+    vRemainder /= vNumberOfBlocks;
+
+    if (vDim == X) {
+      aStartX = vStart;
+    }
+    else if (vDim == Y) {
+      aStartY = vStart;
+    }
+    else {
+      vPlane += vStart / vBlockSize * aInfo.mPlaneStride[vDim];
+    }
+  }
+  return vPlane;
+}
+
+
+void bpfFileReaderBioformats::GetTileSize(JNIEnv* aEnv, bpfSize aSizeX, bpfSize aSizeY, bpfSize& aTileSizeX, bpfSize& aTileSizeY)
+{
+  auto vTileSizeIt = mTileSizes.find(GetActiveResolutionLevel());
+  if (vTileSizeIt != mTileSizes.end()) {
+    aTileSizeX = vTileSizeIt->second.first;
+    aTileSizeY = vTileSizeIt->second.second;
+    return;
+  }
+
+  aTileSizeX = aSizeX;
+  aTileSizeY = aSizeY;
+  if (aSizeX * aSizeY <= gMaxPlaneSizeWithoutTiles) {
+    return;
+  }
+
+  // call ImageReader.getOptimalTileWidth() and getOptimalTileHeight(), return int
+  const cMethodIds& vIds = GetMethodIds(aEnv);
+  jint vOptimalSizeX(aEnv->CallIntMethod(mImageReaderObject, vIds.mGetOptimalTileWidth));
+  bpfJNISanityCheck();
+  jint vOptimalSizeY(aEnv->CallIntMethod(mImageReaderObject, vIds.mGetOptimalTileHeight));
+  bpfJNISanityCheck();
+
+  // use as many tiles of the file as fit into the preferred size, but at least one
+  auto vGetTileSize = [](jint aOptimalSize, bpfSize aSize) {
+    bpfSize vOptimalSize = aOptimalSize > 0 ? static_cast<bpfSize>(aOptimalSize) : gPreferredTileSize;
+    bpfSize vTileSize = gPreferredTileSize;
+    if (vOptimalSize <= gMaxTileSize) {
+      vTileSize = std::max(gPreferredTileSize / vOptimalSize, static_cast<bpfSize>(1)) * vOptimalSize;
+    }
+    return std::min(vTileSize, aSize);
+  };
+  aTileSizeX = vGetTileSize(vOptimalSizeX, aSizeX);
+  aTileSizeY = vGetTileSize(vOptimalSizeY, aSizeY);
+}
+
+
+jbyteArray bpfFileReaderBioformats::GetBlockBytes(JNIEnv* aEnv, jsize aSize)
+{
+  if (mBlockBytes && mBlockBytesSize == aSize) {
+    return mBlockBytes;
+  }
+
+  // block size changed (other series or resolution level), replace the array
+  ResetBlockBytes(aEnv);
+
+  jbyteArray vBlockBytes(aEnv->NewByteArray(aSize));
+  bpfJNISanityCheck(vBlockBytes, "vBlockBytes");
+  mBlockBytes = (jbyteArray)aEnv->NewGlobalRef(vBlockBytes);
+  mBlockBytesSize = aSize;
+  aEnv->DeleteLocalRef(vBlockBytes);
+  bpfJNISanityCheck();
+
+  return mBlockBytes;
+}
+
+
+void bpfFileReaderBioformats::ResetBlockBytes(JNIEnv* aEnv)
+{
+  if (mBlockBytes) {
+    aEnv->DeleteGlobalRef(mBlockBytes);
+    bpfJNISanityCheck();
+    mBlockBytes = nullptr;
+    mBlockBytesSize = 0;
+  }
+}
+
+
 bpfSize bpfFileReaderBioformats::GetSizeOfDimension(const bpfString& aMethodName, JNIEnv* aEnv)
 {
   // call ImageReader.getSizeX(), getSizeY(), getSizeZ(), getSizeC(), getSizeT()
@@ -1170,31 +1547,41 @@ bpfNumberType bpfFileReaderBioformats::ConvertPixelType(bpfString aPixelType, JN
 }
 
 
-bpfString bpfFileReaderBioformats::GetPixelTypeString(JNIEnv* aEnv)
+bpfNumberType bpfFileReaderBioformats::ConvertPixelTypeToSourceType(const bpfString& aPixelType)
 {
-  // call ImageReader.getPixelType()
-  jmethodID vGetPixelType = aEnv->GetMethodID(mImageReaderClass, "getPixelType", "()I");
-  bpfJNISanityCheck(vGetPixelType, "vGetPixelType");
-  jint vPixelTypeInt(aEnv->CallIntMethod(mImageReaderObject, vGetPixelType));
-  bpfJNISanityCheck();
-
-  // use class loci.formats.FormatTools
-  jclass vFormatTools(aEnv->FindClass("loci/formats/FormatTools"));
-  bpfJNISanityCheck(vFormatTools, "vFormatTools");
-
-  // call FormatTools.getPixelTypeString(int pixelType)
-  jmethodID vGetPixelTypeString = aEnv->GetStaticMethodID(vFormatTools, "getPixelTypeString", "(I)Ljava/lang/String;");
-  bpfJNISanityCheck(vGetPixelTypeString, "vGetPixelTypeString");
-  jstring vPixelTypeString((jstring)aEnv->CallStaticObjectMethod(vFormatTools, vGetPixelTypeString, vPixelTypeInt));
-  bpfJNISanityCheck(vPixelTypeString, "vPixelTypeString");
+  if (aPixelType == "int8") {
+    return bpfInt8Type;
+  }
+  else if (aPixelType == "uint8") {
+    return bpfUInt8Type;
+  }
+  else if (aPixelType == "int16") {
+    return bpfInt16Type;
+  }
+  else if (aPixelType == "uint16") {
+    return bpfUInt16Type;
+  }
+  else if (aPixelType == "int32") {
+    return bpfInt32Type;
+  }
+  else if (aPixelType == "uint32") {
+    return bpfUInt32Type;
+  }
+  else if (aPixelType == "float") {
+    return bpfFloatType;
+  }
+  else if (aPixelType == "double") {
+    return bpfDoubleType;
+  }
+  else {
+    return bpfNoType;
+  }
+}
 
-  bpfString vPixelType = ConvertString(vPixelTypeString, aEnv);
 
-  aEnv->DeleteLocalRef(vPixelTypeString);
-  bpfJNISanityCheck();
-  aEnv->DeleteLocalRef(vFormatTools);
-  bpfJNISanityCheck();
-  return vPixelType;
+bpfString bpfFileReaderBioformats::GetPixelTypeString(JNIEnv* aEnv)
+{
+  return GetSeriesInfo(aEnv).mPixelType;
 }
 
 
@@ -1389,9 +1776,7 @@ std::vector<bpfColor> bpfFileReaderBioformats::GetColorTable16Bit(JNIEnv* aEnv)
 bpfSize bpfFileReaderBioformats::GetRGBChannelCount(JNIEnv* aEnv)
 {
   // call ImageReader.getRGBChannelCount() 
-  jmethodID vGetRGBChannelCount = aEnv->GetMethodID(mImageReaderClass, "getRGBChannelCount", "()I");
-  bpfJNISanityCheck(vGetRGBChannelCount, "vGetRGBChannelCount");
-  jint vJRGBChannelCount(aEnv->CallIntMethod(mImageReaderObject, vGetRGBChannelCount));
+  jint vJRGBChannelCount(aEnv->CallIntMethod(mImageReaderObject, GetMethodIds(aEnv).mGetRGBChannelCount));
   bpfJNISanityCheck();
   bpfSize vRGBChannelCount = static_cast<bpfSize>(vJRGBChannelCount);
 
@@ -1401,13 +1786,7 @@ bpfSize bpfFileReaderBioformats::GetRGBChannelCount(JNIEnv* aEnv)
 
 bool bpfFileReaderBioformats::IsInterleaved(JNIEnv* aEnv)
 {
-  // call  ImageReader.isInterleaved(), returns boolean
-  jmethodID vGetIsInterleaved = aEnv->GetMethodID(mImageReaderClass, "isInterleaved", "()Z");
-  bpfJNISanityCheck(vGetIsInterleaved, "vGetIsInterleaved");
-  jboolean vIsInterleaved(aEnv->CallBooleanMethod(mImageReaderObject, vGetIsInterleaved));
-  bpfJNISanityCheck();
-
-  return vIsInterleaved;
+  return GetSeriesInfo(aEnv).mInterleaved;
 }
 
 
@@ -1494,74 +1873,165 @@ void bpfFileReaderBioformats::MapSeriesMetadata(bpfParameterSection* aParameterS
 
 void bpfFileReaderBioformats::MapMetadataParameters(jobject aMetadata, bpfParameterSection* aParameterSection, JNIEnv* aEnv)
 {
+  // files like lif, czi or nd2 have 100k entries and more. Instead of a few JNI calls per entry,
+  // the keys and the values of a chunk of entries are joined into one string each on the java side
+  // with String.format("%s\1%s\1...", entries) and split here.
+  const bpfSize vChunkSize = 4096;
+  const char vDelimiter = '\1';
+
   // use class java.utils.Hashtable<K,V>
   jclass vJHashtable(aEnv->FindClass("java/util/Hashtable"));
   bpfJNISanityCheck(vJHashtable, "vJHashtable");
-
-  // map hashtable content to map
-  // get Hashtable.keySet(), then use Set.toArray() to get array with all keys
-  // then iterate through keys and use use Hashtable.get(Object key), returns value
-  // convert returned object into string with toString method
-
-  // call Hashtable.keySet(), returns Set<K>, java.util.Set<E>
   jmethodID vGetKeySet = aEnv->GetMethodID(vJHashtable, "keySet", "()Ljava/util/Set;");
   bpfJNISanityCheck(vGetKeySet, "vGetKeySet");
-  jobject vGlobalMetadataKeySet(aEnv->CallObjectMethod(aMetadata, vGetKeySet));
-  bpfJNISanityCheck(vGlobalMetadataKeySet, "vGlobalMetadataKeySet");
-
-  // use class java.util.Set<E>
-  jclass vJSet(aEnv->FindClass("java/util/Set"));
-  bpfJNISanityCheck(vJSet, "vJSet");
-
-  // call Set.toArray(), returns Object[] (keySet is array of Strings for Global Metadata)
-  jmethodID vToArray = aEnv->GetMethodID(vJSet, "toArray", "()[Ljava/lang/Object;");
+  jmethodID vGetValues = aEnv->GetMethodID(vJHashtable, "values", "()Ljava/util/Collection;");
+  bpfJNISanityCheck(vGetValues, "vGetValues");
+  jmethodID vGetMetadataValue = aEnv->GetMethodID(vJHashtable, "get", "(Ljava/lang/Object;)Ljava/lang/Object;");
+  bpfJNISanityCheck(vGetMetadataValue, "vGetMetadataValue");
+
+  // use class java.util.Collection<E> for the key set and the values
+  jclass vJCollection(aEnv->FindClass("java/util/Collection"));
+  bpfJNISanityCheck(vJCollection, "vJCollection");
+  jmethodID vToArray = aEnv->GetMethodID(vJCollection, "toArray", "()[Ljava/lang/Object;");
   bpfJNISanityCheck(vToArray, "vToArray");
-  jobjectArray vGlobalMetadataKeyArray((jobjectArray)aEnv->CallObjectMethod(vGlobalMetadataKeySet, vToArray));
-  bpfJNISanityCheck(vGlobalMetadataKeyArray, "vGlobalMetadataKeyArray");
 
   // use class java.lang.Object
   jclass vObjectClass(aEnv->FindClass("java/lang/Object"));
   bpfJNISanityCheck(vObjectClass, "vObjectClass");
+  jmethodID vToString = aEnv->GetMethodID(vObjectClass, "toString", "()Ljava/lang/String;");
+  bpfJNISanityCheck(vToString, "vToString");
 
-  bpfSize vArrayLength = aEnv->GetArrayLength(vGlobalMetadataKeyArray);
-  bpfJNISanityCheck();
-  for (bpfSize vIndex = 0; vIndex < vArrayLength; vIndex++) {
-    jstring vGlobalMetadataKey = (jstring)aEnv->GetObjectArrayElement(vGlobalMetadataKeyArray, vIndex);
-    bpfJNISanityCheck(vGlobalMetadataKey, "vGlobalMetadataKey");
+  // static String.format(String format, Object... args) and Arrays.copyOfRange(Object[] original, int from, int to)
+  jclass vJString(aEnv->FindClass("java/lang/String"));
+  bpfJNISanityCheck(vJString, "vJString");
+  jmethodID vFormat = aEnv->GetStaticMethodID(vJString, "format", "(Ljava/lang/String;[Ljava/lang/Object;)Ljava/lang/String;");
+  bpfJNISanityCheck(vFormat, "vFormat");
+  jclass vJArrays(aEnv->FindClass("java/util/Arrays"));
+  bpfJNISanityCheck(vJArrays, "vJArrays");
+  jmethodID vCopyOfRange = aEnv->GetStaticMethodID(vJArrays, "copyOfRange", "([Ljava/lang/Object;II)[Ljava/lang/Object;");
+  bpfJNISanityCheck(vCopyOfRange, "vCopyOfRange");
+
+  // the key set and the values of a Hashtable are iterated in the same order
+  jobject vKeySet(aEnv->CallObjectMethod(aMetadata, vGetKeySet));
+  bpfJNISanityCheck(vKeySet, "vKeySet");
+  jobjectArray vKeyArray((jobjectArray)aEnv->CallObjectMethod(vKeySet, vToArray));
+  bpfJNISanityCheck(vKeyArray, "vKeyArray");
+  jobject vValues(aEnv->CallObjectMethod(aMetadata, vGetValues));
+  bpfJNISanityCheck(vValues, "vValues");
+  jobjectArray vValueArray((jobjectArray)aEnv->CallObjectMethod(vValues, vToArray));
+  bpfJNISanityCheck(vValueArray, "vValueArray");
+
+  bpfSize vArrayLength = aEnv->GetArrayLength(vKeyArray);
+  bpfJNISanityCheck();
+  bool vSameLength = static_cast<bpfSize>(aEnv->GetArrayLength(vValueArray)) == vArrayLength;
+  bpfJNISanityCheck();
+
+  // returns the strings of the elements [aBegin, aEnd) of aArray, more (up to vCount + 1) if one contains the delimiter
+  bpfString vFormatString;
+  auto vGetStrings = [&](jobjectArray aArray, bpfSize aBegin, bpfSize aEnd) {
+    bpfSize vCount = aEnd - aBegin;
+    if (vFormatString.size() != 3 * vCount - 1) {
+      vFormatString.clear();
+      for (bpfSize vIndex = 0; vIndex < vCount; vIndex++) {
+        vFormatString += vIndex == 0 ? "%s" : bpfString(1, vDelimiter) + "%s";
+      }
+    }
+
+    jobjectArray vChunk = aArray;
+    if (vCount != vArrayLength) {
+      vChunk = (jobjectArray)aEnv->CallStaticObjectMethod(vJArrays, vCopyOfRange, aArray, static_cast<jint>(aBegin), static_cast<jint>(aEnd));
+      bpfJNISanityCheck(vChunk, "vChunk");
+    }
+    jstring vJFormatString = aEnv->NewStringUTF(vFormatString.c_str());
+    bpfJNISanityCheck(vJFormatString, "vJFormatString");
+    jstring vJoined = (jstring)aEnv->CallStaticObjectMethod(vJString, vFormat, vJFormatString, vChunk);
+    bpfJNISanityCheck(vJoined, "vJoined");
+    bpfString vJoinedString = ConvertString(vJoined, aEnv);
+
+    aEnv->DeleteLocalRef(vJoined);
+    bpfJNISanityCheck();
+    aEnv->DeleteLocalRef(vJFormatString);
+    bpfJNISanityCheck();
+    if (vChunk != aArray) {
+      aEnv->DeleteLocalRef(vChunk);
+      bpfJNISanityCheck();
+    }
+
+    std::vector<bpfString> vStrings;
+    vStrings.reserve(vCount);
+    bpfSize vStart = 0;
+    bpfSize vEnd = vJoinedString.find(vDelimiter);
+    while (vEnd != bpfString::npos && vStrings.size() < vCount) {
+      vStrings.emplace_back(vJoinedString, vStart, vEnd - vStart);
+      vStart = vEnd + 1;
+      vEnd = vJoinedString.find(vDelimiter, vStart);
+    }
+    vStrings.emplace_back(vJoinedString, vStart);
+    return vStrings;
+  };
+
+  for (bpfSize vBegin = 0; vBegin < vArrayLength; vBegin += vChunkSize) {
+    // the references of a chunk are released with it, also if a call throws
+    bpfJNILocalFrame vChunkFrame(aEnv);
+    bpfSize vEnd = std::min(vBegin + vChunkSize, vArrayLength);
+    bpfSize vCount = vEnd - vBegin;
+
+    std::vector<bpfString> vKeys;
+    std::vector<bpfString> vValueStrings;
+    if (vSameLength) {
+      vKeys = vGetStrings(vKeyArray, vBegin, vEnd);
+      vValueStrings = vGetStrings(vValueArray, vBegin, vEnd);
+    }
+    if (vKeys.size() == vCount && vValueStrings.size() == vCount) {
+      for (bpfSize vIndex = 0; vIndex < vCount; vIndex++) {
+        aParameterSection->SetParameter(vKeys[vIndex], vValueStrings[vIndex]);
+      }
+      continue;
+    }
 
-    bpfString vKey = ConvertString(vGlobalMetadataKey, aEnv);
+    // a key or value contains the delimiter, look up the entries of the chunk one by one
+    for (bpfSize vIndex = vBegin; vIndex < vEnd; vIndex++) {
+      jstring vGlobalMetadataKey = (jstring)aEnv->GetObjectArrayElement(vKeyArray, vIndex);
+      bpfJNISanityCheck(vGlobalMetadataKey, "vGlobalMetadataKey");
 
-    // call Hashtable.get(Object key), returns V (java Object)
-    jmethodID vGetMetadataValue = aEnv->GetMethodID(vJHashtable, "get", "(Ljava/lang/Object;)Ljava/lang/Object;");
-    bpfJNISanityCheck(vGetMetadataValue, "vGetMetadataValue");
-    jobject vGlobalMetadataValue(aEnv->CallObjectMethod(aMetadata, vGetMetadataValue, vGlobalMetadataKey));
-    bpfJNISanityCheck(vGlobalMetadataValue, "vGlobalMetadataValue");
+      bpfString vKey = ConvertString(vGlobalMetadataKey, aEnv);
 
-    // call Object.toString(), returns String
-    jmethodID vToString = aEnv->GetMethodID(vObjectClass, "toString", "()Ljava/lang/String;");
-    bpfJNISanityCheck(vToString, "vToString");
-    jstring vMetadataValueString((jstring)aEnv->CallObjectMethod(vGlobalMetadataValue, vToString));
-    bpfJNISanityCheck(vMetadataValueString, "vMetadataValueString");
+      // call Hashtable.get(Object key), returns V (java Object)
+      jobject vGlobalMetadataValue(aEnv->CallObjectMethod(aMetadata, vGetMetadataValue, vGlobalMetadataKey));
+      bpfJNISanityCheck(vGlobalMetadataValue, "vGlobalMetadataValue");
 
-    bpfString vValue = ConvertString(vMetadataValueString, aEnv);
+      // call Object.toString(), returns String
+      jstring vMetadataValueString((jstring)aEnv->CallObjectMethod(vGlobalMetadataValue, vToString));
+      bpfJNISanityCheck(vMetadataValueString, "vMetadataValueString");
 
-    aParameterSection->SetParameter(vKey, vValue);
+      bpfString vValue = ConvertString(vMetadataValueString, aEnv);
 
-    aEnv->DeleteLocalRef(vMetadataValueString);
-    bpfJNISanityCheck();
-    aEnv->DeleteLocalRef(vGlobalMetadataValue);
-    bpfJNISanityCheck();
-    aEnv->DeleteLocalRef(vGlobalMetadataKey);
-    bpfJNISanityCheck();
+      aParameterSection->SetParameter(vKey, vValue);
+
+      aEnv->DeleteLocalRef(vMetadataValueString);
+      bpfJNISanityCheck();
+      aEnv->DeleteLocalRef(vGlobalMetadataValue);
+      bpfJNISanityCheck();
+      aEnv->DeleteLocalRef(vGlobalMetadataKey);
+      bpfJNISanityCheck();
+    }
   }
 
-  aEnv->DeleteLocalRef(vGlobalMetadataKeyArray);
+  aEnv->DeleteLocalRef(vValueArray);
   bpfJNISanityCheck();
-  aEnv->DeleteLocalRef(vObjectClass);
+  aEnv->DeleteLocalRef(vValues);
   bpfJNISanityCheck();
-  aEnv->DeleteLocalRef(vJSet);
+  aEnv->DeleteLocalRef(vKeyArray);
+  bpfJNISanityCheck();
+  aEnv->DeleteLocalRef(vKeySet);
+  bpfJNISanityCheck();
+  aEnv->DeleteLocalRef(vJArrays);
+  bpfJNISanityCheck();
+  aEnv->DeleteLocalRef(vJString);
+  bpfJNISanityCheck();
+  aEnv->DeleteLocalRef(vObjectClass);
   bpfJNISanityCheck();
-  aEnv->DeleteLocalRef(vGlobalMetadataKeySet);
+  aEnv->DeleteLocalRef(vJCollection);
   bpfJNISanityCheck();
   aEnv->DeleteLocalRef(vJHashtable);
   bpfJNISanityCheck();
@@ -21,6 +21,7 @@
 #define __BP_FILE_READER_BIOFORMATS__
 
 #include "fileiobioformats/application/bpFileIOBioformatsDllAPI.h"
+#include "fileiobase/application/bpfFileReaderImplFactoryBase.h"
 #include "fileiobase/readers/bpfFileReaderImpl.h"
 #include "fileiobase/types/bpfParameterSection.h"
 #include "fileiobase/types/bpfSmartPtr.h"
@@ -38,7 +39,11 @@ class BP_FILEIOBIOFORMATS_DLL_API bpfFileReaderBioformats : public bpfFileReader
 
 public:
 
-  bpfFileReaderBioformats(const bpfString& aFilename);
+  bpfFileReaderBioformats(const bpfString& aFilename,
+                          bpfFileReaderImplFactoryBase::tMetadataLevel aMetadataLevel = bpfFileReaderImplFactoryBase::eMetadataLevelAll,
+                          const bpfString& aMemoDirectory = "",
+                          bpfSize aMemoMinimumElapsed = 0,
+                          const bpfSharedPtr<bpfTraceRecorder>& aTraceRecorder = nullptr);
   ~bpfFileReaderBioformats();
 
 
@@ -65,6 +70,9 @@ public:
   std::vector<bpfSize> GetDataSizeV() override;
   std::vector<bpfSize> GetDataBlockSizeV() override;
 
+  bool SetDataBlockSize(bpfSize aDimension0, bpfSize aDimension1, bpfSize aDimension2, bpfSize aDimension3, bpfSize aDimension4, bpfSize aResolutionLevel) override;
+  bool SetCropLimits(const std::vector<bpfSize>& aMin, const std::vector<bpfSize>& aMax) override;
+
   void ReadDataBlock(void* aDataBlockMemory) override;
   void GoToDataBlock(bpfSize aBlockNumber) override;
   void GoToNextDataBlock() override;
@@ -83,9 +91,67 @@ protected:
 
 
 private:
+  // method ids of the reader, resolved once (until the reader class changes)
+  class cMethodIds
+  {
+  public:
+    jclass mFormatToolsClass = nullptr;
+    jmethodID mGetBytesPerPixel = nullptr;
+    jmethodID mGetPixelTypeString = nullptr;
+    jmethodID mGetPixelType = nullptr;
+    jmethodID mIsLittleEndian = nullptr;
+    jmethodID mIsInterleaved = nullptr;
+    jmethodID mGetRGBChannelCount = nullptr;
+    jmethodID mGetDimensionOrder = nullptr;
+    jmethodID mGetSizeX = nullptr;
+    jmethodID mGetSizeY = nullptr;
+    jmethodID mGetSizeZ = nullptr;
+    jmethodID mGetSizeC = nullptr;
+    jmethodID mGetSizeT = nullptr;
+    jmethodID mOpenBytes = nullptr;
+    jmethodID mGetOptimalTileWidth = nullptr;
+    jmethodID mGetOptimalTileHeight = nullptr;
+    jmethodID mGetSeries = nullptr;
+    jmethodID mSetSeries = nullptr;
+    jmethodID mGetResolution = nullptr;
+    jmethodID mSetResolution = nullptr;
+  };
+
+  // facts of the active series and resolution level, valid until one of them changes
+  class cSeriesInfo
+  {
+  public:
+    bpfString mPixelType;
+    bpfNumberType mDataType = bpfNoType;
+    bpfNumberType mSourceType = bpfNoType;
+    bpfSize mBytesPerPixel = 0;
+    bool mLittleEndian = true;
+    bool mInterleaved = false;
+    std::vector<Dimension> mDimensionSequence;
+    std::vector<bpfSize> mDataSizeV;
+    std::vector<bpfSize> mDataBlockSizeV;
+
+    // cropped region [mCropMin, mCropMax) of the planes in XYZCT
+    std::vector<bpfSize> mCropMin;
+    std::vector<bpfSize> mCropMax;
+    // plane number increment per block in Z, C and T (in XYZCT)
+    std::vector<bpfSize> mPlaneStride;
+  };
+
+  const cMethodIds& GetMethodIds(JNIEnv* aEnv) const;
+  void ResetMethodIds(JNIEnv* aEnv);
+  const cSeriesInfo& GetSeriesInfo(JNIEnv* aEnv);
+  void ResetSeriesInfo();
+  bpfSize GetPlaneOfBlock(const cSeriesInfo& aInfo, bpfSize aBlockNumber, bpfSize& aStartX, bpfSize& aStartY) const;
+  void GetTileSize(JNIEnv* aEnv, bpfSize aSizeX, bpfSize aSizeY, bpfSize& aTileSizeX, bpfSize& aTileSizeY);
+  jbyteArray GetBlockBytes(JNIEnv* aEnv, jsize aSize);
+  void ResetBlockBytes(JNIEnv* aEnv);
+
   void InitializeFileReader();
   void TryOpenAsSeries();
   void HandleMetadataOptions(JNIEnv* aEnv);
+  void UseMemoizer(JNIEnv* aEnv);
+  jobject GetImageReader(JNIEnv* aEnv) const;
 
   bpfString ConvertString(jstring aString, JNIEnv* aEnv) const;
   std::vector<bpfString> ConvertArrayOfStrings(jobjectArray aArrayOfStrings, JNIEnv* aEnv) const;
@@ -100,6 +166,7 @@ private:
   bpfString GetPixelsPhysicalSizeString(const bpfString& aMethodName, JNIEnv* aEnv);
 
   bpfNumberType ConvertPixelType(bpfString aPixelType, JNIEnv* aEnv);
+  bpfNumberType ConvertPixelTypeToSourceType(const bpfString& aPixelType);
   bpfString GetPixelTypeString(JNIEnv* aEnv);
 
   using tOptionalColor = bpfUniquePtr<bpfColor>;
@@ -123,11 +190,33 @@ private:
 
   bpfString mFileName;
   bpfSize mBlockNumber;
+  bpfFileReaderImplFactoryBase::tMetadataLevel mMetadataLevel;
+
+  // directory of the loci.formats.Memoizer wrapping the ImageReader, empty if not memoized
+  bpfString mMemoDirectory;
+  bpfSize mMemoMinimumElapsed;
+
+  bpfSharedPtr<bpfTraceRecorder> mTraceRecorder;
   
   jclass mImageReaderClass;
   jobject mImageReaderObject;
   jclass mMetadataClass;
   jobject mMetadataObject;
+
+  mutable bpfUniquePtr<cMethodIds> mMethodIds;
+  bpfUniquePtr<cSeriesInfo> mSeriesInfo;
+
+  // crop limits as requested (XYZCT, empty if not cropped) and the full resolution size they refer to
+  std::vector<bpfSize> mCropMin;
+  std::vector<bpfSize> mCropMax;
+  std::vector<bpfSize> mCropReferenceSize;
+
+  // XY block size per resolution level as set by SetDataBlockSize, chosen automatically otherwise
+  std::map<bpfSize, std::pair<bpfSize, bpfSize>> mTileSizes;
+
+  // java array reused by openBytes for every block of the same size
+  jbyteArray mBlockBytes;
+  jsize mBlockBytesSize;
 };
 
 #endif
\ No newline at end of file
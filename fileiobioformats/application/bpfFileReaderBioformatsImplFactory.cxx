@@ -25,7 +25,11 @@
 
 #include "fileiobioformats/java/bpfJNI.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
+#include <iterator>
+#include <sstream>
 
 
 bpfString ConvertString(jstring aString, JNIEnv* aEnv)
@@ -59,6 +63,8 @@ std::vector<bpfString> ConvertArrayOfStrings(jobjectArray aArrayOfStrings, JNIEn
 
 
 bpfFileReaderBioformatsImplFactory::bpfFileReaderBioformatsImplFactory()
+  : mMetadataLevel(eMetadataLevelAll),
+    mMemoMinimumElapsed(0)
 {
 
   // initialize JNI to read bioformats jar files
@@ -77,11 +83,21 @@ bpfFileReaderBioformatsImplFactory::bpfFileReaderBioformatsImplFactory()
   size_t vMemoryLimitMB = 8000;
   size_t vMemoryLimitJava = (vMemoryLimitMB * 1024 * 1024) * 0.8;
   bpfJNI::Init(vJVMFolder, vJars, vMemoryLimitJava);
+
+  // JVM options of the environment, separated by white space, e.g. "-XX:+UseSerialGC -XX:TieredStopAtLevel=1"
+  const char* vEnvironmentOptions = std::getenv("IMARISCONVERT_JVM_OPTIONS");
+  if (vEnvironmentOptions) {
+    std::istringstream vStream(vEnvironmentOptions);
+    std::vector<std::string> vOptions{ std::istream_iterator<std::string>(vStream), std::istream_iterator<std::string>() };
+    bpfJNI::AddOptions(vOptions);
+  }
 }
 
 
 bpfFileReaderBioformatsImplFactory::~bpfFileReaderBioformatsImplFactory()
 {
+  // the members are destroyed after the JVM, none of them may hold Java references
+  bpfJNI::Shutdown();
 }
 
 
@@ -189,10 +205,10 @@ void bpfFileReaderBioformatsImplFactory::GetSupportedBioformatsFormats(std::vect
 
 void bpfFileReaderBioformatsImplFactory::SetFileReaderImplVersion()
 {
-  if (mVersion.empty()) {
+  std::call_once(mVersionOnce, [this] {
     mVersion = GetBioformatsVersion();
     bpfFileReaderImpl::SetOriginalFormatFileIOVersion("ImarisFileIOBioFormats " + mVersion);
-  }
+  });
 }
 
 void  bpfFileReaderBioformatsImplFactory::SetSupportedBioformatsFormats()
@@ -243,17 +259,30 @@ std::vector<bpfString> bpfFileReaderBioformatsImplFactory::GetFormatExtensions(c
 
 bpfFileReaderImplInterface* bpfFileReaderBioformatsImplFactory::CreateFileReader(const bpfString& aFileName)
 {
-  return CreateFileReader(aFileName, GetFileFormat(aFileName));
+  // the reader finds the format itself, probing it first would open the file twice
+  return CreateFileReader(aFileName, bpfString());
 }
 
 
-bpfFileReaderImpl* CreateReaderImpl(const bpfString& aFileName, const bpfString& aFormatName)
+bpfFileReaderImpl* bpfFileReaderBioformatsImplFactory::CreateReaderImpl(const bpfString& aFileName)
 {
+  tMetadataLevel vMetadataLevel;
+  bpfString vMemoDirectory;
+  bpfSize vMemoMinimumElapsed;
+  bpfSharedPtr<bpfTraceRecorder> vTraceRecorder;
+  {
+    std::lock_guard<std::mutex> vLock(mReaderOptionsMutex);
+    vMetadataLevel = mMetadataLevel;
+    vMemoDirectory = mMemoDirectory;
+    vMemoMinimumElapsed = mMemoMinimumElapsed;
+    vTraceRecorder = mTraceRecorder;
+  }
+
   bpfFileReaderImpl* vReaderImpl = nullptr;
 
   if (!aFileName.empty()) {
     try {
-      vReaderImpl = new bpfFileReaderBioformats(aFileName);
+      vReaderImpl = new bpfFileReaderBioformats(aFileName, vMetadataLevel, vMemoDirectory, vMemoMinimumElapsed, vTraceRecorder);
       vReaderImpl->ShouldColorRangeBeAdjustedToMinMax();
     }
     catch (...) {
@@ -269,7 +298,7 @@ bpfFileReaderImplInterface* bpfFileReaderBioformatsImplFactory::CreateFileReader
   
   SetFileReaderImplVersion();
 
-  bpfFileReaderImpl* vReaderImpl = CreateReaderImpl(aFileName, aFormatName);
+  bpfFileReaderImpl* vReaderImpl = CreateReaderImpl(aFileName);
   return new bpfFileReaderImplToImplInterface(vReaderImpl);
 }
 
@@ -289,20 +318,32 @@ bpfFileReaderBioformatsImplFactory::Iterator bpfFileReaderBioformatsImplFactory:
 
 bpfString bpfFileReaderBioformatsImplFactory::GetFileFormat(const bpfString& aFileName)
 {
-  Iterator vFormatIt = mFormats.begin();
+  if (mFormats.empty()) {
+    return "";
+  }
 
-  while (vFormatIt != mFormats.end()) {
-    bpfFileReaderImpl* vReaderImpl = CreateReaderImpl(aFileName, *vFormatIt);
+  // bioformats finds the format itself, one reader answers for all formats
+  bpfUniquePtr<bpfFileReaderImpl> vReaderImpl(CreateReaderImpl(aFileName));
+  if (!vReaderImpl) {
+    return "";
+  }
 
-    if (vReaderImpl != nullptr) {
-      delete vReaderImpl;
-      return *vFormatIt;
+  bpfString vFormat = mFormats.front();
+  try {
+    bpfString vReaderFormat = vReaderImpl->GetReaderDescription();
+    if (std::find(mFormats.begin(), mFormats.end(), vReaderFormat) != mFormats.end()) {
+      vFormat = vReaderFormat;
     }
-
-    ++vFormatIt;
   }
+  catch (...) {
+  }
+  return vFormat;
+}
 
-  return "";
+
+bool bpfFileReaderBioformatsImplFactory::DetectsFileFormat() const
+{
+  return true;
 }
 
 
@@ -319,6 +360,38 @@ bpfString bpfFileReaderBioformatsImplFactory::GetVersion() const
   return vStream.str();
 }
 
+
+void bpfFileReaderBioformatsImplFactory::SetMetadataLevel(tMetadataLevel aMetadataLevel)
+{
+  std::lock_guard<std::mutex> vLock(mReaderOptionsMutex);
+  mMetadataLevel = aMetadataLevel;
+}
+
+
+void bpfFileReaderBioformatsImplFactory::SetReaderStateCache(const bpfString& aDirectory, bpfSize aMinimumMilliseconds)
+{
+  std::lock_guard<std::mutex> vLock(mReaderOptionsMutex);
+  mMemoDirectory = aDirectory;
+  mMemoMinimumElapsed = aMinimumMilliseconds;
+}
+
+void bpfFileReaderBioformatsImplFactory::AddVirtualMachineOptions(const std::vector<bpfString>& aOptions)
+{
+  bpfJNI::AddOptions(aOptions);
+}
+
+void bpfFileReaderBioformatsImplFactory::SetVirtualMachineClassArchive(const bpfString& aArchiveFile)
+{
+  bpfJNI::SetClassArchive(aArchiveFile);
+}
+
+void bpfFileReaderBioformatsImplFactory::SetTraceRecorder(const bpfSharedPtr<bpfTraceRecorder>& aRecorder)
+{
+  bpfJNI::SetTraceRecorder(aRecorder);
+  std::lock_guard<std::mutex> vLock(mReaderOptionsMutex);
+  mTraceRecorder = aRecorder;
+}
+
 bpfString bpfFileReaderBioformatsImplFactory::GetDefaultJVMPath()
 {
 #if defined(_WIN32)
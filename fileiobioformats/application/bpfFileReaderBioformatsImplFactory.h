@@ -21,9 +21,14 @@
 #define __BP_FILE_READER_BIOFORMATS_IMPL_FACTORY__
 
 #include "fileiobase/application/bpfFileReaderImplFactoryBase.h"
+#include "fileiobase/types/bpfSmartPtr.h"
 #include "fileiobioformats/application/bpFileIOBioformatsDllAPI.h"
 
 #include <map>
+#include <mutex>
+
+
+class bpfFileReaderImpl;
 
 
 class BP_FILEIOBIOFORMATS_DLL_API bpfFileReaderBioformatsImplFactory : public bpfFileReaderImplFactoryBase
@@ -40,9 +45,16 @@ public:
   virtual std::vector<bpfString> GetFormatExtensions(const bpfString& aFormat) const override;
   virtual bpfString GetFileFormat(const bpfString& aFileName) override;
   virtual void AddPluginsFormats(const bpfString& aPluginsPath) override;
+  virtual bool DetectsFileFormat() const override;
 
   virtual bpfString GetVersion() const override;
 
+  virtual void SetMetadataLevel(tMetadataLevel aMetadataLevel) override;
+  virtual void SetReaderStateCache(const bpfString& aDirectory, bpfSize aMinimumMilliseconds) override;
+  virtual void AddVirtualMachineOptions(const std::vector<bpfString>& aOptions) override;
+  virtual void SetVirtualMachineClassArchive(const bpfString& aArchiveFile) override;
+  virtual void SetTraceRecorder(const bpfSharedPtr<bpfTraceRecorder>& aRecorder) override;
+
 private:
 
 #if defined (_MSC_VER)
@@ -55,12 +67,22 @@ private:
   void GetSupportedBioformatsFormats(std::vector<bpfString>&  aFormats, std::vector<std::vector<bpfString>>& aExtensions) const;
   void SetSupportedBioformatsFormats();
   void SetFileReaderImplVersion();
+  bpfFileReaderImpl* CreateReaderImpl(const bpfString& aFileName);
 
+  // set once by the first CreateFileReader, which may run in parallel jobs
+  std::once_flag mVersionOnce;
   bpfString mVersion;
   std::list<bpfString> mFormats;
   std::map<bpfString, bpfString> mDescriptions;
   std::map<bpfString, std::vector<bpfString>> mExtensions;
 
+  // options of the readers created next
+  std::mutex mReaderOptionsMutex;
+  tMetadataLevel mMetadataLevel;
+  bpfString mMemoDirectory;
+  bpfSize mMemoMinimumElapsed;
+  bpfSharedPtr<bpfTraceRecorder> mTraceRecorder;
+
 #if defined (_MSC_VER)
 #pragma warning(pop)
 #endif
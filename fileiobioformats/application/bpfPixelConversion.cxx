@@ -0,0 +1,336 @@
+/***************************************************************************
+ *   Copyright (c) 2021-present Bitplane AG Zuerich                        *
+ *                                                                         *
+ *   ImarisConvertBioformats is free software; you can redistribute it     *
+ *   and/or modify it under the terms of the GNU General Public License    *
+ *   as published by the Free Software Foundation; either version 2 of     *
+ *   the License, or (at your option) any later version.                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public             *
+ *   License along with this program.  If not, please see                  *
+ *   <http://www.gnu.org/licenses/gpl-2.0.html>.                           *
+ ***************************************************************************/
+
+
+#include "fileiobioformats/application/bpfPixelConversion.h"
+#include "fileiobioformats/application/bpfTypesUtils.h"
+
+#include <algorithm>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define BP_PIXEL_CONVERSION_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define BP_PIXEL_CONVERSION_X86 0
+#endif
+
+// gcc and clang only emit the instructions inside functions compiled for the target,
+// msvc accepts the intrinsics everywhere
+#if defined(__GNUC__)
+#define BP_TARGET(aTarget) __attribute__((target(aTarget)))
+#else
+#define BP_TARGET(aTarget)
+#endif
+
+
+namespace
+{
+
+  // converts the voxels [aBegin, aEnd), reading TIn values and writing TOut values
+  // at the same index, front to back (safe in place as long as TOut is not larger than TIn)
+  template <class TIn, class TOut, class TConvert>
+  void NormalizeScalar(bpfUChar* aData, bpfSize aBegin, bpfSize aEnd, bool aSwapBytes, TConvert aConvert)
+  {
+    for (bpfSize vIndex = aBegin; vIndex < aEnd; vIndex++) {
+      TIn vIn;
+      memcpy(&vIn, aData + vIndex * sizeof(TIn), sizeof(TIn));
+      if (aSwapBytes) {
+        bpfSwapVal(&vIn);
+      }
+      TOut vOut = aConvert(vIn);
+      memcpy(aData + vIndex * sizeof(TOut), &vOut, sizeof(TOut));
+    }
+  }
+
+
+  template <class T>
+  T ClampNegative(T aValue)
+  {
+    return aValue < 0 ? 0 : aValue;
+  }
+
+
+  template <class T>
+  bpfFloat ToFloat(T aValue)
+  {
+    return static_cast<bpfFloat>(aValue);
+  }
+
+
+  template <class T>
+  T Identity(T aValue)
+  {
+    return aValue;
+  }
+
+
+  void NormalizeScalar(bpfUChar* aData, bpfSize aBegin, bpfSize aEnd, bpfNumberType aSourceType, bool aSwapBytes)
+  {
+    switch (aSourceType) {
+    case bpfInt8Type:
+      NormalizeScalar<bpfInt8, bpfInt8>(aData, aBegin, aEnd, false, ClampNegative<bpfInt8>);
+      break;
+    case bpfInt16Type:
+      NormalizeScalar<bpfInt16, bpfInt16>(aData, aBegin, aEnd, aSwapBytes, ClampNegative<bpfInt16>);
+      break;
+    case bpfUInt16Type:
+      NormalizeScalar<bpfUInt16, bpfUInt16>(aData, aBegin, aEnd, aSwapBytes, Identity<bpfUInt16>);
+      break;
+    case bpfInt32Type:
+      NormalizeScalar<bpfInt32, bpfFloat>(aData, aBegin, aEnd, aSwapBytes, ToFloat<bpfInt32>);
+      break;
+    case bpfUInt32Type:
+      NormalizeScalar<bpfUInt32, bpfFloat>(aData, aBegin, aEnd, aSwapBytes, ToFloat<bpfUInt32>);
+      break;
+    case bpfFloatType:
+      NormalizeScalar<bpfFloat, bpfFloat>(aData, aBegin, aEnd, aSwapBytes, Identity<bpfFloat>);
+      break;
+    case bpfDoubleType:
+      NormalizeScalar<bpfDouble, bpfFloat>(aData, aBegin, aEnd, aSwapBytes, ToFloat<bpfDouble>);
+      break;
+    default:
+      break;
+    }
+  }
+
+
+  // the vector kernels process the voxels [0, n) for some n <= aNumberOfVoxels and return n,
+  // the scalar loop takes care of the remainder
+  using tVectorKernel = bpfSize (*)(bpfUChar* aData, bpfSize aNumberOfVoxels, bpfNumberType aSourceType, bool aSwapBytes);
+
+
+  bpfSize NormalizeNone(bpfUChar*, bpfSize, bpfNumberType, bool)
+  {
+    return 0;
+  }
+
+
+#if BP_PIXEL_CONVERSION_X86
+
+  BP_TARGET("sse4.1")
+  bpfSize NormalizeSSE41(bpfUChar* aData, bpfSize aNumberOfVoxels, bpfNumberType aSourceType, bool aSwapBytes)
+  {
+    const __m128i vZero = _mm_setzero_si128();
+    const __m128i vSwap16 = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    const __m128i vSwap32 = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const __m128i vSwap64 = _mm_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    const __m128i vLow16 = _mm_set1_epi32(0xffff);
+    const __m128 v65536 = _mm_set1_ps(65536.0f);
+
+    bpfSize vIndex = 0;
+    switch (aSourceType) {
+    case bpfInt8Type:
+      for (; vIndex + 16 <= aNumberOfVoxels; vIndex += 16) {
+        __m128i* vPointer = reinterpret_cast<__m128i*>(aData + vIndex);
+        _mm_storeu_si128(vPointer, _mm_max_epi8(_mm_loadu_si128(vPointer), vZero));
+      }
+      break;
+    case bpfInt16Type:
+    case bpfUInt16Type:
+      for (; vIndex + 8 <= aNumberOfVoxels; vIndex += 8) {
+        __m128i* vPointer = reinterpret_cast<__m128i*>(aData + vIndex * 2);
+        __m128i vValues = _mm_loadu_si128(vPointer);
+        if (aSwapBytes) {
+          vValues = _mm_shuffle_epi8(vValues, vSwap16);
+        }
+        if (aSourceType == bpfInt16Type) {
+          vValues = _mm_max_epi16(vValues, vZero);
+        }
+        _mm_storeu_si128(vPointer, vValues);
+      }
+      break;
+    case bpfInt32Type:
+    case bpfUInt32Type:
+    case bpfFloatType:
+      for (; vIndex + 4 <= aNumberOfVoxels; vIndex += 4) {
+        __m128i* vPointer = reinterpret_cast<__m128i*>(aData + vIndex * 4);
+        __m128i vValues = _mm_loadu_si128(vPointer);
+        if (aSwapBytes) {
+          vValues = _mm_shuffle_epi8(vValues, vSwap32);
+        }
+        if (aSourceType == bpfInt32Type) {
+          vValues = _mm_castps_si128(_mm_cvtepi32_ps(vValues));
+        }
+        else if (aSourceType == bpfUInt32Type) {
+          // no unsigned conversion before avx512: convert both 16 bit halves, both exact
+          __m128 vHigh = _mm_cvtepi32_ps(_mm_srli_epi32(vValues, 16));
+          __m128 vLow = _mm_cvtepi32_ps(_mm_and_si128(vValues, vLow16));
+          vValues = _mm_castps_si128(_mm_add_ps(_mm_mul_ps(vHigh, v65536), vLow));
+        }
+        _mm_storeu_si128(vPointer, vValues);
+      }
+      break;
+    case bpfDoubleType:
+      for (; vIndex + 2 <= aNumberOfVoxels; vIndex += 2) {
+        __m128i vValues = _mm_loadu_si128(reinterpret_cast<const __m128i*>(aData + vIndex * 8));
+        if (aSwapBytes) {
+          vValues = _mm_shuffle_epi8(vValues, vSwap64);
+        }
+        __m128 vFloats = _mm_cvtpd_ps(_mm_castsi128_pd(vValues));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(aData + vIndex * 4), _mm_castps_si128(vFloats));
+      }
+      break;
+    default:
+      break;
+    }
+    return vIndex;
+  }
+
+
+  BP_TARGET("avx2")
+  bpfSize NormalizeAVX2(bpfUChar* aData, bpfSize aNumberOfVoxels, bpfNumberType aSourceType, bool aSwapBytes)
+  {
+    const __m256i vZero = _mm256_setzero_si256();
+    const __m256i vSwap16 = _mm256_setr_epi8(
+      1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+      1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    const __m256i vSwap32 = _mm256_setr_epi8(
+      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+      3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    const __m256i vSwap64 = _mm256_setr_epi8(
+      7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+      7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    const __m256i vLow16 = _mm256_set1_epi32(0xffff);
+    const __m256 v65536 = _mm256_set1_ps(65536.0f);
+
+    bpfSize vIndex = 0;
+    switch (aSourceType) {
+    case bpfInt8Type:
+      for (; vIndex + 32 <= aNumberOfVoxels; vIndex += 32) {
+        __m256i* vPointer = reinterpret_cast<__m256i*>(aData + vIndex);
+        _mm256_storeu_si256(vPointer, _mm256_max_epi8(_mm256_loadu_si256(vPointer), vZero));
+      }
+      break;
+    case bpfInt16Type:
+    case bpfUInt16Type:
+      for (; vIndex + 16 <= aNumberOfVoxels; vIndex += 16) {
+        __m256i* vPointer = reinterpret_cast<__m256i*>(aData + vIndex * 2);
+        __m256i vValues = _mm256_loadu_si256(vPointer);
+        if (aSwapBytes) {
+          vValues = _mm256_shuffle_epi8(vValues, vSwap16);
+        }
+        if (aSourceType == bpfInt16Type) {
+          vValues = _mm256_max_epi16(vValues, vZero);
+        }
+        _mm256_storeu_si256(vPointer, vValues);
+      }
+      break;
+    case bpfInt32Type:
+    case bpfUInt32Type:
+    case bpfFloatType:
+      for (; vIndex + 8 <= aNumberOfVoxels; vIndex += 8) {
+        __m256i* vPointer = reinterpret_cast<__m256i*>(aData + vIndex * 4);
+        __m256i vValues = _mm256_loadu_si256(vPointer);
+        if (aSwapBytes) {
+          vValues = _mm256_shuffle_epi8(vValues, vSwap32);
+        }
+        if (aSourceType == bpfInt32Type) {
+          vValues = _mm256_castps_si256(_mm256_cvtepi32_ps(vValues));
+        }
+        else if (aSourceType == bpfUInt32Type) {
+          __m256 vHigh = _mm256_cvtepi32_ps(_mm256_srli_epi32(vValues, 16));
+          __m256 vLow = _mm256_cvtepi32_ps(_mm256_and_si256(vValues, vLow16));
+          vValues = _mm256_castps_si256(_mm256_add_ps(_mm256_mul_ps(vHigh, v65536), vLow));
+        }
+        _mm256_storeu_si256(vPointer, vValues);
+      }
+      break;
+    case bpfDoubleType:
+      for (; vIndex + 4 <= aNumberOfVoxels; vIndex += 4) {
+        __m256i vValues = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(aData + vIndex * 8));
+        if (aSwapBytes) {
+          vValues = _mm256_shuffle_epi8(vValues, vSwap64);
+        }
+        __m128 vFloats = _mm256_cvtpd_ps(_mm256_castsi256_pd(vValues));
+        _mm_storeu_ps(reinterpret_cast<bpfFloat*>(aData + vIndex * 4), vFloats);
+      }
+      break;
+    default:
+      break;
+    }
+    return vIndex;
+  }
+
+
+  bool CpuSupportsAVX2()
+  {
+#if defined(_MSC_VER)
+    int vInfo[4];
+    __cpuid(vInfo, 0);
+    if (vInfo[0] < 7) {
+      return false;
+    }
+    __cpuid(vInfo, 1);
+    bool vOSXSave = (vInfo[2] & (1 << 27)) != 0;
+    if (!vOSXSave || (_xgetbv(0) & 6) != 6) {
+      return false;
+    }
+    __cpuidex(vInfo, 7, 0);
+    return (vInfo[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2") != 0;
+#endif
+  }
+
+
+  bool CpuSupportsSSE41()
+  {
+#if defined(_MSC_VER)
+    int vInfo[4];
+    __cpuid(vInfo, 1);
+    return (vInfo[2] & (1 << 19)) != 0;
+#else
+    return __builtin_cpu_supports("sse4.1") != 0;
+#endif
+  }
+
+#endif
+
+
+  tVectorKernel SelectVectorKernel()
+  {
+#if BP_PIXEL_CONVERSION_X86
+    if (CpuSupportsAVX2()) {
+      return NormalizeAVX2;
+    }
+    if (CpuSupportsSSE41()) {
+      return NormalizeSSE41;
+    }
+#endif
+    return NormalizeNone;
+  }
+
+}
+
+
+void bpfNormalizePixels(void* aData, bpfSize aNumberOfVoxels, bpfNumberType aSourceType, bool aSwapBytes)
+{
+  static const tVectorKernel vVectorKernel = SelectVectorKernel();
+
+  if (aSourceType == bpfUInt8Type || (aSourceType == bpfUInt16Type && !aSwapBytes) || (aSourceType == bpfFloatType && !aSwapBytes)) {
+    return;
+  }
+
+  bpfUChar* vData = static_cast<bpfUChar*>(aData);
+  bpfSize vDone = vVectorKernel(vData, aNumberOfVoxels, aSourceType, aSwapBytes);
+  NormalizeScalar(vData, vDone, aNumberOfVoxels, aSourceType, aSwapBytes);
+}
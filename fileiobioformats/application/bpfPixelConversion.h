@@ -17,27 +17,21 @@
  ***************************************************************************/
 
 
-#ifndef __BP_THROUGHPUT_MEASUREMENTS_H__
-#define __BP_THROUGHPUT_MEASUREMENTS_H__
+#ifndef __BP_PIXEL_CONVERSION__
+#define __BP_PIXEL_CONVERSION__
 
-#include "bpWriterCommonHeaders.h"
-#include ICCircularBuffer_h
+#include "fileiobase/types/bpfTypes.h"
 
 
-class bpThroughputMeasurements
-{
-public:
+/**
+ * Maps a block as delivered by bioformats onto the data types of the reader, in place
+ * and in a single pass: big endian values are swapped, negative int8 / int16 values
+ * are set to 0, and int32 / uint32 / double values are converted to float (the
+ * float values are packed at the start of the buffer).
+ *
+ * Uses SSE4.1 or AVX2 when the cpu supports it, a scalar loop otherwise.
+ */
+void bpfNormalizePixels(void* aData, bpfSize aNumberOfVoxels, bpfNumberType aSourceType, bool aSwapBytes);
 
-  bpThroughputMeasurements(bpSize aBufferSize = 1000);
-  ~bpThroughputMeasurements() = default;
 
-  void AddMeasurement(bpDouble aBlockSize, bpDouble aTime);
-
-  bpDouble GetThroughputInWindow(bpDouble aCurrentTime, bpDouble aTimeWindow);
-
-private:
-  bpCircularBuffer<std::pair<bpDouble, bpDouble>> mMeasurements;
-};
-
-
-#endif // __BP_THROUGHPUT_MEASUREMENTS_H__
+#endif
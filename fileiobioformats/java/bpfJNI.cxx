@@ -21,12 +21,16 @@
 
 #include "fileiobase/application/bpfException.h"
 
+#include <atomic>
+#include <cctype>
+#include <fstream>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <sstream>
 #include <vector>
 
 //#include "boost/chrono.hpp"
-#include "boost/thread.hpp"
 #include <boost/dll.hpp>
 
 #if defined(_WIN32)
@@ -35,28 +39,56 @@
 #define JNI_PATH_SEPARATOR ":"
 #endif
 
+// the environment of one thread, the thread is detached when it ends if it was attached by GetEnv
+class bpfJNI::cThreadEnv
+{
+public:
+  ~cThreadEnv()
+  {
+    if (mAttached) {
+      mJvm->DetachCurrentThread();
+    }
+  }
+
+  JavaVM* mJvm = nullptr;
+  JNIEnv* mEnv = nullptr;
+  bool mAttached = false;
+};
+
+
 class bpfJNI::cImpl
 {
 public:
   static JNIEnv* GetEnv()
   {
-    mMutex.lock();
+    // the environments kept by the threads are invalid after Shutdown, and the JVM can not be created again
+    if (mShutdown.load(std::memory_order_acquire)) {
+      throw bpfException("The JVM was shut down, Java readers can not be used anymore.");
+    }
 
-    if (nullptr == mJvm) {
-      static auto vImpl = std::make_shared<cImpl>(&mJvmFolder, &mJarsFolder);
-      mMutex.unlock();
-      return mEnv;
+    // the environment is thread specific, each thread keeps its own without locking
+    cThreadEnv& vThreadEnv = mThreadEnv;
+    if (nullptr != vThreadEnv.mEnv) {
+      return vThreadEnv.mEnv;
     }
-    else {
-      auto vState = mJvm->GetEnv((void**)&mEnv, JNI_VERSION_1_8);
 
-      if (JNI_EDETACHED == vState) {
-        mJvm->AttachCurrentThread((void**)&mEnv, nullptr);
-      }
+    // the first call creates the JVM, which attaches the creating thread
+    std::call_once(mCreateFlag, [] {
+      bpfTraceScope vTrace(mTraceRecorder.get(), "JVM init");
+      static auto vImpl = std::make_shared<cImpl>(&mJvmFolder, &mJarsFolder);
+    });
 
-      mMutex.unlock();
-      return mEnv;
+    JNIEnv* vEnv = nullptr;
+    auto vState = mJvm->GetEnv((void**)&vEnv, JNI_VERSION_1_8);
+    if (JNI_EDETACHED == vState) {
+      if (JNI_OK != mJvm->AttachCurrentThread((void**)&vEnv, nullptr)) {
+        throw bpfException("Can't attach the thread to the JVM.");
+      }
+      vThreadEnv.mAttached = true;
     }
+    vThreadEnv.mJvm = mJvm;
+    vThreadEnv.mEnv = vEnv;
+    return vEnv;
   }
 
   static void InitEnv(const std::string& aJVM, const std::vector<std::string>& aJars, size_t aMemLimit)
@@ -70,15 +102,55 @@ public:
     return mMemLimit;
   }
 
-  static void DetachCurrentThreadFromJVM()
+  static void AddOptions(const std::vector<std::string>& aOptions)
   {
-    mDetachMutex.lock();
+    if (nullptr != mJvm) {
+      throw bpfException("JVM options have to be set before the JVM is created.");
+    }
+    for (const auto& vOption : aOptions) {
+      // a heap size given here replaces the default one, keep the limit in sync
+      if (vOption.compare(0, 4, "-Xmx") == 0) {
+        mMemLimit = GetMemorySize(vOption.substr(4));
+      }
+      mOptions.push_back(vOption);
+    }
+  }
 
+  static void SetClassArchive(const std::string& aArchiveFile)
+  {
     if (nullptr != mJvm) {
-      mJvm->DetachCurrentThread();
+      throw bpfException("JVM class archive has to be set before the JVM is created.");
     }
+    mClassArchive = aArchiveFile;
+  }
 
-    mDetachMutex.unlock();
+  static void SetTraceRecorder(const std::shared_ptr<bpfTraceRecorder>& aRecorder)
+  {
+    mTraceRecorder = aRecorder;
+  }
+
+  static void Shutdown()
+  {
+    if (nullptr == mJvm || !mWriteClassArchive) {
+      return;
+    }
+    // waits for the other attached threads to end, then the archive is written
+    mJvm->DestroyJavaVM();
+    mShutdown.store(true, std::memory_order_release);
+    mJvm = nullptr;
+    cThreadEnv& vThreadEnv = mThreadEnv;
+    vThreadEnv.mEnv = nullptr;
+    vThreadEnv.mAttached = false;
+  }
+
+  static void DetachCurrentThreadFromJVM()
+  {
+    cThreadEnv& vThreadEnv = mThreadEnv;
+    if (nullptr != vThreadEnv.mEnv) {
+      mJvm->DetachCurrentThread();
+      vThreadEnv.mEnv = nullptr;
+      vThreadEnv.mAttached = false;
+    }
   }
 
 
@@ -111,12 +183,31 @@ public:
     std::string vMaxMem = "-Xmx" + vStrMemLimit.str() + "m";
     vOptions.push_back({ const_cast<char*>(vMaxMem.c_str()), nullptr });
 
+    // an existing archive maps the classes of earlier runs, otherwise the classes of this run are archived (JDK 13+)
+    std::string vClassArchive;
+    if (!mClassArchive.empty()) {
+      mWriteClassArchive = !std::ifstream(mClassArchive).good();
+      if (mWriteClassArchive) {
+        vClassArchive = "-XX:ArchiveClassesAtExit=" + mClassArchive;
+      }
+      else {
+        vClassArchive = "-XX:SharedArchiveFile=" + mClassArchive;
+      }
+      vOptions.push_back({ const_cast<char*>(vClassArchive.c_str()), nullptr });
+      // an archive of another JVM or class path is ignored instead of failing
+      vOptions.push_back({ const_cast<char*>("-Xshare:auto"), nullptr });
+    }
+
+    for (const auto& vOption : mOptions) {
+      vOptions.push_back({ const_cast<char*>(vOption.c_str()), nullptr });
+    }
+
     vInitArgs.version = JNI_VERSION_1_8;
     vInitArgs.nOptions = static_cast<jint>(vOptions.size());
     vInitArgs.options = vOptions.data();
     vInitArgs.ignoreUnrecognized = false;
 
-    // load and initialize a Java VM, return a JNI interface pointer in mEnv
+    // load and initialize a Java VM, return a JNI interface pointer of the creating thread in vEnv
     //boost::chrono::high_resolution_clock::time_point start = boost::chrono::high_resolution_clock::now();
 
 #if defined(_WIN32)
@@ -129,9 +220,11 @@ public:
     typedef jint(JNICALL *CreateJavaVM)(JavaVM **, void **, void *);
     CreateJavaVM vCreateJavaVM = (CreateJavaVM)GetProcAddress(vJvmDll, "JNI_CreateJavaVM");
 
-    jint rc = vCreateJavaVM(&mJvm, (void**)&mEnv, &vInitArgs);
+    JNIEnv* vEnv = nullptr;
+    jint rc = vCreateJavaVM(&mJvm, (void**)&vEnv, &vInitArgs);
 #else
-    jint rc = JNI_CreateJavaVM(&mJvm, (void**)&mEnv, &vInitArgs);
+    JNIEnv* vEnv = nullptr;
+    jint rc = JNI_CreateJavaVM(&mJvm, (void**)&vEnv, &vInitArgs);
 #endif
 
     // boost::chrono::duration<double> vSeconds = (boost::chrono::high_resolution_clock::now() - start);
@@ -179,13 +272,18 @@ public:
 private:
   static std::string GetClassPathFromJars(const std::vector<std::string>& aJars);
   static std::string GetLibraryPathFromJVM(const std::string& aJVM);
-  static JNIEnv* mEnv; // Pointer to native interface
+  static size_t GetMemorySize(const std::string& aSize);
   static JavaVM* mJvm; // Pointer to the JVM (Java Virtual Machine)
+  static std::once_flag mCreateFlag;
+  static std::atomic<bool> mShutdown;
+  static thread_local cThreadEnv mThreadEnv; // Pointer to native interface of each thread
   static std::string mJvmFolder;
   static std::vector<std::string> mJarsFolder;
   static size_t mMemLimit;
-  static boost::recursive_mutex mMutex;
-  static boost::recursive_mutex mDetachMutex;
+  static std::vector<std::string> mOptions;
+  static std::string mClassArchive;
+  static bool mWriteClassArchive;
+  static std::shared_ptr<bpfTraceRecorder> mTraceRecorder;
 };
 
 
@@ -224,11 +322,50 @@ std::string bpfJNI::cImpl::GetLibraryPathFromJVM(const std::string& aJVM)
   return vLibraryPath;
 }
 
+size_t bpfJNI::cImpl::GetMemorySize(const std::string& aSize)
+{
+  // same syntax as the JVM: bytes, or a number followed by k, m, g or t
+  if (aSize.empty() || !std::isdigit(static_cast<unsigned char>(aSize[0]))) {
+    throw bpfException("Invalid JVM memory size: " + aSize);
+  }
+  size_t vSuffixPos = 0;
+  size_t vSize = std::stoull(aSize, &vSuffixPos);
+  if (vSuffixPos == aSize.size()) {
+    return vSize;
+  }
+  const std::string vUnits = "kmgt";
+  size_t vUnit = vSuffixPos + 1 == aSize.size() ? vUnits.find(static_cast<char>(std::tolower(aSize[vSuffixPos]))) : std::string::npos;
+  if (vUnit == std::string::npos) {
+    throw bpfException("Invalid JVM memory size: " + aSize);
+  }
+  return vSize << (10 * (vUnit + 1));
+}
+
 void bpfJNI::Init(const std::string& aJVM, const std::vector<std::string>& aJars, size_t aMemLimit)
 {
   cImpl::InitEnv(aJVM, aJars, aMemLimit);
 }
 
+void bpfJNI::AddOptions(const std::vector<std::string>& aOptions)
+{
+  cImpl::AddOptions(aOptions);
+}
+
+void bpfJNI::SetClassArchive(const std::string& aArchiveFile)
+{
+  cImpl::SetClassArchive(aArchiveFile);
+}
+
+void bpfJNI::Shutdown()
+{
+  cImpl::Shutdown();
+}
+
+void bpfJNI::SetTraceRecorder(const std::shared_ptr<bpfTraceRecorder>& aRecorder)
+{
+  cImpl::SetTraceRecorder(aRecorder);
+}
+
 size_t bpfJNI::GetMemLimit()
 {
   return cImpl::GetMemLimit();
@@ -262,6 +399,35 @@ void bpfJNI::DetachCurrentThreadFromJVM()
 }
 
 
+bpfJNILocalFrame::bpfJNILocalFrame(JNIEnv* aEnv, jint aCapacity)
+  : mEnv(aEnv), mPushed(false)
+{
+  if (mEnv->PushLocalFrame(aCapacity) != 0) {
+    bpfJNISanityCheck(mEnv);
+    throw bpfException("JNI local frame not available.");
+  }
+  mPushed = true;
+}
+
+
+bpfJNILocalFrame::~bpfJNILocalFrame()
+{
+  if (mPushed) {
+    mEnv->PopLocalFrame(nullptr);
+  }
+}
+
+
+jobject bpfJNILocalFrame::Pop(jobject aResult)
+{
+  if (!mPushed) {
+    return nullptr;
+  }
+  mPushed = false;
+  return mEnv->PopLocalFrame(aResult);
+}
+
+
 void bpfJNISanityCheck(JNIEnv* aEnv)
 {
   if (aEnv->ExceptionCheck()) {
@@ -279,10 +445,14 @@ void bpfJNISanityCheck(void* aPointer, const std::string& aPointerName, JNIEnv*
   }
 }
 
-JNIEnv* bpfJNI::cImpl::mEnv = nullptr;
 JavaVM* bpfJNI::cImpl::mJvm = nullptr;
+std::once_flag bpfJNI::cImpl::mCreateFlag;
+std::atomic<bool> bpfJNI::cImpl::mShutdown(false);
+thread_local bpfJNI::cThreadEnv bpfJNI::cImpl::mThreadEnv;
 std::string bpfJNI::cImpl::mJvmFolder;
 std::vector<std::string> bpfJNI::cImpl::mJarsFolder;
 size_t bpfJNI::cImpl::mMemLimit;
-boost::recursive_mutex bpfJNI::cImpl::mMutex;
-boost::recursive_mutex bpfJNI::cImpl::mDetachMutex;
+std::vector<std::string> bpfJNI::cImpl::mOptions;
+std::string bpfJNI::cImpl::mClassArchive;
+bool bpfJNI::cImpl::mWriteClassArchive = false;
+std::shared_ptr<bpfTraceRecorder> bpfJNI::cImpl::mTraceRecorder;
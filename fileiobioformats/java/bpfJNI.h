@@ -21,7 +21,10 @@
 #define BP_JNI
 
 
+#include "fileiobase/utils/bpfTraceRecorder.h"
+
 #include <jni.h>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -30,7 +33,16 @@ class bpfJNI
 {
 public:
   static void Init(const std::string& aJVM, const std::vector<std::string>& aJars, size_t aMemLimit);
+  // options appended to the default ones when the JVM is created, later options take precedence
+  static void AddOptions(const std::vector<std::string>& aOptions);
+  // class data sharing archive of the loaded classes, written when the JVM ends if it does not exist yet
+  static void SetClassArchive(const std::string& aArchiveFile);
+  // ends the JVM if it has to write the class archive, no JNI calls are possible afterwards
+  static void Shutdown();
+  // receives the creation of the JVM
+  static void SetTraceRecorder(const std::shared_ptr<bpfTraceRecorder>& aRecorder);
 
+  // environment of the calling thread, which is attached on first use and detached when it ends (throws after Shutdown)
   static JNIEnv* GetEnv();
   static std::string GetVersion();
   static std::string GetConfiguration();
@@ -38,6 +50,26 @@ public:
   static size_t GetMemLimit();
 private:
   class cImpl;
+  class cThreadEnv;
+};
+
+
+// local references created during the lifetime of a frame are deleted with it
+class bpfJNILocalFrame
+{
+public:
+  explicit bpfJNILocalFrame(JNIEnv* aEnv, jint aCapacity = 16);
+  ~bpfJNILocalFrame();
+
+  // pops the frame and returns a reference to aResult that is valid in the previous frame
+  jobject Pop(jobject aResult);
+
+private:
+  bpfJNILocalFrame(const bpfJNILocalFrame&) = delete;
+  bpfJNILocalFrame& operator=(const bpfJNILocalFrame&) = delete;
+
+  JNIEnv* mEnv;
+  bool mPushed;
 };
 
 